@@ -672,6 +672,11 @@ export async function localTournamentRoutes(server: FastifyInstance) {
     const db = DatabaseManager.getInstance().getDb();
 
     try {
+      const query = request.query as { page?: string; limit?: string };
+
+      const page = Math.max(1, Number(query.page) || 1);
+      const limit = Math.min(100, Math.max(1, Number(query.limit) || 50));
+      const offset = (page - 1) * limit;
 
       const tournaments = await db.all(`
         SELECT
@@ -688,8 +693,8 @@ export async function localTournamentRoutes(server: FastifyInstance) {
         FROM tournaments
         WHERE status IN ('completed', 'cancelled')
         ORDER BY created_at DESC
-        LIMIT 50
-      `);
+        LIMIT ? OFFSET ?
+      `, [limit, offset]);
 
       const tournamentsWithDetails = await Promise.all(
         tournaments.map(async (tournament: any) => {
@@ -1,4 +1,5 @@
 import { SocketStream } from '@fastify/websocket';
+import { SimplePongManager } from './SimplePongManager';
 
 interface QueuedPlayer {
   userId: number;
@@ -53,7 +54,8 @@ export class MatchmakingQueue {
       const player1 = this.queue.shift()!;
       const player2 = this.queue.shift()!;
 
-      const matchId = `match_${Date.now()}`;
+      // the 'pong_' prefix makes SimplePongManager send simple_pong_* messages
+      const matchId = `pong_match_${Date.now()}_${player1.userId}_${player2.userId}`;
 
       const message1 = {
         type: 'matchmaking:found',
@@ -80,7 +82,32 @@ export class MatchmakingQueue {
       }
 
       this.updateQueuePositions();
+
+      void this.startMatch(matchId, player1, player2);
+    }
+  }
+
+  // player1 plays on the left. SimplePongManager sends simple_pong_start with
+  // the gameId and the role of each player, the match is then played like any
+  // SimplePong game (pong_player_ready, simple_pong_input)
+  private async startMatch(matchId: string, player1: QueuedPlayer, player2: QueuedPlayer): Promise<void> {
+    const started = await SimplePongManager.getInstance().startGame(matchId, player1.userId, player2.userId);
+    if (started) {
+      return;
     }
+
+    console.error(`❌ [MATCHMAKING] Failed to start ${matchId}`);
+    // both were told about the match, they have to search again
+    [player1, player2].forEach(player => {
+      if (player.socket.socket.readyState === player.socket.socket.OPEN) {
+        player.socket.socket.send(
+          JSON.stringify({
+            type: 'matchmaking:error',
+            message: 'Could not start the match',
+          })
+        );
+      }
+    });
   }
 
   private notifyQueuePosition(player: QueuedPlayer): void {
@@ -21,6 +21,10 @@ import {
   SimplePongInputMessageHandler,
   PongPlayerReadyMessageHandler,
 } from './message-handlers/PongMessageHandlers';
+import {
+  MatchmakingJoinMessageHandler,
+  MatchmakingLeaveMessageHandler,
+} from './message-handlers/MatchmakingMessageHandlers';
 
 interface WebSocketMessage {
   type: string;
@@ -66,6 +70,12 @@ export class MessageRouter {
       new SimplePongInputMessageHandler(),
       new PongPlayerReadyMessageHandler(),
     ]);
+
+    // Matchmaking handlers (matches are played as SimplePong games)
+    this.handlerRegistry.registerMultiple([
+      new MatchmakingJoinMessageHandler(),
+      new MatchmakingLeaveMessageHandler(),
+    ]);
   }
 
   async handleMessage(
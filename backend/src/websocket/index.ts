@@ -7,6 +7,7 @@ import { MessageRouter } from './MessageRouter';
 import { Input } from '../game/Input';
 import { FriendPongInvites } from './FriendPongInvites';
 import { SimplePongManager } from './SimplePongManager';
+import { MatchmakingQueue } from './MatchmakingQueue';
 
 interface FastifyWithPongServices extends FastifyInstance {
   friendPongInvites: FriendPongInvites;
@@ -49,6 +50,7 @@ export function setupWebSocket(server: FastifyInstance) {
             const hasOtherConnections = wsManager.getConnectedUsers().filter(u => u.id === userId).length > 1;
 
             simplePongManager.handlePlayerDisconnect(userId);
+            MatchmakingQueue.getInstance().removePlayer(userId);
             wsManager.removeUser(userId);
 
             const finalHasConnections = wsManager.hasUser(userId);
@@ -66,6 +68,7 @@ export function setupWebSocket(server: FastifyInstance) {
         const { userId } = userState;
         if (userId) {
           simplePongManager.handlePlayerDisconnect(userId);
+          MatchmakingQueue.getInstance().removePlayer(userId);
           wsManager.removeUser(userId);
         }
       });
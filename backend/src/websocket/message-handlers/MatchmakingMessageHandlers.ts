@@ -0,0 +1,51 @@
+import { BaseMessageHandler, MessageContext } from '../handlers/MessageHandler';
+import { SocketStream } from '@fastify/websocket';
+import { MatchmakingQueue } from '../MatchmakingQueue';
+
+// not a plain 'error', the client would take any failure for one of the queue
+function sendMatchmakingError(connection: SocketStream, message: string): void {
+  connection.socket.send(
+    JSON.stringify({
+      type: 'matchmaking:error',
+      message,
+    })
+  );
+}
+
+export class MatchmakingJoinMessageHandler extends BaseMessageHandler {
+  readonly messageType = 'matchmaking:join';
+
+  validate(message: any): boolean {
+    return true;
+  }
+
+  async handle(context: MessageContext): Promise<void> {
+    const { connection, userState } = context;
+
+    if (!userState.userId || !userState.username) {
+      sendMatchmakingError(connection, 'User not authenticated');
+      return;
+    }
+
+    MatchmakingQueue.getInstance().addPlayer(userState.userId, userState.username, connection);
+  }
+}
+
+export class MatchmakingLeaveMessageHandler extends BaseMessageHandler {
+  readonly messageType = 'matchmaking:leave';
+
+  validate(message: any): boolean {
+    return true;
+  }
+
+  async handle(context: MessageContext): Promise<void> {
+    const { connection, userState } = context;
+
+    if (!userState.userId) {
+      sendMatchmakingError(connection, 'User not authenticated');
+      return;
+    }
+
+    MatchmakingQueue.getInstance().removePlayer(userState.userId);
+  }
+}
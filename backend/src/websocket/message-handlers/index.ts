@@ -1,3 +1,4 @@
 export * from './AuthMessageHandler';
 export * from './ChatMessageHandlers';
-export * from './PongMessageHandlers';
\ No newline at end of file
+export * from './PongMessageHandlers';
+export * from './MatchmakingMessageHandlers';
\ No newline at end of file
@@ -0,0 +1,302 @@
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#define JSON_DEF_IMPLEMENTATION
+#include "json_def.h"
+#include "json_defs.h"
+#include "bench.h"
+#include "ctx.h"
+#include "clock.h"
+#include "term.h"
+
+ctx g_ctx = {0};
+
+u64	bench_allocs = 0;
+u64	bench_bytes = 0;
+
+/* ALLOCATIONS */
+// the bench is linked with --wrap for these, so every allocation made by the
+// client objects and the static libraries goes through here
+
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t n);
+
+void *__wrap_malloc(size_t n)
+{
+	bench_allocs++;
+	return (__real_malloc(n));
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	bench_allocs++;
+	return (__real_calloc(nmemb, size));
+}
+
+void *__wrap_realloc(void *ptr, size_t n)
+{
+	bench_allocs++;
+	return (__real_realloc(ptr, n));
+}
+
+/* OUTPUT */
+
+static FILE	*counting_stream = NULL;
+
+static ssize_t counting_write(void *cookie, const char *buf, size_t size)
+{
+	(void)cookie;
+	(void)buf;
+	bench_bytes += size;
+	return (size);
+}
+
+void bench_capture_output()
+{
+	if (!counting_stream)
+	{
+		counting_stream = fopencookie(NULL, "w", (cookie_io_functions_t){.write = counting_write});
+		if (!counting_stream)
+		{
+			perror("fopencookie()");
+			exit(EXIT_FAILURE);
+		}
+		// same buffering as a terminal stdout, so flushes cost the same
+		setvbuf(counting_stream, NULL, _IOLBF, BUFSIZ);
+	}
+	c_out = counting_stream;
+}
+
+void bench_release_output()
+{
+	fflush(counting_stream);
+	c_out = stdout;
+}
+
+/* RUNNER */
+
+static bench_result run_case(const bench_case *c, u64 *iterations_out)
+{
+	bench_result result = {.name = c->name};
+	if (c->setup)
+		c->setup(c->param);
+	bench_capture_output();
+
+	// warm up and calibrate, doubling until a batch is long enough to be timed
+	u64 iterations = 1;
+	u64 elapsed = 0;
+	while (1)
+	{
+		u64 begin = clock_ns();
+		for (u64 i = 0; i < iterations; i++)
+			c->run(c->param);
+		elapsed = clock_ns() - begin;
+		if (elapsed >= BENCH_MIN_NS / 10 || iterations >= (1ull << 30))
+			break;
+		iterations *= 2;
+	}
+	if (elapsed < BENCH_MIN_NS)
+		iterations = iterations * BENCH_MIN_NS / (elapsed ? elapsed : 1);
+
+	fflush(c_out);
+	u64 allocs = bench_allocs;
+	u64 bytes = bench_bytes;
+	u64 begin = clock_ns();
+	for (u64 i = 0; i < iterations; i++)
+		c->run(c->param);
+	fflush(c_out);
+	elapsed = clock_ns() - begin;
+
+	bench_release_output();
+	if (c->teardown)
+		c->teardown(c->param);
+	*iterations_out = iterations;
+	result.ns_per_op = (double)elapsed / iterations;
+	result.allocs_per_op = (double)(bench_allocs - allocs) / iterations;
+	result.bytes_per_op = (double)(bench_bytes - bytes) / iterations;
+	return (result);
+}
+
+static void print_report(FILE *stream, const bench_result *results, const u64 *iterations, size_t count)
+{
+#ifdef DEBUG
+	const int debug = 1;
+#else
+	const int debug = 0;
+#endif
+	fprintf(stream, "{\n\t\"debug\": %s,\n\t\"results\": [\n", debug ? "true" : "false");
+	for (size_t i = 0; i < count; i++)
+	{
+		fprintf(stream, "\t\t{\"name\": \"%s\", \"iterations\": %" PRIu64 ", \"ns_per_op\": %.2f, \"allocs_per_op\": %.3f, \"bytes_per_op\": %.1f}%s\n",
+			results[i].name, iterations[i], results[i].ns_per_op,
+			results[i].allocs_per_op, results[i].bytes_per_op,
+			i + 1 < count ? "," : "");
+	}
+	fprintf(stream, "\t]\n}\n");
+}
+
+/* BASELINE */
+
+static char *read_file(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	if (!file)
+		return (NULL);
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	char *buf = malloc(size + 1);
+	if (buf && fread(buf, 1, size, file) != (size_t)size)
+	{
+		free(buf);
+		buf = NULL;
+	}
+	if (buf)
+		buf[size] = '\0';
+	fclose(file);
+	return (buf);
+}
+
+static const bench_result *find_baseline(const bench_report *baseline, const char *name)
+{
+	for (i64 i = 0; i < baseline->results.size; i++)
+		if (!strcmp(baseline->results.arr[i].name, name))
+			return (&baseline->results.arr[i]);
+	return (NULL);
+}
+
+// the time is compared with a tolerance, allocations and bytes are deterministic
+// so any increase is reported. returns the number of regressions
+static int compare_to_baseline(const char *path, const bench_result *results, size_t count, double threshold)
+{
+	char *content = read_file(path);
+	if (!content)
+	{
+		fprintf(stderr, "bench: unable to read baseline '%s' (make bench-baseline creates it)\n", path);
+		return (-1);
+	}
+	bench_report baseline;
+	cJSON *json = cJSON_Parse(content);
+	free(content);
+	json_content_error err = json_parse_from_def(json, bench_report_def, &baseline);
+	if (err.kind)
+	{
+		fprintf(stderr, "bench: invalid baseline '%s': ", path);
+		json_content_error_print(stderr, err);
+		cJSON_Delete(json);
+		return (-1);
+	}
+#ifdef DEBUG
+	if (!baseline.debug)
+#else
+	if (baseline.debug)
+#endif
+		fprintf(stderr, "bench: warning: baseline and results were not built with the same DEBUG setting\n");
+
+	int regressions = 0;
+	fprintf(stderr, "%-32s %12s %12s %8s %10s %10s\n", "benchmark", "base ns/op", "ns/op", "delta", "allocs/op", "bytes/op");
+	for (size_t i = 0; i < count; i++)
+	{
+		const bench_result *cur = &results[i];
+		const bench_result *base = find_baseline(&baseline, cur->name);
+		if (!base)
+		{
+			fprintf(stderr, "%-32s %12s %12.2f %8s %10.3f %10.1f  new\n", cur->name, "-", cur->ns_per_op, "-", cur->allocs_per_op, cur->bytes_per_op);
+			continue;
+		}
+		double delta = (cur->ns_per_op - base->ns_per_op) * 100.0 / base->ns_per_op;
+		int slower = delta > threshold;
+		int more_allocs = cur->allocs_per_op > base->allocs_per_op + 0.0005;
+		int more_bytes = cur->bytes_per_op > base->bytes_per_op + 0.05;
+		fprintf(stderr, "%-32s %12.2f %12.2f %+7.1f%% %10.3f %10.1f%s%s%s\n",
+			cur->name, base->ns_per_op, cur->ns_per_op, delta,
+			cur->allocs_per_op, cur->bytes_per_op,
+			slower ? "  SLOWER" : "",
+			more_allocs ? "  MORE-ALLOCS" : "",
+			more_bytes ? "  MORE-BYTES" : "");
+		regressions += slower || more_allocs || more_bytes;
+	}
+	json_clean_obj(&baseline, bench_report_def);
+	return (regressions);
+}
+
+/* MAIN */
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-o results.json] [-b baseline.json] [-t threshold_percent] [-f filter]\n", name);
+}
+
+int main(int ac, char **av)
+{
+	const char *output_path = NULL;
+	const char *baseline_path = NULL;
+	const char *filter = NULL;
+	double threshold = BENCH_DEFAULT_THRESHOLD;
+	int opt;
+	while ((opt = getopt(ac, av, "o:b:t:f:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'o':
+				output_path = optarg;
+				break;
+			case 'b':
+				baseline_path = optarg;
+				break;
+			case 't':
+				threshold = atof(optarg);
+				break;
+			case 'f':
+				filter = optarg;
+				break;
+			default:
+				usage(av[0]);
+				return (EXIT_FAILURE);
+		}
+	}
+
+	const bench_case *suites[] = {bench_json_cases, bench_term_cases, bench_loop_cases, bench_sim_cases};
+	bench_result results[64];
+	u64 iterations[64];
+	size_t count = 0;
+	for (size_t s = 0; s < sizeof(suites) / sizeof(suites[0]); s++)
+	{
+		for (const bench_case *c = suites[s]; c->name; c++)
+		{
+			if (filter && !strstr(c->name, filter))
+				continue;
+			if (count >= sizeof(results) / sizeof(results[0]))
+				break;
+			fprintf(stderr, "running %s...\n", c->name);
+			results[count] = run_case(c, &iterations[count]);
+			count++;
+		}
+	}
+
+	FILE *output = stdout;
+	if (output_path && !(output = fopen(output_path, "w")))
+	{
+		perror(output_path);
+		return (EXIT_FAILURE);
+	}
+	print_report(output, results, iterations, count);
+	if (output != stdout)
+		fclose(output);
+
+	if (baseline_path)
+	{
+		int regressions = compare_to_baseline(baseline_path, results, count, threshold);
+		if (regressions)
+		{
+			if (regressions > 0)
+				fprintf(stderr, "bench: %d regression(s) against %s\n", regressions, baseline_path);
+			return (EXIT_FAILURE);
+		}
+	}
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,55 @@
+#ifndef BENCH_H
+# define BENCH_H
+
+// micro-benchmarks of the client's hot functions, linked against the real objects.
+// nothing here opens the X display, the terminal or a socket: terminal output is
+// redirected to a stream that only counts the bytes written to it
+
+# include "json_def.h"
+# include "types.h"
+# include <stdio.h>
+
+// minimum time spent measuring each benchmark
+# define BENCH_MIN_NS 200000000ull
+// a benchmark is reported as a regression when it gets slower than this (percent)
+# define BENCH_DEFAULT_THRESHOLD 10.0
+
+typedef void (bench_func)(void *param);
+
+typedef struct
+{
+	const char	*name;
+	bench_func	*setup; // called once, outside of the measurement
+	bench_func	*run; // one operation
+	bench_func	*teardown;
+	void		*param;
+}	bench_case;
+
+// the iteration count is only written to the report (see print_report()), an
+// int can't hold it and the comparison doesn't need it
+DEFINE_JSON(bench_result,
+	(STRING, name),
+	(DOUBLE, ns_per_op),
+	(DOUBLE, allocs_per_op),
+	(DOUBLE, bytes_per_op)
+);
+
+DEFINE_JSON(bench_report,
+	(BOOL, debug),
+	(ARRAY, results, bench_result)
+);
+
+// counters updated by the malloc wrappers and the output stream
+extern u64	bench_allocs;
+extern u64	bench_bytes;
+
+// points the terminal output (c_out) to the counting stream, and back
+void	bench_capture_output();
+void	bench_release_output();
+
+extern const bench_case	bench_json_cases[];
+extern const bench_case	bench_term_cases[];
+extern const bench_case	bench_loop_cases[];
+extern const bench_case	bench_sim_cases[];
+
+#endif
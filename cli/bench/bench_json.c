@@ -0,0 +1,263 @@
+#include "bench.h"
+#include "json_defs.h"
+#include "json_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// recorded from a simple_pong_state message, minus the envelope
+static const char game_state_payload[] =
+	"{\"gameState\":{\"ballX\":412.83177,\"ballY\":163.20419,"
+	"\"leftPaddleY\":187.5,\"rightPaddleY\":241.66666,"
+	"\"leftScore\":2,\"rightScore\":3,\"gameOver\":false},"
+	"\"timestamp\":1718035261934}";
+
+// one entry recorded from GET api/friends, repeated with varying fields
+# define FRIEND_ENTRY_FMT \
+	"{\"id\":%d,\"username\":\"player_%d\",\"display_name\":\"Player number %d\"," \
+	"\"avatar_url\":null,\"is_online\":%d,\"total_wins\":%d,\"total_losses\":%d," \
+	"\"created_at\":\"2025-06-10 14:21:%02d\"}"
+# define FRIENDS_COUNT 64
+
+// not a recording: generated with the shape the GET api/local-tournaments/history
+// handler (backend/src/routes/local-tournament.ts) gives a completed 8 players
+// tournament. most of it (the players and the matches) is not part of the schema
+# define TOURNAMENT_ENTRY_FMT \
+	"{\"id\":%d,\"name\":\"Weekly cup #%d\",\"maxPlayers\":8,\"currentPlayers\":8," \
+	"\"status\":\"completed\",\"winnerId\":null,\"bracketData\":{\"winner\":\"player_1\"}," \
+	"\"createdAt\":\"2025-06-10T14:21:%02d.000Z\",\"startedAt\":\"2025-06-10T14:25:00.000Z\"," \
+	"\"completedAt\":\"2025-06-10T14:58:00.000Z\",\"winnerAlias\":\"player_1\"," \
+	"\"players\":[%s],\"matches\":[%s]}"
+# define PLAYER_FMT \
+	"{\"id\":%d,\"alias\":\"player_%d\",\"position\":%d,\"joinedAt\":\"2025-06-10T14:22:%02d.000Z\"}"
+# define MATCH_FMT \
+	"{\"id\":%d,\"tournamentId\":%d,\"round\":%d,\"matchNumber\":%d," \
+	"\"player1Alias\":\"player_%d\",\"player2Alias\":\"player_%d\",\"player1Score\":5," \
+	"\"player2Score\":%d,\"winnerAlias\":\"player_%d\",\"status\":\"completed\"," \
+	"\"startedAt\":\"2025-06-10T14:3%d:00.000Z\",\"completedAt\":\"2025-06-10T14:3%d:40.000Z\"," \
+	"\"createdAt\":\"2025-06-10T14:25:00.000Z\"}"
+# define TOURNAMENTS_COUNT 20
+
+typedef struct
+{
+	char	*payload;
+	cJSON	*json;
+}	json_bench;
+
+static json_bench game_state_bench = {0};
+static json_bench friends_bench = {0};
+static json_bench tournaments_bench = {0};
+
+static char *make_friends_payload()
+{
+	size_t cap = 64 + FRIENDS_COUNT * 256;
+	char *buf = malloc(cap);
+	size_t len = snprintf(buf, cap, "{\"success\":true,\"data\":[");
+	for (int i = 0; i < FRIENDS_COUNT; i++)
+	{
+		len += snprintf(buf + len, cap - len, i ? "," FRIEND_ENTRY_FMT : FRIEND_ENTRY_FMT,
+			i + 1, i + 1, i + 1, i % 3 == 0, i * 7 % 40, i * 3 % 25, i % 60);
+	}
+	snprintf(buf + len, cap - len, "]}");
+	return (buf);
+}
+
+// the winner of each match is its first player, so the same aliases go up the bracket
+static size_t format_matches(char *buf, size_t cap, int tournament_id)
+{
+	size_t len = 0;
+	int match_id = tournament_id * 8;
+	for (int round = 1, count = 4; count; round++, count /= 2)
+	{
+		int stride = 8 / count;
+		for (int i = 0; i < count; i++)
+		{
+			int p1 = 1 + i * stride;
+			int p2 = p1 + stride / 2;
+			len += snprintf(buf + len, cap - len, len ? "," MATCH_FMT : MATCH_FMT,
+				match_id++, tournament_id, round, i + 1, p1, p2, (p1 + p2) % 5, p1, round, round);
+		}
+	}
+	return (len);
+}
+
+static char *make_tournaments_payload()
+{
+	char players[1024];
+	size_t players_len = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		players_len += snprintf(players + players_len, sizeof(players) - players_len,
+			i ? "," PLAYER_FMT : PLAYER_FMT, i + 1, i + 1, i + 1, i * 4);
+	}
+	char matches[4096];
+	size_t cap = 64 + TOURNAMENTS_COUNT * (512 + sizeof(players) + sizeof(matches));
+	char *buf = malloc(cap);
+	size_t len = snprintf(buf, cap, "{\"success\":true,\"data\":{\"tournaments\":[");
+	for (int i = 0; i < TOURNAMENTS_COUNT; i++)
+	{
+		format_matches(matches, sizeof(matches), i + 1);
+		len += snprintf(buf + len, cap - len, i ? "," TOURNAMENT_ENTRY_FMT : TOURNAMENT_ENTRY_FMT,
+			i + 1, i + 1, i % 60, players, matches);
+	}
+	snprintf(buf + len, cap - len, "],\"total\":%d}}", TOURNAMENTS_COUNT);
+	return (buf);
+}
+
+static void setup_game_state(void *param)
+{
+	json_bench *bench = param;
+	bench->payload = strdup(game_state_payload);
+	bench->json = cJSON_Parse(bench->payload);
+}
+
+static void setup_friends(void *param)
+{
+	json_bench *bench = param;
+	bench->payload = make_friends_payload();
+	bench->json = cJSON_Parse(bench->payload);
+}
+
+static void setup_tournaments(void *param)
+{
+	json_bench *bench = param;
+	bench->payload = make_tournaments_payload();
+	bench->json = cJSON_Parse(bench->payload);
+}
+
+static void teardown_json(void *param)
+{
+	json_bench *bench = param;
+	cJSON_Delete(bench->json);
+	free(bench->payload);
+	bench->json = NULL;
+	bench->payload = NULL;
+}
+
+static void run_game_state_def(void *param)
+{
+	json_bench *bench = param;
+	game_state state;
+	if (json_parse_from_def(bench->json, game_state_def, &state).kind)
+		abort();
+}
+
+static void run_game_state_full(void *param)
+{
+	json_bench *bench = param;
+	game_state state;
+	if (json_parse_from_def(cJSON_Parse(bench->payload), game_state_def, &state).kind)
+		abort();
+	json_clean_obj(&state, game_state_def);
+}
+
+static void run_friends_def(void *param)
+{
+	json_bench *bench = param;
+	friends list;
+	if (json_parse_from_def(bench->json, friends_def, &list).kind)
+		abort();
+	// the tree belongs to the bench, only release what the parse allocated
+	free(list.data.arr);
+}
+
+static void run_friends_full(void *param)
+{
+	json_bench *bench = param;
+	friends list;
+	if (json_parse_from_def(cJSON_Parse(bench->payload), friends_def, &list).kind)
+		abort();
+	json_clean_obj(&list, friends_def);
+}
+
+// what the api does with a response: one copy of the body, parsed in place
+static void run_friends_buffer(void *param)
+{
+	json_bench *bench = param;
+	friends list;
+	size_t len = strlen(bench->payload);
+	char *body = malloc(len + 1);
+	memcpy(body, bench->payload, len + 1);
+	if (json_parse_buffer_from_def(body, len, friends_def, &list).kind)
+		abort();
+	json_clean_obj(&list, friends_def);
+}
+
+// what the api did before: a whole cJSON tree, then the fields it needs
+static void run_tournaments_cjson(void *param)
+{
+	json_bench *bench = param;
+	tournaments list;
+	if (json_parse_from_def(cJSON_Parse(bench->payload), tournaments_def, &list).kind)
+		abort();
+	json_clean_obj(&list, tournaments_def);
+}
+
+// the participants and rounds are jumped over through the structural index
+static void run_tournaments_buffer(void *param)
+{
+	json_bench *bench = param;
+	tournaments list;
+	size_t len = strlen(bench->payload);
+	char *body = malloc(len + 1);
+	memcpy(body, bench->payload, len + 1);
+	if (json_parse_buffer_from_def(body, len, tournaments_def, &list).kind)
+		abort();
+	json_clean_obj(&list, tournaments_def);
+}
+
+typedef struct
+{
+	json_index_impl	impl;
+	json_index		index;
+	char			*payload;
+	size_t			len;
+}	index_bench;
+
+static index_bench index_benches[] = {
+	{.impl = json_index_impl_SCALAR},
+	{.impl = json_index_impl_SSE2},
+	{.impl = json_index_impl_AVX2},
+};
+
+static void setup_index(void *param)
+{
+	index_bench *bench = param;
+	bench->payload = make_tournaments_payload();
+	bench->len = strlen(bench->payload);
+	// a missing instruction set falls back to a lower one, whose numbers are
+	// then reported twice
+	json_index_impl impl = json_index_select(bench->impl);
+	if (impl != bench->impl)
+		fprintf(stderr, "json_index: %d not supported, %d used instead\n", bench->impl, impl);
+}
+
+static void run_index(void *param)
+{
+	index_bench *bench = param;
+	if (!json_index_build(&bench->index, bench->payload, bench->len))
+		abort();
+}
+
+static void teardown_index(void *param)
+{
+	index_bench *bench = param;
+	fprintf(stderr, "json_index: %zu bytes, %u entries\n", bench->len, bench->index.count);
+	json_index_deinit(&bench->index);
+	free(bench->payload);
+	json_index_select(json_index_impl_AVX2);
+}
+
+const bench_case bench_json_cases[] = {
+	{"json_def/game_state", setup_game_state, run_game_state_def, teardown_json, &game_state_bench},
+	{"json_def/game_state+cjson", setup_game_state, run_game_state_full, teardown_json, &game_state_bench},
+	{"json_def/friends64", setup_friends, run_friends_def, teardown_json, &friends_bench},
+	{"json_def/friends64+cjson", setup_friends, run_friends_full, teardown_json, &friends_bench},
+	{"json_def/friends64+buffer", setup_friends, run_friends_buffer, teardown_json, &friends_bench},
+	{"json_def/tournaments20+cjson", setup_tournaments, run_tournaments_cjson, teardown_json, &tournaments_bench},
+	{"json_def/tournaments20+buffer", setup_tournaments, run_tournaments_buffer, teardown_json, &tournaments_bench},
+	{"json_index/tournaments20/scalar", setup_index, run_index, teardown_index, &index_benches[0]},
+	{"json_index/tournaments20/sse2", setup_index, run_index, teardown_index, &index_benches[1]},
+	{"json_index/tournaments20/avx2", setup_index, run_index, teardown_index, &index_benches[2]},
+	{NULL}
+};
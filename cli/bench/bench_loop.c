@@ -0,0 +1,137 @@
+#include "bench.h"
+#include "event_loop.h"
+#include "clock.h"
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* GAME FRAME */
+
+// one game frame as the client sees it: a state comes in on the socket and the
+// frame timer fires, the frame is then written to the terminal (a pipe here).
+// the syscalls made by the loop itself and the latency from the state being
+// sent to the frame being written are reported on stderr
+
+# define LATENCY_SAMPLES (1 << 16)
+# define STATE_SIZE 160
+# define FRAME_SIZE 300
+
+typedef struct
+{
+	event_loop_backend	backend;
+	event_loop			loop;
+	event_source		*frame_timer;
+	int					sock[2]; // server, client
+	int					term[2];
+	int					has_state;
+	int					has_tick;
+	int					has_frame;
+	u64					frames;
+	u64					sent_ns;
+	u64					*latencies;
+}	loop_bench;
+
+static loop_bench loop_epoll = {.backend = event_loop_backend_EPOLL};
+static loop_bench loop_uring = {.backend = event_loop_backend_IO_URING};
+
+// the state and the tick can come in any order, or in the same iteration
+static void try_render(loop_bench *bench)
+{
+	static const char frame[FRAME_SIZE] = {0};
+	if (!bench->has_state || !bench->has_tick)
+		return ;
+	if (write(bench->term[1], frame, sizeof(frame)) != sizeof(frame))
+		abort();
+	bench->latencies[bench->frames++ % LATENCY_SAMPLES] = clock_ns() - bench->sent_ns;
+	bench->has_state = 0;
+	bench->has_tick = 0;
+	bench->has_frame = 1;
+}
+
+static void on_state(void *param, u32 events)
+{
+	(void)events;
+	loop_bench *bench = param;
+	char state[STATE_SIZE];
+	if (read(bench->sock[1], state, sizeof(state)) == sizeof(state))
+		bench->has_state = 1;
+	try_render(bench);
+}
+
+static void on_frame_timer(void *param, u32 expirations)
+{
+	(void)expirations;
+	loop_bench *bench = param;
+	bench->has_tick = 1;
+	try_render(bench);
+}
+
+static void setup_loop(void *param)
+{
+	loop_bench *bench = param;
+	if (!event_loop_init_backend(&bench->loop, bench->backend)
+		|| socketpair(AF_UNIX, SOCK_SEQPACKET, 0, bench->sock)
+		|| pipe(bench->term))
+		abort();
+	if (bench->loop.backend != bench->backend)
+		fprintf(stderr, "io_uring not available, the epoll fallback is measured\n");
+	fcntl(bench->term[0], F_SETFL, O_NONBLOCK);
+	bench->latencies = calloc(LATENCY_SAMPLES, sizeof(u64));
+	bench->frame_timer = event_loop_add_timer(&bench->loop, 0, 0, on_frame_timer, bench);
+	if (!bench->latencies || !bench->frame_timer
+		|| !event_loop_add_fd(&bench->loop, bench->sock[1], EPOLLIN, on_state, bench))
+		abort();
+	bench->frames = 0;
+	bench->loop.syscalls = 0;
+}
+
+static void run_frame(void *param)
+{
+	loop_bench *bench = param;
+	static const char state[STATE_SIZE] = {0};
+	bench->sent_ns = clock_ns();
+	if (write(bench->sock[0], state, sizeof(state)) != sizeof(state))
+		abort();
+	event_loop_set_timer(bench->frame_timer, 1000, 0);
+	bench->has_frame = 0;
+	while (!bench->has_frame)
+		if (event_loop_run_once(&bench->loop, -1) < 0)
+			abort();
+	// the terminal reading the frame
+	char frame[FRAME_SIZE];
+	if (read(bench->term[0], frame, sizeof(frame)) != sizeof(frame))
+		abort();
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a;
+	u64 y = *(const u64 *)b;
+	return ((x > y) - (x < y));
+}
+
+static void teardown_loop(void *param)
+{
+	loop_bench *bench = param;
+	size_t count = bench->frames < LATENCY_SAMPLES ? bench->frames : LATENCY_SAMPLES;
+	qsort(bench->latencies, count, sizeof(u64), compare_u64);
+	fprintf(stderr, "  %s: %.2f loop syscalls/frame, p50 %.1fus, p99 %.1fus\n",
+		bench->loop.backend == event_loop_backend_IO_URING ? "io_uring" : "epoll",
+		(double)bench->loop.syscalls / (bench->frames ? bench->frames : 1),
+		count ? bench->latencies[count / 2] / 1000.0 : 0,
+		count ? bench->latencies[count * 99 / 100] / 1000.0 : 0);
+	event_loop_deinit(&bench->loop);
+	close(bench->sock[0]);
+	close(bench->sock[1]);
+	close(bench->term[0]);
+	close(bench->term[1]);
+	free(bench->latencies);
+}
+
+const bench_case bench_loop_cases[] = {
+	{"event_loop_frame/epoll", setup_loop, run_frame, teardown_loop, &loop_epoll},
+	{"event_loop_frame/io_uring", setup_loop, run_frame, teardown_loop, &loop_uring},
+	{NULL}
+};
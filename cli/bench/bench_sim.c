@@ -0,0 +1,56 @@
+#include "bench.h"
+#include "pong_sim.h"
+#include "config.h"
+
+/* PONG SIMULATION */
+
+// one operation is one tick, the ticks per second are 1e9 / ns_per_op. a new
+// game starts with the next seed when one is over
+
+typedef struct
+{
+	pong_sim	sim;
+	u64			seed;
+	int			tracking; // the paddles follow the ball, long rallies
+}	sim_bench;
+
+static sim_bench sim_idle = {0};
+static sim_bench sim_rally = {.tracking = 1};
+
+static void setup_sim(void *param)
+{
+	sim_bench *bench = param;
+	bench->seed = 42;
+	pong_sim_init(&bench->sim, bench->seed);
+}
+
+static u8 track_ball(double paddle_y, double ball_y)
+{
+	if (ball_y < paddle_y - PADDLE_HEIGHT / 4.0)
+		return (pong_input_UP);
+	if (ball_y > paddle_y + PADDLE_HEIGHT / 4.0)
+		return (pong_input_DOWN);
+	return (0);
+}
+
+static void run_sim_step(void *param)
+{
+	sim_bench *bench = param;
+	pong_sim *sim = &bench->sim;
+	u8 left = 0;
+	u8 right = 0;
+	if (bench->tracking)
+	{
+		left = track_ball(sim->left_paddle_y, sim->ball_y);
+		right = track_ball(sim->right_paddle_y, sim->ball_y);
+	}
+	pong_sim_step(sim, left, right);
+	if (sim->winner != pong_side_NONE)
+		pong_sim_init(sim, ++bench->seed);
+}
+
+const bench_case bench_sim_cases[] = {
+	{"pong_sim_step/idle", setup_sim, run_sim_step, NULL, &sim_idle},
+	{"pong_sim_step/rally", setup_sim, run_sim_step, NULL, &sim_rally},
+	{NULL}
+};
@@ -0,0 +1,266 @@
+#include "bench.h"
+#include "term.h"
+#include "pong_render.h"
+#include "spectator_render.h"
+#include <string.h>
+#include <stdlib.h>
+
+/* COMPONENT NAVIGATION */
+
+# define GRID_COLUMNS 10
+# define GRID_ROWS 9
+
+typedef struct
+{
+	direction	dir;
+}	navigation_bench;
+
+static navigation_bench navigation = {0};
+static size_t refresh_next = 0;
+static char grid_names[GRID_ROWS * GRID_COLUMNS][8];
+
+// a window filled with buttons, the worst case for find_best_component() which is
+// quadratic in the number of selectable components
+static void setup_dense_window(void *param)
+{
+	(void)param;
+	cur_term_window_type = term_window_type_DASHBOARD;
+	cur_term_window = &term_windows[cur_term_window_type];
+	memset(cur_term_window, 0, sizeof(*cur_term_window));
+	cur_term_window->has_initiated = 1;
+	cur_term_window->selected_component = -1u;
+	term_window_alloc(cur_term_window, GRID_ROWS * GRID_COLUMNS);
+
+	console_component component;
+	for (int y = 0; y < GRID_ROWS; y++)
+	{
+		for (int x = 0; x < GRID_COLUMNS; x++)
+		{
+			char *name = grid_names[y * GRID_COLUMNS + x];
+			snprintf(name, sizeof(grid_names[0]), "B%d-%d", y, x);
+			button_init(&component, 2 + x * 8, 2 + y * 3, name, NULL, NULL);
+			ccomponent_add(component);
+		}
+	}
+	cur_term_window->selected_component = (GRID_ROWS / 2) * GRID_COLUMNS + GRID_COLUMNS / 2;
+}
+
+static void teardown_window(void *param)
+{
+	(void)param;
+	term_window_free(cur_term_window);
+	memset(cur_term_window, 0, sizeof(*cur_term_window));
+	cur_term_window = NULL;
+}
+
+static void run_find_best_component(void *param)
+{
+	navigation_bench *bench = param;
+	bench->dir = bench->dir % DOWN + 1;
+	if (find_best_component(bench->dir) == -1u)
+		abort();
+}
+
+// one button changed since the previous refresh, out of 90
+static void run_crefresh_one_dirty(void *param)
+{
+	size_t *next = param;
+	*next = (*next + 7) % (GRID_ROWS * GRID_COLUMNS);
+	mark_dirty(&cur_term_window->components[*next], 0);
+	crefresh(0);
+}
+
+/* PONG */
+
+typedef struct
+{
+	u16				width;
+	u16				height;
+	frame_detail	detail;
+	game_state		state;
+}	pong_bench;
+
+static pong_bench pong_small = {.width = 80, .height = 24};
+static pong_bench pong_medium = {.width = 160, .height = 48};
+static pong_bench pong_large = {.width = 320, .height = 90};
+static pong_bench pong_large_reduced = {.width = 320, .height = 90, .detail = frame_detail_REDUCED};
+
+static void setup_pong(void *param)
+{
+	pong_bench *bench = param;
+	c_x = bench->width;
+	c_y = bench->height;
+	bench->state.gameState.ballX = ARENA_WIDTH * 0.51;
+	bench->state.gameState.ballY = ARENA_HEIGHT * 0.4;
+	bench->state.gameState.leftPaddleY = ARENA_HEIGHT * 0.47;
+	bench->state.gameState.rightPaddleY = ARENA_HEIGHT * 0.6;
+	bench->state.gameState.leftScore = 2;
+	bench->state.gameState.rightScore = 3;
+	bench->state.gameState.gameOver = 0;
+}
+
+static void run_pong(void *param)
+{
+	pong_bench *bench = param;
+	render_pong_scene(&bench->state, bench->detail);
+}
+
+/* SPECTATOR */
+
+typedef struct
+{
+	size_t			games;
+	size_t			moving; // games that get a new state for each frame
+	size_t			frame;
+	spectator_view	view;
+}	spectator_bench;
+
+static spectator_bench spectator_4 = {.games = 4, .moving = 4};
+static spectator_bench spectator_16 = {.games = 16, .moving = 16};
+static spectator_bench spectator_16_1_moving = {.games = 16, .moving = 1};
+
+static void spectator_bench_state(game_state *state, size_t game, size_t frame)
+{
+	*state = (game_state){0};
+	state->gameState.ballX = (ARENA_WIDTH / 4 + game * 37 + frame * 7) % ARENA_WIDTH;
+	state->gameState.ballY = (ARENA_HEIGHT / 4 + game * 23 + frame * 5) % ARENA_HEIGHT;
+	state->gameState.leftPaddleY = ARENA_HEIGHT / 2 + (frame % 40) * 2;
+	state->gameState.rightPaddleY = ARENA_HEIGHT / 2 - (frame % 40) * 2;
+	state->gameState.leftScore = game % 5;
+	state->gameState.rightScore = 2;
+}
+
+// the first frame, with the screen clear, is not measured
+static void setup_spectator(void *param)
+{
+	spectator_bench *bench = param;
+	c_x = 160;
+	c_y = 48;
+	spectator_init(&bench->view);
+	for (size_t i = 0; i < bench->games; i++)
+	{
+		game_state state;
+		spectator_bench_state(&state, spectator_add_game(&bench->view), 0);
+		spectator_set_state(&bench->view, i, &state);
+	}
+	spectator_draw(&bench->view, frame_detail_FULL);
+}
+
+static void teardown_spectator(void *param)
+{
+	spectator_bench *bench = param;
+	spectator_deinit(&bench->view);
+}
+
+static void run_spectator(void *param)
+{
+	spectator_bench *bench = param;
+	bench->frame++;
+	for (size_t i = 0; i < bench->moving; i++)
+	{
+		game_state state;
+		spectator_bench_state(&state, i, bench->frame);
+		spectator_set_state(&bench->view, i, &state);
+	}
+	spectator_draw(&bench->view, frame_detail_FULL);
+}
+
+/* COMPONENTS */
+
+typedef struct
+{
+	console_component	component;
+	const char			*text;
+	int					wrap_around;
+	u16					w;
+	u16					h;
+}	component_bench;
+
+static component_bench label_short = {.text = "Player number 12"};
+static component_bench label_wrapped = {.text = "player_42 has invited you to play a game, accept before it expires !!", .wrap_around = 25};
+static component_bench box_small = {.w = 30, .h = 14};
+static component_bench box_large = {.w = 78, .h = 22};
+
+static void setup_label(void *param)
+{
+	component_bench *bench = param;
+	label_init(&bench->component, 38, 5, bench->text);
+	if (bench->wrap_around)
+		label_wrap_around(&bench->component, bench->wrap_around);
+}
+
+static void run_label_draw(void *param)
+{
+	component_bench *bench = param;
+	label_draw(&bench->component);
+}
+
+// replacing the text also clears the previous one on the next draw
+static void run_label_update_draw(void *param)
+{
+	component_bench *bench = param;
+	label_update_text(&bench->component, bench->text);
+	label_draw(&bench->component);
+}
+
+// a score, formatted into the label's own storage
+static void run_label_printf_draw(void *param)
+{
+	component_bench *bench = param;
+	label_printf(&bench->component, "%d", bench->wrap_around);
+	label_draw(&bench->component);
+}
+
+static void setup_box(void *param)
+{
+	component_bench *bench = param;
+	box_init(&bench->component, 4, 4, bench->w, bench->h, DEFAULT_BOX_STYLE);
+}
+
+// same, on a terminal that was found to support REP and ECH
+static void setup_box_caps(void *param)
+{
+	setup_box(param);
+	c_caps.rep = 1;
+	c_caps.ech = 1;
+}
+
+static void teardown_caps(void *param)
+{
+	(void)param;
+	memset(&c_caps, 0, sizeof(c_caps));
+}
+
+static void setup_label_caps(void *param)
+{
+	setup_label(param);
+	c_caps.rep = 1;
+	c_caps.ech = 1;
+}
+
+static void run_box_draw(void *param)
+{
+	component_bench *bench = param;
+	box_draw(&bench->component);
+}
+
+const bench_case bench_term_cases[] = {
+	{"find_best_component/90_buttons", setup_dense_window, run_find_best_component, teardown_window, &navigation},
+	{"crefresh/90_buttons_1_dirty", setup_dense_window, run_crefresh_one_dirty, teardown_window, &refresh_next},
+	{"render_pong_scene/80x24", setup_pong, run_pong, NULL, &pong_small},
+	{"render_pong_scene/160x48", setup_pong, run_pong, NULL, &pong_medium},
+	{"render_pong_scene/320x90", setup_pong, run_pong, NULL, &pong_large},
+	{"render_pong_scene/320x90_reduced", setup_pong, run_pong, NULL, &pong_large_reduced},
+	{"spectator_draw/160x48_4_games", setup_spectator, run_spectator, teardown_spectator, &spectator_4},
+	{"spectator_draw/160x48_16_games", setup_spectator, run_spectator, teardown_spectator, &spectator_16},
+	{"spectator_draw/160x48_16_games_1_moving", setup_spectator, run_spectator, teardown_spectator, &spectator_16_1_moving},
+	{"label_draw/short", setup_label, run_label_draw, NULL, &label_short},
+	{"label_draw/wrapped", setup_label, run_label_draw, NULL, &label_wrapped},
+	{"label_update_text+draw/short", setup_label, run_label_update_draw, NULL, &label_short},
+	{"label_printf+draw/score", setup_label, run_label_printf_draw, NULL, &label_short},
+	{"box_draw/30x14", setup_box, run_box_draw, NULL, &box_small},
+	{"box_draw/78x22", setup_box, run_box_draw, NULL, &box_large},
+	{"box_draw/78x22+rep", setup_box_caps, run_box_draw, teardown_caps, &box_large},
+	{"label_update_text+draw/short+ech", setup_label_caps, run_label_update_draw, teardown_caps, &label_short},
+	{NULL}
+};
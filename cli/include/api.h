@@ -4,10 +4,13 @@
 # include "json_def.h"
 # include "curl/curl.h"
 # include "config.h"
+# include "net.h"
 
 typedef struct
 {
 	CURL				*curl;
+	CURLM				*multi; // owned by ctx, shared with ws_ctx
+	net_transfer		transfer;
 	struct curl_slist	*header_list; // only there so it can be deallocated later
 
 	char				in_buf[JSON_BUFFER_SIZE];
@@ -18,19 +21,65 @@ typedef struct
 	const char			*api_base_url;
 	char				api_url_buf[1000];
 	size_t				api_url_base_len;
+	u64					token_hash; // identifies the current user for api_cache_entry
 }	api_ctx;
 
+typedef enum
+{
+	api_cache_result_NOT_MODIFIED,
+	api_cache_result_UPDATED
+}	api_cache_result;
+
+typedef struct s_api_cache_entry api_cache_entry;
+
+// called from the multi handle's completion, once `out` holds the revalidated value
+typedef void (api_cache_done_func)(api_cache_entry *entry, api_cache_result result, void *param);
+
+// conditional-GET cache of one endpoint. the parsed object given to
+// api_cache_revalidate() is the cached value: it is kept untouched when the
+// server answers 304 Not Modified
+struct s_api_cache_entry
+{
+	const char			*endpoint;
+	u64					token_hash;
+	char				etag[128];
+	char				last_modified[64];
+	int					has_value;
+
+	// revalidation running on its own handle, in the background
+	api_ctx				*api;
+	json_def			*def;
+	void				*out;
+	api_cache_done_func	*on_done;
+	void				*param;
+	u64					fetch_token_hash;
+	net_transfer		fetch;
+	struct curl_slist	*fetch_headers;
+	char				fetch_buf[JSON_BUFFER_SIZE];
+	size_t				fetch_buf_cursor;
+	char				url_buf[1100];
+};
+
 typedef enum
 {
 	POST,
 	GET
 }	request_type;
 
-int	api_ctx_init(api_ctx *ctx, const char *api_base_url);
+int	api_ctx_init(api_ctx *ctx, const char *api_base_url, CURLM *multi, CURLSH *share);
+// queues the connectivity probe on the multi handle, completion is reported by
+// ctx_wait_connected()
+int api_ctx_probe_start(api_ctx *ctx);
+// performs the current request through the multi handle, so that connections
+// (including the probe's one) are reused between requests. the calling (main)
+// thread blocks until it is done, only the background transfers
+// (api_cache_revalidate(), paged_list) keep progressing meanwhile
+CURLcode api_ctx_perform(api_ctx *ctx);
 int api_ctx_set_token(api_ctx *ctx, const char *token);
 void api_ctx_remove_token(api_ctx *ctx);
 void api_ctx_deinit(api_ctx *ctx);
 
+// blocking, see api_ctx_perform()
 void do_api_request_to_def(
 	api_ctx *ctx,
 	const char *endpoint,
@@ -38,6 +87,28 @@ void do_api_request_to_def(
 	json_def *def,
 	void *out);
 
+// GETs `endpoint` on the multi handle with If-None-Match/If-Modified-Since when
+// `entry` holds a value fetched with the current token. `out` is only cleaned
+// and reparsed on a 200, then `on_done` is called. does nothing if a
+// revalidation of `entry` is already running
+int api_cache_revalidate(
+	api_ctx *ctx,
+	api_cache_entry *entry,
+	const char *endpoint,
+	json_def *def,
+	void *out,
+	api_cache_done_func *on_done,
+	void *param);
+
+static inline int api_cache_is_fresh_for(const api_ctx *ctx, const api_cache_entry *entry)
+{
+	return (entry->has_value && entry->token_hash == ctx->token_hash);
+}
+
+void api_cache_invalidate(api_cache_entry *entry);
+// drops the running revalidation without calling its `on_done`
+void api_cache_cancel(api_cache_entry *entry);
+
 cJSON *do_api_request(
 	api_ctx *ctx,
 	const char *endpoint,
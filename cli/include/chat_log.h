@@ -0,0 +1,45 @@
+#ifndef CHAT_LOG_H
+# define CHAT_LOG_H
+
+// history of the chat and direct messages received over the websocket.
+// CHAT_LOG_CAPACITY slots of a fixed size, allocated at once: once they are
+// all used the oldest message is overwritten, so the memory used doesn't
+// depend on how busy the channels are
+
+# include "types.h"
+# include "config.h"
+# include <stddef.h>
+
+typedef enum
+{
+	chat_kind_CHANNEL,
+	chat_kind_DM_RECEIVED,
+	chat_kind_DM_SENT,
+}	chat_kind;
+
+typedef struct
+{
+	chat_kind	kind;
+	int			user_id;
+	u16			from_len;
+	u16			text_len;
+	char		from[CHAT_NAME_MAX];
+	char		text[CHAT_TEXT_MAX]; // truncated, control characters replaced
+}	chat_entry;
+
+typedef struct
+{
+	chat_entry	*slots;
+	u64			total; // messages ever pushed, the newest one is `total - 1`
+}	chat_log;
+
+void				chat_log_init(chat_log *log);
+void				chat_log_deinit(chat_log *log);
+// both strings are copied
+void				chat_log_push(chat_log *log, chat_kind kind, int user_id, const char *from, const char *text);
+// messages still stored
+size_t				chat_log_count(const chat_log *log);
+// `age` 0 is the newest message. NULL if it isn't stored (anymore)
+const chat_entry	*chat_log_get(const chat_log *log, u64 age);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef CLOCK_H
+# define CLOCK_H
+
+# include "types.h"
+# include <time.h>
+
+// monotonic time in nanoseconds, only meaningful when compared to another call
+static inline u64 clock_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec);
+}
+
+# define NS_TO_MS(ns) ((double)(ns) / 1000000.0)
+
+#endif
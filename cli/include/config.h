@@ -2,7 +2,50 @@
 # define CONFIG_H
 
 # define JSON_BUFFER_SIZE 30000
+// nesting allowed in documents parsed by json_parse_buffer_from_def()
+# define JSON_MAX_DEPTH 64
 # define MAX_WS_TIMEOUT 5000
+// messages queued between the websocket thread and the main one, power of two
+# define WS_RING_SIZE 64
+// show cached lists right away, while they are being revalidated in the background
+# define API_CACHE_STALE_WHILE_REVALIDATE 1
+# define TOURNAMENT_PAGE_SIZE 20
+// how close to the edge of a page the cursor has to be to prefetch the next one
+# define PAGED_LIST_PREFETCH_DISTANCE 3
+// a page body bigger than this fails, its buffer grows up to it
+# define PAGED_LIST_MAX_PAGE_BYTES (1 << 20)
+// number of events kept by the -t tracing mode, must be a power of two
+# define TRACE_RING_SIZE (1 << 16)
+// callbacks an event loop can have deferred at once
+# define EVENT_LOOP_MAX_DEFERRED 32
+// how many ready sources are fetched by one epoll_wait()
+# define EVENT_LOOP_MAX_EVENTS 32
+// size of the submission queue of the io_uring backend
+# define EVENT_LOOP_URING_ENTRIES 64
+// how long the terminal has to answer the capability and size queries
+# define TERM_PROBE_TIMEOUT_MS 300
+// texts copied into labels that fit are stored in the label itself, the longer
+// ones in the arena of its window, allocated by chunks of that size
+# define LABEL_INLINE_SIZE 24
+# define TEXT_ARENA_CHUNK_SIZE 4096
+// messages kept by the chat pane, power of two, and how much of each is kept
+# define CHAT_LOG_CAPACITY 256
+# define CHAT_NAME_MAX 24
+# define CHAT_TEXT_MAX 200
+// messages arriving in a burst are drawn together, at most once per interval
+# define CHAT_REDRAW_INTERVAL_MS 50
+
+// the time waited in the matchmaking queue is shown to the second
+# define MATCHMAKING_TICK_MS 1000
+
+// game frame pacing on slow terminals (the server sends 60 states per second)
+# define GOVERNOR_MAX_FPS 60
+# define GOVERNOR_MIN_FPS 10
+// how much faster than needed the terminal has to be for a frame rate to be kept
+# define GOVERNOR_HEADROOM 1.25
+
+// games shown at once by the spectator renderer, each in a tile of the terminal
+# define SPECTATOR_MAX_GAMES 16
 
 # define ARENA_WIDTH 800
 # define ARENA_HEIGHT 400
@@ -12,6 +55,9 @@
 # define BALL_SPEED 300
 # define PADDLE_SPEED 350
 # define WINNING_SCORE 5
+// the server steps its games at this rate, and by at most PONG_MAX_DT seconds
+# define PONG_TICK_HZ 60
+# define PONG_MAX_DT (1.0 / 30)
 
 typedef enum
 {
@@ -24,6 +70,8 @@ typedef enum
 	term_window_type_PONG_GET_READY,
 	term_window_type_PONG_GAME,
 	term_window_type_PONG_GAME_OVER,
+	term_window_type_CHAT,
+	term_window_type_MATCHMAKING,
 	term_window_type__MAX
 }	term_window_type;
 
@@ -6,25 +6,59 @@
 # include "api.h"
 # include "term.h"
 # include "ws.h"
+# include "share.h"
+# include "friends_store.h"
+# include "paged_list.h"
 # include "json_defs.h"
+# include "event_loop.h"
+# include "chat_log.h"
+# include "matchmaking.h"
 
 # define C(x) console_component *x
 
+typedef enum
+{
+	startup_phase_CURL_INIT,
+	startup_phase_X11_OPEN,
+	startup_phase_KEYBOARD_GRAB,
+	startup_phase_TERM_INIT,
+	startup_phase_WINDOWS_INIT,
+	startup_phase_API_PROBE,
+	startup_phase_WS_HANDSHAKE,
+	startup_phase_TOTAL,
+	startup_phase__MAX
+}	startup_phase;
+
+typedef struct
+{
+	u64	begin_ns;
+	u64	end_ns;
+}	startup_timing;
+
 typedef struct s_ctx
 {
+	int						verbose;
+	startup_timing			startup[startup_phase__MAX];
+	CURLM					*curl_multi;
+	share_ctx				share_ctx;
 	Display					*dpy;
 	Window					root_win;
 	input_state				input;
 	ws_ctx					ws_ctx;
 	api_ctx					api_ctx;
 	login					user_login;
-	tournaments				tournaments;
+	paged_list				tournament_pages; // pages of `tournaments`
 	friends					friends;
+	api_cache_entry			friends_cache;
+	friends_store			friends_store;
 	friend_pong_invite		pong_invite;
 	friend_pong_accepted	pong_accepted;
 	int						i_was_invited;
 	int						i_am_ready;
 	int						opponent_ready;
+	chat_log				chat_log;
+	matchmaking				matchmaking;
+	event_loop				*ui_loop; // while input_loop() runs
 
 	struct
 	{
@@ -51,6 +85,8 @@ typedef struct s_ctx
 		list_view list_view;
 		friend *selected_friend;
 		C(friend_name);
+		C(friend_status);
+		C(friend_record);
 		C(friend_challenge_text);
 	}	friends_view;
 	struct
@@ -67,11 +103,34 @@ typedef struct s_ctx
 		C(your_score);
 		C(opponent_score);
 	}	game_over_view;
+	struct
+	{
+		C(pane);
+		event_source	*redraw_timer; // of ui_loop
+		int				redraw_pending;
+	}	chat_view;
+	struct
+	{
+		C(status);
+		C(waited);
+		C(estimate);
+		C(error); // the server's answer to a join it refused
+		event_source	*tick_timer; // of ui_loop, while in the queue
+	}	matchmaking_view;
 }   ctx;
 
 # undef C
 
+// starts the REST probe and the websocket handshake in the background and sets
+// up X11 while they progress. ctx_wait_connected() has to be called afterwards,
+// ideally once the terminal is set up too
 int ctx_init(ctx *ctx, const char *api_endpoint_base, const char *ws_endpoint);
+// drives the pending connections to completion, exits on failure
+void ctx_wait_connected(ctx *ctx);
 void ctx_deinit(ctx *ctx);
 
+void ctx_phase_begin(ctx *ctx, startup_phase phase);
+void ctx_phase_end(ctx *ctx, startup_phase phase);
+void ctx_print_startup_report(ctx *ctx, FILE *stream);
+
 #endif
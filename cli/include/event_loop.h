@@ -0,0 +1,138 @@
+#ifndef EVENT_LOOP_H
+# define EVENT_LOOP_H
+
+// single reactor. fds, monotonic timers (timerfd) and signals (signalfd) are
+// all sources of one loop, and deferred callbacks run once the ready sources
+// of an iteration were dispatched. sources are level triggered, and a loop can
+// be nested in another one through event_loop_fd().
+// two backends: epoll, and io_uring where one-shot polls and the reads of the
+// timer and signal fds are queued and re-armed in batches, submitted with the
+// wait of the next iteration. io_uring falls back to epoll when not available
+
+# include "types.h"
+# include "config.h"
+# include <sys/epoll.h>
+# include <sys/signalfd.h>
+
+// `arg` is the epoll events for fds, the number of expirations for timers and
+// the signal number for signals
+typedef void (event_func)(void *param, u32 arg);
+
+typedef enum
+{
+	event_loop_backend_EPOLL,
+	event_loop_backend_IO_URING,
+}	event_loop_backend;
+
+typedef enum
+{
+	event_source_FD,
+	event_source_TIMER,
+	event_source_SIGNAL,
+}	event_source_type;
+
+typedef struct s_event_source event_source;
+
+struct s_event_source
+{
+	event_source_type	type;
+	int					fd;
+	int					signo;
+	int					was_blocked; // signals only, by an outer loop, kept blocked on removal
+	u32					events;
+	event_func			*func;
+	void				*param;
+	int					removed;
+	event_source		*next;
+	// io_uring only
+	int					armed; // a poll or read is queued for the source
+	int					pending; // operations not completed yet, it can't be freed before
+	union
+	{
+		u64						expirations;
+		struct signalfd_siginfo	siginfo;
+	}					buf; // read into by the kernel
+};
+
+typedef struct
+{
+	event_func	*func;
+	void		*param;
+}	event_deferred;
+
+// the rings shared with the kernel, mapped by uring_init()
+typedef struct
+{
+	int					fd;
+	void				*ring;
+	size_t				ring_size;
+	struct io_uring_sqe	*sqes;
+	size_t				sqes_size;
+	unsigned			*sq_head;
+	unsigned			*sq_tail;
+	unsigned			*sq_mask;
+	unsigned			*sq_array;
+	unsigned			*cq_head;
+	unsigned			*cq_tail;
+	unsigned			*cq_mask;
+	struct io_uring_cqe	*cqes;
+	unsigned			to_submit;
+}	event_uring;
+
+typedef struct
+{
+	event_loop_backend	backend;
+	int					epoll_fd;
+	event_uring			uring;
+	int					running;
+	int					dispatching; // depth, the loop can be run from one of its callbacks
+	event_source		*sources;
+	event_source		*removed; // freed once nothing is being dispatched
+	event_deferred		deferred[EVENT_LOOP_MAX_DEFERRED];
+	size_t				deferred_count;
+	u64					syscalls; // made by the loop itself, for the benchmarks
+}	event_loop;
+
+// backend used by event_loop_init()
+extern event_loop_backend	event_loop_default_backend;
+
+int				event_loop_init(event_loop *loop);
+// falls back to epoll if `backend` isn't available
+int				event_loop_init_backend(event_loop *loop, event_loop_backend backend);
+void			event_loop_deinit(event_loop *loop);
+// readable when the loop has something to dispatch, to nest it in another one.
+// an io_uring loop only submits its queued polls when it runs, so a nested loop
+// should use epoll
+int				event_loop_fd(event_loop *loop);
+
+// `fd` stays owned by the caller
+event_source	*event_loop_add_fd(event_loop *loop, int fd, u32 events, event_func *func, void *param);
+int				event_loop_modify_fd(event_loop *loop, event_source *source, u32 events);
+// fires after `delay_ns` then every `interval_ns` (once if 0)
+event_source	*event_loop_add_timer(event_loop *loop, u64 delay_ns, u64 interval_ns, event_func *func, void *param);
+// a delay of 0 disarms the timer
+void			event_loop_set_timer(event_source *timer, u64 delay_ns, u64 interval_ns);
+// `signo` is blocked while the source exists
+event_source	*event_loop_add_signal(event_loop *loop, int signo, event_func *func, void *param);
+// safe from any callback, including the source's own
+void			event_loop_remove(event_loop *loop, event_source *source);
+
+// runs `func` once the current iteration is over (or the next one, outside of
+// a callback). when too many are pending, `func` runs right away
+void			event_loop_defer(event_loop *loop, event_func *func, void *param);
+
+// waits up to `timeout_ms` (-1 for ever) for sources to be ready and dispatches
+// them. returns the number of sources dispatched, -1 on error
+int				event_loop_run_once(event_loop *loop, int timeout_ms);
+// runs until event_loop_stop(). returns 0 on error
+int				event_loop_run(event_loop *loop);
+void			event_loop_stop(event_loop *loop);
+
+// io_uring backend, see event_loop_uring.c
+int				uring_init(event_loop *loop);
+void			uring_deinit(event_loop *loop);
+void			uring_arm(event_loop *loop, event_source *source);
+void			uring_cancel(event_loop *loop, event_source *source);
+int				uring_run_once(event_loop *loop, int timeout_ms);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef FRAME_GOVERNOR_H
+# define FRAME_GOVERNOR_H
+
+// paces the game frames on what the terminal actually absorbs. frames are
+// rendered in memory and written without blocking: a frame that is still
+// queued when a newer one comes in is dropped, and the frame rate, then the
+// detail level, go down when the measured throughput can't keep up
+
+# include "types.h"
+# include <stdio.h>
+
+typedef enum
+{
+	frame_detail_FULL,
+	frame_detail_REDUCED,
+}	frame_detail;
+
+typedef struct
+{
+	char	*buf;
+	size_t	len;
+	size_t	cap;
+	size_t	off; // bytes already written
+}	frame_buffer;
+
+typedef struct
+{
+	int				is_active;
+	// the terminal opened again, so that O_NONBLOCK isn't set on the open file
+	// description stdout shares with stdin and stderr. -1 when stdout isn't a
+	// terminal, stdout is then polled before each write
+	int				tty_fd;
+
+	FILE			*frame_stream; // open during frame_governor_frame_begin/end
+	char			*frame_stream_buf;
+	size_t			frame_stream_len;
+
+	frame_buffer	inflight; // partially written, has to be finished
+	frame_buffer	next; // latest frame, replaced by newer ones
+
+	frame_detail	detail;
+	u64				frame_interval_ns;
+	u64				last_frame_ns;
+	double			avg_frame_bytes;
+
+	// throughput is only measured while bytes are waiting for the terminal
+	u64				busy_since_ns;
+	u64				window_bytes;
+	u64				window_ns;
+	double			throughput; // bytes per second, 0 until measured
+
+	u64				frames_rendered;
+	u64				frames_skipped;
+}	frame_governor;
+
+void			frame_governor_begin(frame_governor *gov);
+// whether a new frame should be rendered now
+int				frame_governor_should_render(frame_governor *gov);
+// redirects the terminal output to the frame being built
+void			frame_governor_frame_begin(frame_governor *gov);
+void			frame_governor_frame_end(frame_governor *gov);
+// writes what the terminal accepts without blocking. returns the pending bytes
+size_t			frame_governor_pump(frame_governor *gov);
+// writes the remaining bytes (blocking)
+void			frame_governor_end(frame_governor *gov);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef FRIENDS_STORE_H
+# define FRIENDS_STORE_H
+
+# include "json_defs.h"
+
+// id -> position index over the `friends` list fetched from api/friends, so
+// that websocket events can patch the list in place between two revalidations
+typedef struct
+{
+	friends	*friends;
+	i64		*slots; // open addressing, position in friends->data.arr or -1
+	size_t	slots_cap; // power of two
+	int		is_live;
+}	friends_store;
+
+void friends_store_rebuild(friends_store *store, friends *friends);
+// returns NULL if `id` isn't a friend, `pos` receives its position in the list
+friend *friends_store_find(friends_store *store, int id, i64 *pos);
+// events are ignored until the list is fetched again
+void friends_store_invalidate(friends_store *store);
+void friends_store_deinit(friends_store *store);
+
+#endif
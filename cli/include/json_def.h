@@ -16,22 +16,51 @@ typedef enum
 	JSON_DOUBLE_N = JSON_DOUBLE | cJSON_NULL,
 	JSON_STRING = cJSON_String,
 	JSON_STRING_N = JSON_STRING | cJSON_NULL,
+	JSON_STRV = cJSON_String | (1 << 9),
+	JSON_STRV_N = JSON_STRV | cJSON_NULL,
 	JSON_ARRAY = cJSON_Array,
 	// JSON_ARRAY_N = JSON_ARRAY | cJSON_NULL,
 	JSON_OBJECT = cJSON_Object,
 	JSON_OBJECT_N = JSON_OBJECT | cJSON_NULL
 }	json_type;
 
+// string left where it is in the parsed message. when the message was parsed
+// by json_parse_buffer_from_def(), `ptr` points into its buffer and is only
+// unescaped by json_strv_cstr(). either way, `len` is the length of `ptr`
+typedef struct
+{
+	const char	*ptr;
+	u32			len;
+	u8			escaped;
+}	json_strv;
+
+// lookup table of a json_def table, built the first time the table is used
+// (see json_def.c). fields are found by hash, and the fields seen in an object
+// are a bitmask compared to `required` once the object was walked
+typedef struct json_def_index
+{
+	u32		count;
+	u32		mask; // of `slots`
+	u64		required; // one bit per field, every field is required
+	u32		*hashes; // of each field name
+	u8		*slots; // field index + 1, 0 when empty
+}	json_def_index;
+
+// at most one bit per field in json_def_index.required
+# define JSON_DEF_MAX_FIELDS 64
+
 typedef struct json_def
 {
-	const char *const	name;
-	size_t				offset;
-	json_type			type;
-	struct json_def		*recursive_object; // if type == JSON_OBJECT or JSON_ARRAY
-	size_t				element_len; // if type == JSON_ARRAY
+	const char *const		name;
+	size_t					name_len;
+	size_t					offset;
+	json_type				type;
+	struct json_def			*recursive_object; // if type == JSON_OBJECT or JSON_ARRAY
+	size_t					element_len; // if type == JSON_ARRAY
+	json_def_index			*index; // only set on the first entry of a table
 }	json_def;
 
-# define DEF_END {NULL, 0, JSON_INVALID, NULL}
+# define DEF_END {.name = NULL, .type = JSON_INVALID}
 
 # define GLUE_I(x, y) x ## y
 # define GLUE(x, y) GLUE_I(x, y)
@@ -53,6 +82,8 @@ typedef struct json_def
 # define _DEF_DOUBLE_N(x)	_NULLABLE(double)
 # define _DEF_STRING(x)		const char *
 # define _DEF_STRING_N(x)	_NULLABLE(const char *)
+# define _DEF_STRV(x)		json_strv
+# define _DEF_STRV_N(x)		_NULLABLE(json_strv)
 # define _DEF_OBJECT(x)		x
 # define _DEF_OBJECT_N(x)	_NULLABLE(x)
 # define _DEF_ARRAY(x)		_ARRAY(x)
@@ -66,10 +97,12 @@ typedef struct json_def
 # define _REC_DOUBLE_N(...)
 # define _REC_STRING(...)
 # define _REC_STRING_N(...)
-# define _REC_OBJECT(recursive_object_name) GLUE(recursive_object_name, _def)
-# define _REC_OBJECT_N(recursive_object_name) GLUE(recursive_object_name, _def)
-# define _REC_ARRAY(recursive_object_name) GLUE(recursive_object_name, _def), sizeof(recursive_object_name)
-# define _REC_ARRAY_N(recursive_object_name) GLUE(recursive_object_name, _def), sizeof(recursive_object_name)
+# define _REC_STRV(...)
+# define _REC_STRV_N(...)
+# define _REC_OBJECT(recursive_object_name) .recursive_object = GLUE(recursive_object_name, _def)
+# define _REC_OBJECT_N(recursive_object_name) .recursive_object = GLUE(recursive_object_name, _def)
+# define _REC_ARRAY(recursive_object_name) .recursive_object = GLUE(recursive_object_name, _def), .element_len = sizeof(recursive_object_name)
+# define _REC_ARRAY_N(recursive_object_name) .recursive_object = GLUE(recursive_object_name, _def), .element_len = sizeof(recursive_object_name)
 
 # define PARENS ()
 # define EVALUATE(...) EVALUATE1(EVALUATE1(__VA_ARGS__))
@@ -95,9 +128,10 @@ typedef struct json_def
 
 # define DEF_CONSTRUCTOR(struct_name, field_type, field_name, ...)	\
 	{																\
-		#field_name,												\
-		(size_t)&((struct_name *)0)->field_name,					\
-		GLUE(JSON_, field_type),									\
+		.name = #field_name,										\
+		.name_len = sizeof(#field_name) - 1,						\
+		.offset = (size_t)&((struct_name *)0)->field_name,			\
+		.type = GLUE(JSON_, field_type),							\
 		GLUE(_REC_, field_type)(__VA_ARGS__)						\
 	},
 
@@ -130,7 +164,12 @@ typedef enum
 typedef struct
 {
 	json_error_kind	kind;
-	cJSON			*node;
+	cJSON			*node; // from json_parse_from_def()
+	// from json_parse_buffer_from_def(): where the reader stopped, and the
+	// innermost field it was in (or the first one missing), NULL at the top level
+	u8				in_buffer;
+	u32				offset;
+	const char		*field;
 }	json_content_error;
 
 # define json_content_error_make(_kind, ...) (json_content_error){.kind = _kind __VA_OPT__(, .node = __VA_ARGS__)}
@@ -142,7 +181,16 @@ void json_content_error_print(FILE *stream, json_content_error err);
  parses the cJSON object, following directions from `defs`, outputting values to `out`
 */
 json_content_error json_parse_from_def(cJSON *obj, const json_def *defs, void *out);
+/*
+ parses the `len` bytes of `buf` (followed by a NUL) in place, without building a
+ cJSON tree. strings are not copied, they point into `buf`: it must come from
+ malloc and belongs to the parsed object from then on, even on error.
+ on error, what was parsed is already freed and `out` needs no cleaning
+*/
+json_content_error json_parse_buffer_from_def(char *buf, size_t len, const json_def *defs, void *out);
 void json_clean_obj(void *in, const json_def *defs);
+// unescapes the view in place the first time, then returns `view->ptr`
+const char *json_strv_cstr(json_strv *view);
 /*
  parses the cJSON object, following directions from `defs`, outputting values to `out`,
  and quits on error
@@ -24,14 +24,16 @@ DEFINE_JSON(login,
 	(OBJECT, data, login_data)
 );
 
+// the friends list is parsed from its buffer, the names are only unescaped
+// when they are shown
 DEFINE_JSON(friend,
 	(INT, id),
-	(STRING, username),
-	(STRING, display_name),
+	(STRV, username),
+	(STRV, display_name),
 	(INT, is_online), // int ???
 	(INT, total_wins),
 	(INT, total_losses),
-	(STRING, created_at)
+	(STRV, created_at)
 );
 
 DEFINE_JSON(friends,
@@ -75,6 +77,42 @@ DEFINE_JSON(friend_pong_accepted,
 	(STRING, role),
 );
 
+DEFINE_JSON(friend_status_update,
+	(INT, userId),
+	(BOOL, isOnline)
+);
+
+DEFINE_JSON(friend_stats_update,
+	(INT, userId),
+	(INT, totalWins),
+	(INT, totalLosses)
+);
+
+// the room and the timestamp aren't always there
+DEFINE_JSON(chat_message,
+	(INT, userId),
+	(STRING, message)
+);
+
+DEFINE_JSON(direct_message_content,
+	(INT, sender_id),
+	(STRING, content)
+);
+
+DEFINE_JSON(direct_message_data,
+	(OBJECT, message, direct_message_content)
+);
+
+// direct_message_received and the acknowledgement direct_message_sent
+DEFINE_JSON(direct_message,
+	(OBJECT, data, direct_message_data)
+);
+
+DEFINE_JSON(matchmaking_waiting,
+	(INT, position),
+	(INT, totalInQueue)
+);
+
 DEFINE_JSON(game_state_state,
 	(DOUBLE, ballX),
 	(DOUBLE, ballY),
@@ -139,6 +177,16 @@ DEFINE_JSON(game_state,
 		REQ_ENTRY_LAST("gameId")						\
 	), game_id)
 
+# define REQ_WS_MATCHMAKING_JOIN(buf)					\
+	FILL_REQUEST(buf, REQ_WRAP(							\
+		REQ_ENTRY_LAST("type", "\"matchmaking:join\"")	\
+	))
+
+# define REQ_WS_MATCHMAKING_LEAVE(buf)					\
+	FILL_REQUEST(buf, REQ_WRAP(							\
+		REQ_ENTRY_LAST("type", "\"matchmaking:leave\"")	\
+	))
+
 # define REQ_WS_INPUT_UPDATE(buf, up, down)					\
 	FILL_REQUEST(buf, REQ_WRAP(								\
 		REQ_ENTRY("type", "\"simple_pong_input\"")			\
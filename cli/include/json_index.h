@@ -0,0 +1,37 @@
+#ifndef JSON_INDEX_H
+# define JSON_INDEX_H
+
+// structural index of a JSON buffer, built in one vectorised pass before it is
+// parsed: the positions of the structural characters outside of strings
+// ({ } [ ] : ,) and of both quotes of every string. each opening bracket also
+// knows the entry of its closing one, so a parser can jump over a whole value
+// it has no use for instead of reading it
+
+# include "types.h"
+# include <stddef.h>
+
+typedef enum
+{
+	json_index_impl_SCALAR,
+	json_index_impl_SSE2,
+	json_index_impl_AVX2,
+}	json_index_impl;
+
+typedef struct
+{
+	u32		*pos; // in the buffer, in increasing order
+	u32		*match; // for `{` and `[`: entry of the closing bracket
+	u32		count;
+	u32		cap;
+}	json_index;
+
+// returns 0 if the strings or the brackets aren't balanced, or if the nesting is
+// deeper than JSON_MAX_DEPTH. the arrays are kept and reused by the next build
+int				json_index_build(json_index *index, const char *buf, size_t len);
+void			json_index_deinit(json_index *index);
+
+// the best one the cpu has is used by default. returns the one actually used
+// from then on, which may be lower than `impl`
+json_index_impl	json_index_select(json_index_impl impl);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef MATCHMAKING_H
+# define MATCHMAKING_H
+
+// the player's place in the server's matchmaking queue, kept from the
+// `matchmaking:waiting` events it pushes. the queue only gives positions, the
+// wait is estimated from how fast the position went down so far
+
+# include "types.h"
+
+typedef enum
+{
+	matchmaking_status_IDLE,
+	matchmaking_status_JOINING, // until the server gives a position
+	matchmaking_status_QUEUED,
+	matchmaking_status_MATCHED, // until the server starts the game
+}	matchmaking_status;
+
+typedef struct
+{
+	matchmaking_status	status;
+	u64					joined_ns;
+	int					position; // 1 is the next one to be matched
+	int					total;
+	u64					last_advance_ns; // when the position last went down
+	double				advance_ns; // average time per position, 0 until seen
+	int					plays_left; // of the last match found
+}	matchmaking;
+
+void	matchmaking_join(matchmaking *mm, u64 now);
+void	matchmaking_leave(matchmaking *mm);
+// returns 0 if nothing changed
+int		matchmaking_on_waiting(matchmaking *mm, int position, int total, u64 now);
+void	matchmaking_on_found(matchmaking *mm);
+// the side comes with the start of the game, like for an accepted invite
+void	matchmaking_on_start(matchmaking *mm, int plays_left);
+// remaining wait, 0 if there isn't enough to estimate it
+u64		matchmaking_estimate_ns(const matchmaking *mm, u64 now);
+
+#endif
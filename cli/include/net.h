@@ -0,0 +1,39 @@
+#ifndef NET_H
+# define NET_H
+
+# include <curl/curl.h>
+
+// transfers running on the shared multi handle. completion is reported through
+// `on_done` by whoever is pumping the multi handle, so a blocking request never
+// swallows the completion of a background one
+typedef struct s_net_transfer net_transfer;
+
+typedef void (net_done_func)(net_transfer *transfer, CURLcode result);
+
+struct s_net_transfer
+{
+	CURL			*curl;
+	net_done_func	*on_done; // can be NULL
+	void			*param;
+	int				in_flight;
+	int				done;
+	CURLcode		result;
+};
+
+// hands the sockets and the timeout of `multi` to an event loop of its own,
+// which other loops poll through net_multi_fd(). only one multi handle is used
+int net_multi_init(CURLM *multi);
+// after curl_multi_cleanup()
+void net_multi_deinit();
+// readable when net_multi_dispatch() has something to do
+int net_multi_fd();
+
+int net_transfer_start(CURLM *multi, net_transfer *transfer);
+// removes the transfer from the multi handle without reporting it
+void net_transfer_abort(CURLM *multi, net_transfer *transfer);
+// progresses all transfers without blocking and reports the finished ones
+CURLMcode net_multi_dispatch(CURLM *multi);
+// blocks until `transfer` is done, other transfers keep progressing
+CURLcode net_transfer_wait(CURLM *multi, net_transfer *transfer);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef PAGED_LIST_H
+# define PAGED_LIST_H
+
+# include "api.h"
+
+// number of pages kept in memory, the least recently used one is evicted
+# define PAGED_LIST_WINDOW 3
+
+// called when a page asked for by paged_list_get() arrived
+typedef void (paged_list_loaded_func)(void *param);
+
+typedef struct
+{
+	i64		page; // -1 if the slot is free
+	u64		last_use;
+	void	*obj; // parsed page following `def`
+}	paged_list_slot;
+
+// list fetched page by page from an endpoint accepting `?page=N&limit=M` (1-based
+// pages), with a bounded window of pages in memory. the page following (or
+// preceding) the accessed one is fetched in the background when the accessed
+// element is close to the edge of its page
+typedef struct
+{
+	api_ctx			*api;
+	const char		*endpoint;
+	json_def		*def;
+	size_t			obj_size;
+	size_t			array_offset; // offset of the _ARRAY in a page object
+	size_t			elem_size;
+	i64				page_size;
+
+	paged_list_slot	slots[PAGED_LIST_WINDOW];
+	u64				use_tick;
+	i64				pinned_page; // page of the last returned element, never evicted
+	i64				known_count; // elements up to the end of the furthest fetched page
+	int				end_reached;
+
+	net_transfer	fetch;
+	i64				fetch_page;
+	int				fetch_is_demand; // asked for by paged_list_get(), not a prefetch
+	i64				wanted_page; // missed while a demand was in flight, -1 if none
+	paged_list_loaded_func	*on_loaded; // can be NULL, set by the owner
+	void			*on_loaded_param;
+	char			*fetch_buf; // handed to the parsed page, NULL until a body comes
+	size_t			fetch_buf_cursor;
+	size_t			fetch_buf_cap;
+	char			url_buf[1100];
+}	paged_list;
+
+void paged_list_init(paged_list *list, api_ctx *api, const char *endpoint, json_def *def,
+	size_t obj_size, size_t array_offset, size_t elem_size, i64 page_size);
+// drops every page and cancels the background fetch
+void paged_list_reset(paged_list *list);
+void paged_list_deinit(paged_list *list);
+
+// signatures match list_get_func/list_has_func so a paged_list can back a list_view.
+// paged_list_get() returns NULL past the end of the list, and when the page isn't
+// in memory yet: it is then fetched in the background and `on_loaded` is called
+void *paged_list_get(void *list, i64 index);
+int paged_list_may_have(void *list, i64 index);
+// whether a page asked for by paged_list_get() is still on its way
+int paged_list_is_loading(const paged_list *list);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef PONG_RENDER_H
+# define PONG_RENDER_H
+
+# include "json_defs.h"
+# include "frame_governor.h"
+
+typedef enum
+{
+	pong_glyph_PADDLE,
+	pong_glyph_PADDLE_TOP, // lower half of a cell
+	pong_glyph_PADDLE_BOTTOM, // upper half of a cell
+	pong_glyph_BALL,
+	pong_glyph__MAX,
+}	pong_glyph;
+
+extern const char *const	pong_glyphs[pong_glyph__MAX];
+
+// cells of the ball around its center, only recomputed when the size changes
+# define BALL_SPRITE_MAX_CELLS 512
+
+// scale of the arena to a viewport of `width` x `height` cells
+typedef struct
+{
+	u16		width;
+	u16		height;
+	float	height_ratio;
+	float	width_ratio;
+	float	paddle_height;
+	size_t	ball_cells;
+	i16		ball[BALL_SPRITE_MAX_CELLS][2];
+}	pong_layout;
+
+// cells are given from 1, 1 at the top left of the viewport, and may be out of it
+typedef void (pong_plot_func)(void *param, int x, int y, pong_glyph glyph);
+
+void	pong_layout_update(pong_layout *layout, u16 width, u16 height);
+// the paddles and the ball, not the score
+void	pong_rasterize(const pong_layout *layout, const game_state *state, frame_detail detail,
+	pong_plot_func *plot, void *param);
+
+// draws a full frame of the game, scaled to the current terminal size. the
+// reduced detail draws the ball as a single cell and no half-cell paddle ends
+void	render_pong_scene(const game_state *state, frame_detail detail);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef PONG_SIM_H
+# define PONG_SIM_H
+
+// the rules of the server's game (backend/src/game/SimplePong.ts), without any
+// I/O. the serves are drawn from a generator seeded at init instead of
+// Math.random(), so a game only depends on its seed and on the inputs given to
+// each step, and can be replayed
+
+# include "types.h"
+# include "json_defs.h"
+
+typedef enum
+{
+	pong_input_UP = 1 << 0,
+	pong_input_DOWN = 1 << 1,
+}	pong_input;
+
+typedef enum
+{
+	pong_side_NONE,
+	pong_side_LEFT,
+	pong_side_RIGHT,
+}	pong_side;
+
+// in arena units and seconds, like the server
+typedef struct
+{
+	double		ball_x;
+	double		ball_y;
+	double		ball_vx;
+	double		ball_vy;
+	double		left_paddle_y;
+	double		right_paddle_y;
+	int			left_score;
+	int			right_score;
+	int			left_hits;
+	int			right_hits;
+	pong_side	winner; // NONE while the game goes on
+	u64			rng;
+	u64			ticks;
+}	pong_sim;
+
+void	pong_sim_init(pong_sim *sim, u64 seed);
+// `dt` in seconds, capped to PONG_MAX_DT. `left` and `right` are masks of
+// pong_input. nothing happens once the game is over
+void	pong_sim_update(pong_sim *sim, double dt, u8 left, u8 right);
+// one tick of the server, 1 / PONG_TICK_HZ
+void	pong_sim_step(pong_sim *sim, u8 left, u8 right);
+// what the server sends to the players
+void	pong_sim_get_state(const pong_sim *sim, game_state *out);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef SHARE_H
+# define SHARE_H
+
+# include <curl/curl.h>
+# include <limits.h>
+# include <pthread.h>
+
+// DNS and TLS session state shared between the REST and the websocket handles. TLS sessions are also persisted in `cache_path` between launches so
+// that the first handshakes of a launch can be resumed
+typedef struct
+{
+	CURLSH			*share;
+	char			cache_path[PATH_MAX];
+	int				can_persist;
+	// the websocket runs on its own thread, see ws.h. only DNS and TLS sessions
+	// can be shared between threads this way
+	pthread_mutex_t	locks[CURL_LOCK_DATA_LAST];
+}	share_ctx;
+
+int share_ctx_init(share_ctx *ctx);
+// `easy` has to be attached to the share, sessions are imported/exported through it
+void share_ctx_load_sessions(share_ctx *ctx, CURL *easy);
+void share_ctx_save_sessions(share_ctx *ctx, CURL *easy);
+void share_ctx_deinit(share_ctx *ctx);
+
+#endif
@@ -24,5 +24,6 @@ __attribute__((noreturn)) void clean_and_fail(const char *fmt, ...);
 void *xmalloc(size_t n);
 char *xstrdup(const char *str);
 void *xcalloc(size_t nmemb, size_t size);
+void *xrealloc(void *ptr, size_t n);
 
 #endif
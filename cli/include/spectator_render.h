@@ -0,0 +1,57 @@
+#ifndef SPECTATOR_RENDER_H
+# define SPECTATOR_RENDER_H
+
+// several games watched at once, each scaled into a tile of the terminal. the
+// games are drawn into a grid of cells kept in memory and only the cells that
+// changed since the previous frame are sent, in a single frame: drawing costs
+// the tiles of the games that got a new state, and the screen is only cleared
+// when the terminal is resized.
+// only the renderer: no window uses it yet, as the server has no way to watch
+// other players' games. the bench drives it with generated states
+
+# include "pong_render.h"
+# include "config.h"
+
+// printable ascii, or one of the glyphs of spectator_render.c
+typedef u8	spectator_cell;
+
+typedef struct
+{
+	game_state	state;
+	int			has_state;
+	int			is_dirty; // its tile has to be drawn again
+}	spectator_game;
+
+typedef struct
+{
+	u16				c_x; // terminal size the cells were allocated for
+	u16				c_y;
+	int				needs_layout;
+	u16				columns;
+	u16				tile_w;
+	u16				tile_h;
+	pong_layout		arena; // the same for every tile
+	frame_detail	detail;
+	spectator_cell	*cells; // c_x * c_y, what is drawn
+	spectator_cell	*shown; // what the terminal shows
+	int				is_shown_known;
+	size_t			games_count;
+	spectator_game	games[SPECTATOR_MAX_GAMES];
+}	spectator_view;
+
+void	spectator_init(spectator_view *view);
+void	spectator_deinit(spectator_view *view);
+// index of the game's tile, -1 if SPECTATOR_MAX_GAMES games are already shown
+int		spectator_add_game(spectator_view *view);
+// the last game takes the tile of the removed one
+void	spectator_remove_game(spectator_view *view, size_t index);
+void	spectator_set_state(spectator_view *view, size_t index, const game_state *state);
+// from a game_state message, 0 if it isn't one
+int		spectator_update(spectator_view *view, size_t index, cJSON *json);
+// writes the cells that changed to c_out
+void	spectator_draw(spectator_view *view, frame_detail detail);
+// draws a frame through the governor, if it is time to and the previous frame
+// was entirely written. 0 if nothing was drawn
+int		spectator_frame(spectator_view *view, frame_governor *gov);
+
+#endif
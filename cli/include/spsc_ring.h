@@ -0,0 +1,40 @@
+#ifndef SPSC_RING_H
+# define SPSC_RING_H
+
+// bounded queue of fixed size elements between exactly one producer thread and
+// one consumer thread. push and pop never lock nor block, each side only writes
+// its own index and keeps a cached copy of the other one
+
+# include "types.h"
+# include <stdatomic.h>
+
+# define SPSC_RING_CACHE_LINE 64
+
+typedef struct
+{
+	// consumer side
+	_Alignas(SPSC_RING_CACHE_LINE) _Atomic size_t	head;
+	size_t											cached_tail;
+	// producer side
+	_Alignas(SPSC_RING_CACHE_LINE) _Atomic size_t	tail;
+	size_t											cached_head;
+	// read only once initialized
+	_Alignas(SPSC_RING_CACHE_LINE) size_t			mask;
+	size_t											elem_size;
+	char											*slots;
+}	spsc_ring;
+
+// `capacity` has to be a power of two
+int		spsc_ring_init(spsc_ring *ring, size_t capacity, size_t elem_size);
+void	spsc_ring_deinit(spsc_ring *ring);
+
+// producer only. returns 0 if the ring is full
+int		spsc_ring_push(spsc_ring *ring, const void *elem);
+// consumer only. returns 0 if the ring is empty
+int		spsc_ring_pop(spsc_ring *ring, void *elem);
+
+// exact on the calling side, possibly outdated on the other one
+int		spsc_ring_is_empty(spsc_ring *ring);
+int		spsc_ring_is_full(spsc_ring *ring);
+
+#endif
@@ -4,6 +4,8 @@
 #include "types.h"
 #include "aabb.h"
 #include "config.h"
+#include "text_arena.h"
+#include "chat_log.h"
 #include <X11/X.h>
 #include <stdio.h>
 
@@ -26,16 +28,18 @@ typedef enum
 	TEXT_AREA,
 	BOX,
 	BUTTON,
+	CHAT_PANE,
 	COMPONENT_TYPE_MAX
 }	component_type;
 
 typedef struct
 {
-	const char	*str;
+	const char	*str; // not owned, unless it is stored inline
 	size_t		str_len;
 	size_t		has_to_clear;
 	int			wrap_around;
-	int			str_is_allocated;
+	int			str_is_inline;
+	char		inline_str[LABEL_INLINE_SIZE];
 }	component_label;
 
 typedef struct
@@ -64,14 +68,28 @@ typedef struct
 	char	bottom_right;
 }	component_box;
 
+// the messages of a chat log, one per row, on the full width of the terminal so
+// that new ones can be added by scrolling the rows instead of redrawing them
+typedef struct
+{
+	const chat_log	*log;
+	u16				h;
+	u32				scroll; // messages between the newest one and the bottom row
+	u64				drawn_total; // what was drawn, for the next incremental draw
+	u32				drawn_scroll;
+	u16				drawn_rows;
+	int				is_drawn; // the rows past `drawn_rows` are blank
+}	component_chat_pane;
+
 typedef struct s_console_component console_component;
+typedef struct s_term_window term_window;
 
 typedef void (button_action_func)(console_component *button, int pressed, void *param);
 
 // basically just a label that you can select and press
 typedef struct s_component_button
 {
-	char				*str;
+	const char			*str;
 	size_t				str_len;
 	size_t				has_to_clear;
 	int					wrap_around;
@@ -80,33 +98,47 @@ typedef struct s_component_button
 	int					held;
 }	component_button;
 
+// the payload of a component. its flags and its box are kept by its window,
+// see term_window
 typedef struct s_console_component
 {
 	component_type	type;
 	u16				x;
 	u16				y;
-	u8				is_dirty;
-	u8				is_hidden;
+	term_window		*window; // NULL until it is added to one
+	u32				index; // in its window
 	union
 	{
 		component_label 	c_label;
 		component_text_area	c_text_area;
 		component_box		c_box;
 		component_button	c_button;
+		component_chat_pane	c_chat_pane;
 	}	u;
 }	console_component;
 
-#define PUTS(s) fputs(s, stdout)
-#define PUTC(c) fputc(c, stdout)
+// printable text only, the tracked cursor advances by one cell per character
+#define PUTS(s) cputs(s)
+#define PUTC(c) cputc(c)
+// escape sequences that neither move the cursor nor change the attributes
+#define PUTS_RAW(s) fputs(s, c_out)
 
+// no-op on a component that wasn't added yet, it is drawn once it is
 void	mark_dirty(console_component *c, int full_redraw);
+int		component_is_hidden(console_component *c);
 void	component_hide(console_component *c);
 void	component_show(console_component *c);
 void	component_toggle_visibility(console_component *c);
 
-void	label_init(console_component *c, u16 x, u16 y, const char *content, int str_is_allocated);
+void	label_init(console_component *c, u16 x, u16 y, const char *content);
 void	label_draw(console_component *c);
-void	label_update_text(console_component *c, const char *new_content, int str_is_allocated);
+// `new_content` is only referenced, it has to stay valid while it is shown
+void	label_update_text(console_component *c, const char *new_content);
+// `text` is copied, in the label if it is short, interned in the text arena of
+// its window otherwise. never allocates for a text that was already copied
+void	label_copy_text(console_component *c, const char *text);
+void	label_printf(console_component *c, const char *format, ...)
+	__attribute__((format(printf, 2, 3)));
 void	label_wrap_around(console_component *c, int n);
 
 void	text_area_init(console_component *c, u16 x, u16 y, size_t max_text_size, const char *hint, int text_hidden);
@@ -126,55 +158,234 @@ void	box_init(console_component *c,
 
 void	box_draw(console_component *c);
 
-void	button_init(console_component *c, u16 x, u16 y, char *text, button_action_func *func, void *param);
+void	button_init(console_component *c, u16 x, u16 y, const char *text, button_action_func *func, void *param);
 void	button_draw(console_component *c);
 
+void	chat_pane_init(console_component *c, u16 y, u16 h, const chat_log *log);
+// only draws the messages pushed since the previous draw when it can
+void	chat_pane_draw(console_component *c, int force_redraw);
+// moves the view `delta` messages back in the history (forward if negative),
+// returns 0 if it couldn't move
+int		chat_pane_scroll(console_component *c, int delta);
+
 typedef void (draw_view_func)(void *obj, void *param);
+// writes the one-line summary of `obj` shown in its row
+typedef void (list_row_text_func)(void *obj, char *buf, size_t buf_size);
+// returns the element at `index`, NULL if past the end of the list
+typedef void *(list_get_func)(void *source, i64 index);
+// whether an element might exist at `index`, used to show the arrows
+typedef int (list_has_func)(void *source, i64 index);
+
+# define LIST_VIEW_MAX_ROWS 32
+# define LIST_VIEW_ROW_MAX 64
+
+// a row label is recycled as the viewport moves, and is only redrawn when the
+// element it shows (or the cursor marker) changed
+typedef struct
+{
+	console_component	*label;
+	char				text[LIST_VIEW_ROW_MAX];
+}	list_view_row;
 
 typedef struct
 {
 	term_window_type	my_window;
-	console_component	*left_arrow_label;
-	console_component	*right_arrow_label;
+	console_component	*up_arrow_label;
+	console_component	*down_arrow_label;
 	console_component	*box;
 
-	draw_view_func		*draw_view_func;
-	i64					*list_size;
+	draw_view_func		*draw_view_func; // details of the element under the cursor
+	list_row_text_func	*row_text_func;
 	i64					list_cursor;
+	i64					viewport_top;
+	u16					rows_count;
+	u16					row_width;
+	list_view_row		rows[LIST_VIEW_MAX_ROWS];
+
+	list_get_func		*get;
+	list_has_func		*has;
+	void				*source;
+
+	// used by the array source set up by list_view_init()
+	i64					*list_size;
 	void				**list;
 	size_t				elem_size;
 }	list_view;
 
+// the components of a list view are only added with its window, see
+// list_view_add_components()
 void list_view_init(list_view *list_view,
-	u16 x, u16 y, u16 w, u16 h,
-	draw_view_func *draw_view_func, i64 *list_size, void **list, size_t elem_size);
+	draw_view_func *draw_view_func, list_row_text_func *row_text_func,
+	i64 *list_size, void **list, size_t elem_size);
+
+void list_view_init_source(list_view *list_view,
+	draw_view_func *draw_view_func, list_row_text_func *row_text_func,
+	list_get_func *get, list_has_func *has, void *source);
 
+// adds the box, the arrows and the rows to the current window
+void list_view_add_components(list_view *list_view, u16 x, u16 y, u16 w, u16 h);
+size_t list_view_component_count(u16 h);
+
+// moves the cursor by `increment` (clamped to the end of the list when moving by
+// more than one). an increment of 0 (re)displays the whole window
 int list_view_update(list_view *list_view, void *param, int increment);
+// refreshes the row showing `index` if it is visible, after it was modified in place
+void list_view_refresh_index(list_view *list_view, i64 index);
 
 aabb	component_bouding_box(console_component *c);
+// after the size of a component that was added changed
+void	component_update_box(console_component *c);
 
 extern u16 		c_y;
 extern u16 		c_x;
 extern float	c_pixel_ratio;
+// where the components are drawn, stdout once cinit() was called
+extern FILE		*c_out;
 
-#define MAX_COMPONENT_NUMBER 100
-typedef struct
+# define BITSET_WORDS(n) (((n) + 63) / 64)
+
+static inline int bitset_test(const u64 *set, size_t i)
+{
+	return ((set[i / 64] >> (i % 64)) & 1);
+}
+
+static inline void bitset_set(u64 *set, size_t i)
+{
+	set[i / 64] |= 1ull << (i % 64);
+}
+
+static inline void bitset_clear(u64 *set, size_t i)
+{
+	set[i / 64] &= ~(1ull << (i % 64));
+}
+
+// first bit set at `from` or after it, -1u if there is none below `count`
+static inline size_t bitset_next(const u64 *set, size_t count, size_t from)
+{
+	for (size_t word = from / 64; word < BITSET_WORDS(count); word++)
+	{
+		u64 bits = set[word];
+		if (word == from / 64)
+			bits &= ~0ull << (from % 64);
+		if (bits)
+		{
+			size_t i = word * 64 + __builtin_ctzll(bits);
+			return (i < count ? i : -1u);
+		}
+	}
+	return (-1u);
+}
+
+// the components of a window, as parallel arrays indexed the same way. the
+// refresh and the navigation only scan the flags and the boxes, the payloads
+// are only read to draw a component or to act on it
+struct s_term_window
 {
 	int					has_initiated;
-	console_component	components[MAX_COMPONENT_NUMBER];
+	console_component	*components; // payloads, as many as its layout needs
+	u8					*types;
+	aabb				*boxes;
+	u64					*dirty; // bitsets, one bit per component
+	u64					*hidden;
+	u64					*selectable;
+	text_arena			texts; // of the labels, released with the window
 	size_t				components_count;
+	size_t				components_cap;
 	size_t				selected_component;
-}	term_window;
+};
+
+void	term_window_alloc(term_window *win, size_t cap);
+void	term_window_free(term_window *win);
+
+typedef enum
+{
+	layout_LABEL = 1,
+	layout_BUTTON,
+	layout_BOX,
+	layout_PRETTY_TEXT_AREA, // in a box
+	layout_PRETTY_BUTTON, // in a box
+	layout_LIST_VIEW,
+	layout_CHAT_PANE, // from the row `y` on, the whole width
+}	component_layout_type;
+
+// one component (or a group of them) of a window. only the fields its type
+// uses are read
+typedef struct
+{
+	component_layout_type	type;
+	u16						x;
+	u16						y;
+	u16						w; // of boxes and list views, length of text areas
+	u16						h;
+	const char				*text; // of labels and buttons, hint of text areas
+	int						wrap_around; // labels, 0 to never wrap
+	int						text_hidden;
+	button_action_func		*func;
+	void					*param;
+	list_view				*list_view; // configured by list_view_init*()
+	const chat_log			*chat_log;
+	console_component		**ref; // set to the component once it is added
+}	component_layout;
+
+// a window is built from its layout the first time it is shown
+typedef struct
+{
+	const component_layout	*items;
+	size_t					count;
+}	window_layout;
+
+# define WINDOW_LAYOUT(items) {items, sizeof(items) / sizeof(*(items))}
 
 extern term_window		term_windows[term_window_type__MAX];
 extern term_window		*cur_term_window;
 extern term_window_type	cur_term_window_type;
 
+// what the terminal was found to support by term_probe() at cinit()
+typedef struct
+{
+	u8	probed;
+	u8	rep; // CSI Ps b, repeat the previous character
+	u8	ech; // CSI Ps X, erase characters
+	u8	sync_output; // DEC private mode 2026, synchronized output
+}	term_caps;
+
+extern term_caps	c_caps;
+
+# define TERM_REPLY_MAX_PARAMS 8
+
+// a CSI sequence sent by the terminal, e.g. '\e[?62;22c'
+typedef struct
+{
+	char	prefix; // '?', '>', '=' or 0
+	int		params[TERM_REPLY_MAX_PARAMS];
+	int		count;
+	char	intermediate;
+	char	final; // 0 if the bytes were not a CSI sequence
+}	term_reply;
+
+size_t	term_parse_reply(const char *buf, size_t len, term_reply *reply);
+// sends the queries and reads the replies for at most TERM_PROBE_TIMEOUT_MS.
+// only called by cinit(), a resize asks for the pixel size again without
+// waiting, see chandle_term_replies()
+void	term_probe();
+void	term_apply_pixel_size(u32 pixel_y, u32 pixel_x);
+// reads what the terminal sent on stdin (once poll() said so) and applies the
+// replies it knows about, like the pixel size asked after a resize
+void	chandle_term_replies();
+
+// fd becoming readable when the terminal was resized, to add to a poll set
+int		cresize_fd();
+// updates the size if a resize happened since the last call, returns 1 if so.
+// the caller is expected to redraw everything
+int		chandle_resize();
+
 void cinit();
 void cdeinit();
 void crefresh(int force_redraw);
 console_component *ccomponent_add(console_component component);
 void chandle_key_event(KeySym key, int on_press);
+// `layouts` has one entry per term_window_type and has to stay valid
+void cset_window_layouts(const window_layout *layouts);
 void cswitch_window(term_window_type window_type, int refresh);
 void creset_window_stack();
 int cprevious_window(int refresh);
@@ -201,10 +412,57 @@ static inline console_component *ccurrent_component()
 	return (&cur_term_window->components[cur_term_window->selected_component]);
 }
 
+typedef enum
+{
+	ATTR_BOLD = 1 << 0,
+	ATTR_HALFBRIGHT = 1 << 1,
+	ATTR_BLINK = 1 << 2,
+	ATTR_MAGENTA_BACKGROUND = 1 << 3,
+}	term_attr;
+
+# define ATTR_NONE 0
+# define ATTR_SELECTED (ATTR_MAGENTA_BACKGROUND | ATTR_BOLD)
+# define ATTR_HINT (ATTR_BLINK | ATTR_HALFBRIGHT)
+
+// what the terminal is known to show, so that only the needed escapes are sent
+typedef struct
+{
+	u16	x; // 1-based, as in the escape sequences
+	u16	y;
+	u8	attr;
+	u8	cursor_known;
+	u8	attr_known;
+}	term_out_state;
+
+extern term_out_state	c_out_state;
+
+static inline void cputc(char c)
+{
+	fputc(c, c_out);
+	c_out_state.x++;
+}
+
+void cputs(const char *s);
+// `n` times the same character, with REP when the terminal has it
+void cputcn(char c, size_t n);
+// blanks `n` cells from the cursor, with EL or ECH when possible. those don't
+// move the cursor while the fallback does, the tracked position follows
+void cerase(size_t n);
+// frames drawn between these are displayed at once by terminals with mode 2026
+void csync_begin();
+void csync_end();
+// sets the attributes of what is written next (a mask of term_attr)
+void cset_attr(u8 attr);
+void cclear_screen();
+// for when the terminal was written to without going through the functions above
+void cforget_state();
 void cursor_goto(u16 x, u16 y);
+// scrolls the rows `top` to `bottom` (included) up by `n` rows, on the whole
+// width. the rows at the bottom are left blank
+void cscroll_up(u16 top, u16 bottom, u16 n);
 
 console_component	*add_pretty_textarea(u16 x, u16 y, u16 len, const char *hint, int text_hidden);
-console_component	*add_pretty_button(u16 x, u16 y, char *text, button_action_func *func, void *param);
+console_component	*add_pretty_button(u16 x, u16 y, const char *text, button_action_func *func, void *param);
 
 // this algorithm is responsible for finding the closest component from the current
 // component and following a direction. more or less based on this answer:
@@ -0,0 +1,41 @@
+#ifndef TEXT_ARENA_H
+# define TEXT_ARENA_H
+
+// storage of the texts copied into the labels of a window. the texts are
+// interned: copying a text that is already there returns the previous copy, so
+// a label that keeps being given the same messages doesn't grow the arena.
+// nothing is freed before the whole arena is released with its window
+
+# include "types.h"
+# include <stddef.h>
+
+typedef struct s_text_chunk text_chunk;
+
+struct s_text_chunk
+{
+	text_chunk	*next;
+	size_t		used;
+	size_t		size;
+	char		data[];
+};
+
+typedef struct
+{
+	const char	*str;
+	u32			len;
+	u32			hash;
+}	text_arena_entry;
+
+typedef struct
+{
+	text_chunk			*chunks; // the one being filled first
+	text_arena_entry	*entries; // open addressing, NULL str if free
+	u32					entries_mask;
+	u32					entries_count;
+}	text_arena;
+
+// `str` doesn't have to be NUL terminated, the copy is
+const char	*text_arena_intern(text_arena *arena, const char *str, size_t len);
+void		text_arena_release(text_arena *arena);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef TRACE_H
+# define TRACE_H
+
+// optional span recorder (enabled with -t). events go into a fixed ring that
+// overwrites the oldest ones, and are written at exit in the chrome trace-event
+// format, which can be opened in perfetto or chrome://tracing
+
+# include "types.h"
+# include <stdatomic.h>
+
+# define TRACE_DETAIL_MAX 24
+
+typedef struct
+{
+	_Atomic u64	seq; // index + 1 once the slot is fully written
+	u64			ts_ns;
+	const char	*name; // string literal
+	u32			tid;
+	char		phase; // 'B', 'E' or 'i'
+	char		detail[TRACE_DETAIL_MAX];
+}	trace_event;
+
+// cleared by the dump before it reads the ring, other threads may still be
+// recording at exit
+extern _Atomic int	trace_enabled;
+
+// allocates the ring and registers the dump of the trace to `path` at exit.
+// returns 0 if the ring could not be allocated
+int		trace_init(const char *path);
+void	trace_record(const char *name, char phase, const char *detail);
+
+static inline const char *trace_scope_begin(const char *name, const char *detail)
+{
+	if (!atomic_load_explicit(&trace_enabled, memory_order_relaxed))
+		return (NULL);
+	trace_record(name, 'B', detail);
+	return (name);
+}
+
+static inline void trace_scope_end(const char **name)
+{
+	if (*name)
+		trace_record(*name, 'E', NULL);
+}
+
+# define TRACE_GLUE_I(x, y) x ## y
+# define TRACE_GLUE(x, y) TRACE_GLUE_I(x, y)
+
+// records a span from here to the end of the enclosing block, whatever the way out
+# define TRACE_SCOPE_DETAIL(name, detail)									\
+	__attribute__((cleanup(trace_scope_end), unused))						\
+	const char *TRACE_GLUE(_trace_scope_, __LINE__) = trace_scope_begin(name, detail)
+# define TRACE_SCOPE(name) TRACE_SCOPE_DETAIL(name, NULL)
+
+# define TRACE_INSTANT(name, detail) do {								\
+		if (atomic_load_explicit(&trace_enabled, memory_order_relaxed))	\
+			trace_record(name, 'i', detail);							\
+	} while (0)
+
+#endif
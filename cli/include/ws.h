@@ -4,13 +4,34 @@
 # include <curl/curl.h>
 # include "json_def.h"
 # include "config.h"
-
+# include "net.h"
+# include "spsc_ring.h"
+# include <pthread.h>
+
+// the websocket is owned by its own thread: it does the handshake, then
+// receives the messages and parses them into cJSON trees, and sends the queued
+// ones, so a slow terminal doesn't delay the socket and the other way around.
+// the main thread exchanges messages with it through two rings, and still maps
+// the trees to their json_def structs. the REST requests aren't on this thread,
+// see api.h
 typedef struct
 {
 	CURL			*curl;
-	curl_socket_t	sock;
-	char			recv_buf[JSON_BUFFER_SIZE];
-	char			send_buf[JSON_BUFFER_SIZE];
+	curl_socket_t	sock; // websocket thread only
+	_Atomic int		handshake_done;
+	CURLcode		handshake_result; // set before `handshake_done`
+	u64				handshake_end_ns;
+	int				handshake_fd; // eventfd readable once the handshake is done
+	char			recv_buf[JSON_BUFFER_SIZE]; // websocket thread only
+	char			send_buf[JSON_BUFFER_SIZE]; // main thread only
+
+	pthread_t		thread;
+	int				thread_running;
+	_Atomic int		stop;
+	spsc_ring		inbound; // parsed messages and errors, to the main thread
+	spsc_ring		outbound; // messages to send, to the websocket thread
+	int				inbound_fd; // eventfd readable while `inbound` isn't empty
+	int				wake_fd; // eventfd waking the websocket thread
 }	ws_ctx;
 
 typedef struct
@@ -19,12 +40,24 @@ typedef struct
 	cJSON	*json;
 }	ws_recv_data;
 
-int ws_ctx_init(ws_ctx *ctx, const char *url);
+// starts the websocket thread, the handshake runs on it while the rest of the
+// program initializes. messages can be queued with ws_send() right away
+int ws_ctx_init(ws_ctx *ctx, const char *url, CURLSH *share);
+// waits for the end of the handshake
+CURLcode ws_ctx_wait_connected(ws_ctx *ctx);
+int ws_ctx_start_thread(ws_ctx *ctx);
+// stops the websocket thread and drops what is still queued
+void ws_ctx_stop_thread(ws_ctx *ctx);
 
 void ws_ctx_deinit(ws_ctx *ctx);
 
+// next received message, waits for it if none is queued. `inbound_fd` can be
+// polled to know when one is
 ws_recv_data ws_recv(ws_ctx *ctx);
+// same without waiting, returns 0 if nothing is queued
+int ws_try_recv(ws_ctx *ctx, ws_recv_data *data);
 
+// queues the content of `send_buf`, doesn't wait for it to be sent
 void ws_send(ws_ctx *ctx);
 
 #endif
@@ -1,6 +1,7 @@
 #include "api.h"
 #include "soft_fail.h"
 #include "ctx.h"
+#include "trace.h"
 #include <string.h>
 #include <assert.h>
 
@@ -28,10 +29,11 @@ typedef struct
 
 static void print_api_request_result(const char *endpoint, api_ctx *ctx, api_request_result res, FILE *stream);
 
-// does the CURL request and returns a JSON object if succeeded
+// does the CURL request, the body is left in ctx->out_buf
 static api_request_result api_request_common(api_ctx *ctx, const char *endpoint, request_type request_type)
 {
 	assert(request_type == POST || request_type == GET);
+	TRACE_SCOPE_DETAIL("api_request_common", endpoint);
 	curl_easy_setopt(ctx->curl, CURLOPT_POST, (long int)(request_type == POST));
 	// ctx->api_url_buf was defined by api_ctx_init as the base url. strcpying `endpoint`
 	// to its end will always concatenate both strings, overriding the precedent endpoint
@@ -41,26 +43,42 @@ static api_request_result api_request_common(api_ctx *ctx, const char *endpoint,
 	ctx->in_buf_cursor = 0;
 
 	api_request_result result = {0};
-	CURLcode curl_err = curl_easy_perform(ctx->curl);
+	CURLcode curl_err = api_ctx_perform(ctx);
 	if (curl_err)
 	{
 		result.err = ERR_CURL;
 		result.curl_code = curl_err;
-		return (result);
 	}
+	return (result);
+}
+
+static void parse_response(api_ctx *ctx, api_request_result *result)
+{
 	cJSON *json = cJSON_Parse(ctx->out_buf);
 	if (!json)
 	{
-		result.err = ERR_JSON_PARSE;
+		result->err = ERR_JSON_PARSE;
 		const char *error_ptr = cJSON_GetErrorPtr();
 		if (!error_ptr) // allocation error
-			result.json_error_pos = -1u;
+			result->json_error_pos = -1u;
 		else
-			result.json_error_pos = error_ptr - ctx->out_buf;
-		return (result);
+			result->json_error_pos = error_ptr - ctx->out_buf;
+		return ;
+	}
+	result->json_obj = json;
+}
+
+// no cJSON tree: `out` points into its own copy of the body
+static void parse_response_to_def(const char *buf, size_t len, api_request_result *result, json_def *def, void *out)
+{
+	char *body = xmalloc(len + 1);
+	memcpy(body, buf, len + 1);
+	json_content_error err = json_parse_buffer_from_def(body, len, def, out);
+	if (err.kind)
+	{
+		result->err = ERR_JSON_CONTENT;
+		result->json_content_error = err;
 	}
-	result.json_obj = json;
-	return (result);
 }
 
 void do_api_request_to_def(
@@ -71,15 +89,10 @@ void do_api_request_to_def(
 	void *out)
 {
 	api_request_result res = api_request_common(ctx, endpoint, request_type);
+	if (!res.err)
+		parse_response_to_def(ctx->out_buf, ctx->out_buf_cursor, &res, def, out);
 	if (res.err)
 		DO_CLEANUP(print_api_request_result(endpoint, &g_ctx.api_ctx, res, stderr));
-	json_content_error err = json_parse_from_def(res.json_obj, def, out);
-	if (err.kind)
-	{
-		res.err = ERR_JSON_CONTENT;
-		res.json_content_error = err;
-		DO_CLEANUP(print_api_request_result(endpoint, &g_ctx.api_ctx, res, stderr); cJSON_Delete(res.json_obj));
-	}
 }
 
 cJSON *do_api_request(
@@ -88,11 +101,169 @@ cJSON *do_api_request(
 	request_type request_type)
 {
 	api_request_result res = api_request_common(ctx, endpoint, request_type);
+	if (!res.err)
+		parse_response(ctx, &res);
 	if (res.err)
 		DO_CLEANUP(print_api_request_result(endpoint, &g_ctx.api_ctx, res, stderr));
 	return (res.json_obj);
 }
 
+static size_t api_cache_writer(char *data, size_t size, size_t nmemb, void *clientp)
+{
+	size_t realsize = size * nmemb;
+	api_cache_entry *entry = clientp;
+
+	if (entry->fetch_buf_cursor + realsize + 1 > JSON_BUFFER_SIZE)
+		return (CURL_WRITEFUNC_ERROR);
+	memcpy(&entry->fetch_buf[entry->fetch_buf_cursor], data, realsize);
+	entry->fetch_buf_cursor += realsize;
+	entry->fetch_buf[entry->fetch_buf_cursor] = 0;
+	return (realsize);
+}
+
+static void copy_response_header(CURL *curl, const char *name, char *dst, size_t dst_size)
+{
+	struct curl_header *header;
+	dst[0] = 0;
+	if (curl_easy_header(curl, name, 0, CURLH_HEADER, -1, &header) == CURLHE_OK
+		&& strlen(header->value) < dst_size)
+		strcpy(dst, header->value);
+}
+
+static struct curl_slist *header_append(struct curl_slist *list, const char *header)
+{
+	struct curl_slist *new_list = curl_slist_append(list, header);
+	if (!new_list)
+	{
+		curl_slist_free_all(list);
+		clean_and_fail("curl_slist_append() fail\n");
+	}
+	return (new_list);
+}
+
+// a copy of the persistent headers followed by the conditional ones, so that the
+// blocking requests made meanwhile keep their own list
+static struct curl_slist *revalidation_headers(api_ctx *ctx, api_cache_entry *entry)
+{
+	char buf[sizeof(entry->etag) + sizeof(entry->last_modified) + 20];
+	struct curl_slist *list = NULL;
+	for (struct curl_slist *node = ctx->header_list; node; node = node->next)
+		list = header_append(list, node->data);
+	if (!entry->has_value)
+		return (list);
+	if (entry->etag[0])
+	{
+		snprintf(buf, sizeof(buf), "If-None-Match: %s", entry->etag);
+		list = header_append(list, buf);
+	}
+	if (entry->last_modified[0])
+	{
+		snprintf(buf, sizeof(buf), "If-Modified-Since: %s", entry->last_modified);
+		list = header_append(list, buf);
+	}
+	return (list);
+}
+
+void api_cache_invalidate(api_cache_entry *entry)
+{
+	entry->has_value = 0;
+	entry->etag[0] = 0;
+	entry->last_modified[0] = 0;
+}
+
+static void release_fetch(api_cache_entry *entry)
+{
+	curl_easy_cleanup(entry->fetch.curl);
+	entry->fetch.curl = NULL;
+	curl_slist_free_all(entry->fetch_headers);
+	entry->fetch_headers = NULL;
+}
+
+void api_cache_cancel(api_cache_entry *entry)
+{
+	if (!entry->fetch.in_flight)
+		return ;
+	net_transfer_abort(entry->api->multi, &entry->fetch);
+	release_fetch(entry);
+}
+
+static void on_revalidation_done(net_transfer *transfer, CURLcode result)
+{
+	api_cache_entry *entry = transfer->param;
+	api_request_result res = {0};
+	long http_code = 0;
+	if (result)
+	{
+		res.err = ERR_CURL;
+		res.curl_code = result;
+		release_fetch(entry);
+		DO_CLEANUP(print_api_request_result(entry->endpoint, entry->api, res, stderr));
+	}
+	curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &http_code);
+	if (http_code == 304 && entry->has_value)
+	{
+		release_fetch(entry);
+		entry->on_done(entry, api_cache_result_NOT_MODIFIED, entry->param);
+		return ;
+	}
+	json_clean_obj(entry->out, entry->def);
+	parse_response_to_def(entry->fetch_buf, entry->fetch_buf_cursor, &res, entry->def, entry->out);
+	copy_response_header(transfer->curl, "ETag", entry->etag, sizeof(entry->etag));
+	copy_response_header(transfer->curl, "Last-Modified", entry->last_modified, sizeof(entry->last_modified));
+	release_fetch(entry);
+	if (res.err)
+		DO_CLEANUP(print_api_request_result(entry->endpoint, entry->api, res, stderr));
+	entry->token_hash = entry->fetch_token_hash;
+	entry->has_value = 1;
+	entry->on_done(entry, api_cache_result_UPDATED, entry->param);
+}
+
+int api_cache_revalidate(
+	api_ctx *ctx,
+	api_cache_entry *entry,
+	const char *endpoint,
+	json_def *def,
+	void *out,
+	api_cache_done_func *on_done,
+	void *param)
+{
+	assert(!entry->endpoint || !strcmp(entry->endpoint, endpoint));
+	if (entry->fetch.in_flight)
+		return (1);
+	entry->endpoint = endpoint;
+	if (!api_cache_is_fresh_for(ctx, entry))
+		api_cache_invalidate(entry); // never revalidate data fetched by another user
+
+	CURL *easy = curl_easy_duphandle(ctx->curl); // same share and options
+	if (!easy)
+		return (0);
+	snprintf(entry->url_buf, sizeof(entry->url_buf), "%.*s%s",
+		(int)ctx->api_url_base_len, ctx->api_url_buf, endpoint);
+	entry->fetch_headers = revalidation_headers(ctx, entry);
+	curl_easy_setopt(easy, CURLOPT_URL, entry->url_buf);
+	curl_easy_setopt(easy, CURLOPT_HTTPGET, 1L);
+	curl_easy_setopt(easy, CURLOPT_HTTPHEADER, entry->fetch_headers);
+	curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, api_cache_writer);
+	curl_easy_setopt(easy, CURLOPT_WRITEDATA, (void *)entry);
+	entry->api = ctx;
+	entry->def = def;
+	entry->out = out;
+	entry->on_done = on_done;
+	entry->param = param;
+	entry->fetch_token_hash = ctx->token_hash;
+	entry->fetch_buf_cursor = 0;
+	entry->fetch_buf[0] = 0;
+	entry->fetch.curl = easy;
+	entry->fetch.on_done = on_revalidation_done;
+	entry->fetch.param = entry;
+	if (!net_transfer_start(ctx->multi, &entry->fetch))
+	{
+		release_fetch(entry);
+		return (0);
+	}
+	return (1);
+}
+
 static void print_api_request_result(const char *endpoint, api_ctx *ctx, api_request_result res, FILE *stream)
 {
 	fprintf(stream, "%s: ", endpoint);
@@ -16,7 +16,7 @@ static size_t api_ctx_writer(char *data, size_t size, size_t nmemb, void *client
 	return realsize;
 }
 
-int	api_ctx_init(api_ctx *ctx, const char *api_base_url)
+int	api_ctx_init(api_ctx *ctx, const char *api_base_url, CURLM *multi, CURLSH *share)
 {
 	memset(ctx, 0, sizeof *ctx);
 
@@ -48,6 +48,7 @@ int	api_ctx_init(api_ctx *ctx, const char *api_base_url)
 	curl_easy_setopt(easy, CURLOPT_POSTFIELDS, ctx->in_buf);
     curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, 0L);
     curl_easy_setopt(easy, CURLOPT_SSL_VERIFYHOST, 0L);
+	curl_easy_setopt(easy, CURLOPT_SHARE, share);
 
 	struct curl_slist *list = NULL;
 	if (!(
@@ -62,19 +63,44 @@ int	api_ctx_init(api_ctx *ctx, const char *api_base_url)
 	curl_easy_setopt(easy, CURLOPT_HTTPHEADER, list);
 	ctx->header_list = list;
 	ctx->curl = easy;
+	ctx->multi = multi;
+	ctx->transfer.curl = easy;
+	return (1);
+}
 
+int api_ctx_probe_start(api_ctx *ctx)
+{
 	curl_easy_setopt(ctx->curl, CURLOPT_POST, 1L);
 	curl_easy_setopt(ctx->curl, CURLOPT_URL, ctx->api_base_url);
-	CURLcode curl_err = curl_easy_perform(ctx->curl);
-	if (curl_err)
+	ctx->out_buf_cursor = 0;
+	ctx->in_buf[0] = 0;
+	if (!net_transfer_start(ctx->multi, &ctx->transfer))
 	{
-		fprintf(stderr, "curl error connecting to `%s`: %s\n", api_base_url, curl_easy_strerror(curl_err));
+		fprintf(stderr, "curl_multi_add_handle() fail\n");
 		return (0);
 	}
-	
 	return (1);
 }
 
+CURLcode api_ctx_perform(api_ctx *ctx)
+{
+	if (!net_transfer_start(ctx->multi, &ctx->transfer))
+		return (CURLE_FAILED_INIT);
+	return (net_transfer_wait(ctx->multi, &ctx->transfer));
+}
+
+static u64 hash_token(const char *token)
+{
+	// FNV-1a
+	u64 hash = 0xcbf29ce484222325ull;
+	while (*token)
+	{
+		hash ^= (unsigned char)*token++;
+		hash *= 0x100000001b3ull;
+	}
+	return (hash ? hash : 1);
+}
+
 int api_ctx_set_token(api_ctx *ctx, const char *token)
 {
 	const char prepend[] = "Authorization: Bearer ";
@@ -91,12 +117,14 @@ int api_ctx_set_token(api_ctx *ctx, const char *token)
 	if (!new_list)
 		return (0);
 	curl_easy_setopt(ctx->curl, CURLOPT_HTTPHEADER, new_list);
+	ctx->token_hash = hash_token(token);
 	return (1);
 }
 
 void api_ctx_remove_token(api_ctx *ctx)
 {
 	const char header[] = "Authorization:";
+	ctx->token_hash = 0;
 	struct curl_slist *list = ctx->header_list;
 	struct curl_slist *previous = NULL;
 	while (list)
@@ -126,6 +154,8 @@ void api_ctx_deinit(api_ctx *ctx)
 {
 	if (ctx->curl)
 	{
+		if (ctx->multi)
+			net_transfer_abort(ctx->multi, &ctx->transfer);
 		curl_easy_cleanup(ctx->curl);
 		ctx->curl = NULL;
 	}
@@ -59,27 +59,29 @@ static void get_box_edge(direction dir, aabb box, float *x, float *y)
 	*x *= c_pixel_ratio;
 }
 
+// only the selectable bits and the packed boxes are read, never the payloads
+static size_t next_selectable(term_window *win, size_t from)
+{
+	return (bitset_next(win->selectable, win->components_count, from));
+}
+
 // gets the max distance (squared) between two boxes among the entire set of boxes,
 // taking into account the box's normal according to the direction
 static float max_distance_squared(direction dir)
 {
 	direction opposite_dir = opposite_dir_map[dir];
+	term_window *win = cur_term_window;
 
 	float max_dist = 0;
-	console_component *cur1, *cur2;
 	float cur1_x, cur1_y, cur2_x, cur2_y;
-	for (size_t i = 0; i < cur_term_window->components_count; i++)
+	for (size_t i = next_selectable(win, 0); i != -1u; i = next_selectable(win, i + 1))
 	{
-		cur1 = &cur_term_window->components[i];
-		if (!is_selectable(cur1))
-			continue;
-		get_box_edge(dir, component_bouding_box(cur1), &cur1_x, &cur1_y);
-		for (size_t j = 0; j < cur_term_window->components_count; j++)
+		get_box_edge(dir, win->boxes[i], &cur1_x, &cur1_y);
+		for (size_t j = next_selectable(win, 0); j != -1u; j = next_selectable(win, j + 1))
 		{
-			cur2 = &cur_term_window->components[j];
-			if (j != i && is_selectable(cur2))
+			if (j != i)
 			{
-				get_box_edge(opposite_dir, component_bouding_box(cur2), &cur2_x, &cur2_y);
+				get_box_edge(opposite_dir, win->boxes[j], &cur2_x, &cur2_y);
 				float cur_dist = calc_distance(cur1_x, cur1_y, cur2_x, cur2_y);
 				if (cur_dist > max_dist)
 					max_dist = cur_dist;
@@ -91,23 +93,22 @@ static float max_distance_squared(direction dir)
 
 size_t find_best_component(direction dir)
 {
-	console_component *cur = ccurrent_component();
-	if (!cur)
+	term_window *win = cur_term_window;
+	if (win->selected_component == -1u)
 		return (-1u);
 	float cur_edge_x, cur_edge_y, target_edge_x, target_edge_y;
 	float max_dist_squared = max_distance_squared(dir);
 	direction opp_dir = opposite_dir_map[dir];
 
-	get_box_edge(dir, component_bouding_box(cur), &cur_edge_x, &cur_edge_y);
+	get_box_edge(dir, win->boxes[win->selected_component], &cur_edge_x, &cur_edge_y);
 
 	size_t closest_component_idx = -1u;
 	float closest_component_weight = FLT_MAX;
-	for (size_t i = 0; i < cur_term_window->components_count; i++)
+	for (size_t i = next_selectable(win, 0); i != -1u; i = next_selectable(win, i + 1))
 	{
-		console_component *target = &cur_term_window->components[i];
-		if (i == cur_term_window->selected_component || !is_selectable(target))
+		if (i == win->selected_component)
 			continue;
-		get_box_edge(opp_dir, component_bouding_box(target), &target_edge_x, &target_edge_y);
+		get_box_edge(opp_dir, win->boxes[i], &target_edge_x, &target_edge_y);
 		float weight = calculate_weight(
 			dir,
 			cur_edge_x, cur_edge_y,
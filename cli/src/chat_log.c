@@ -0,0 +1,60 @@
+#include "chat_log.h"
+#include "soft_fail.h"
+#include <string.h>
+
+void chat_log_init(chat_log *log)
+{
+	log->slots = xcalloc(CHAT_LOG_CAPACITY, sizeof(*log->slots));
+	log->total = 0;
+}
+
+void chat_log_deinit(chat_log *log)
+{
+	free(log->slots);
+	*log = (chat_log){0};
+}
+
+// a multibyte character that doesn't fit entirely is dropped
+static u16 copy_text(char *dst, size_t size, const char *src)
+{
+	size_t len = 0;
+	while (src[len] && len < size - 1)
+	{
+		u8 chr = src[len];
+		dst[len++] = chr < ' ' || chr == 0x7F ? ' ' : chr;
+	}
+	if (src[len])
+	{
+		size_t start = len;
+		while (start && ((u8)dst[start - 1] & 0xC0) == 0x80)
+			start--;
+		u8 lead = start ? dst[start - 1] : 0;
+		size_t needed = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 0;
+		if (needed && len - (start - 1) < needed)
+			len = start - 1;
+	}
+	dst[len] = '\0';
+	return (len);
+}
+
+void chat_log_push(chat_log *log, chat_kind kind, int user_id, const char *from, const char *text)
+{
+	chat_entry *entry = &log->slots[log->total & (CHAT_LOG_CAPACITY - 1)];
+	entry->kind = kind;
+	entry->user_id = user_id;
+	entry->from_len = copy_text(entry->from, sizeof(entry->from), from);
+	entry->text_len = copy_text(entry->text, sizeof(entry->text), text);
+	log->total++;
+}
+
+size_t chat_log_count(const chat_log *log)
+{
+	return (log->total < CHAT_LOG_CAPACITY ? log->total : CHAT_LOG_CAPACITY);
+}
+
+const chat_entry *chat_log_get(const chat_log *log, u64 age)
+{
+	if (age >= chat_log_count(log))
+		return (NULL);
+	return (&log->slots[(log->total - 1 - age) & (CHAT_LOG_CAPACITY - 1)]);
+}
@@ -1,43 +1,155 @@
 #include "ctx.h"
+#include "soft_fail.h"
+#include "clock.h"
+#include <stddef.h>
+
+static const char *startup_phase_names[startup_phase__MAX] = {
+	[startup_phase_CURL_INIT] = "curl init",
+	[startup_phase_X11_OPEN] = "X11 open display",
+	[startup_phase_KEYBOARD_GRAB] = "X11 keyboard grab",
+	[startup_phase_TERM_INIT] = "terminal init",
+	[startup_phase_WINDOWS_INIT] = "windows init",
+	[startup_phase_API_PROBE] = "REST probe",
+	[startup_phase_WS_HANDSHAKE] = "websocket handshake",
+	[startup_phase_TOTAL] = "total",
+};
+
+void ctx_phase_begin(ctx *ctx, startup_phase phase)
+{
+	ctx->startup[phase].begin_ns = clock_ns();
+}
+
+void ctx_phase_end(ctx *ctx, startup_phase phase)
+{
+	ctx->startup[phase].end_ns = clock_ns();
+}
+
+void ctx_print_startup_report(ctx *ctx, FILE *stream)
+{
+	u64 origin = ctx->startup[startup_phase_TOTAL].begin_ns;
+	fprintf(stream, "startup phases (ms, relative to start):\n");
+	for (int i = 0; i < startup_phase__MAX; i++)
+	{
+		startup_timing t = ctx->startup[i];
+		if (!t.begin_ns || !t.end_ns)
+			continue;
+		fprintf(stream, "  %-20s %8.2f -> %8.2f  (%.2f)\n",
+			startup_phase_names[i],
+			NS_TO_MS(t.begin_ns - origin),
+			NS_TO_MS(t.end_ns - origin),
+			NS_TO_MS(t.end_ns - t.begin_ns));
+	}
+}
+
+// lets curl progress on DNS/TCP/TLS between two blocking startup steps
+static void ctx_pump_connections(ctx *ctx)
+{
+	net_multi_dispatch(ctx->curl_multi);
+}
+
+static void on_api_probe_done(net_transfer *transfer, CURLcode result)
+{
+	(void)result;
+	ctx_phase_end(transfer->param, startup_phase_API_PROBE);
+}
 
 int ctx_init(ctx *ctx, const char *api_endpoint_base, const char *ws_endpoint)
 {
-	ctx->dpy = XOpenDisplay(NULL);
-	if (!ctx->dpy)
+	ctx_phase_begin(ctx, startup_phase_TOTAL);
+	ctx_phase_begin(ctx, startup_phase_CURL_INIT);
+	CURLcode curl_err = curl_global_init(CURL_GLOBAL_ALL);
+	if (curl_err)
 	{
-		fprintf(stderr, "Unable to open a display\n");
+		fprintf(stderr, "curl_global_init() fail: %s\n", curl_easy_strerror(curl_err));
 		return (0);
 	}
-
-	ctx->root_win = XDefaultRootWindow(ctx->dpy);
-	if (!input_init(ctx))
+	ctx->curl_multi = curl_multi_init();
+	if (!ctx->curl_multi)
 	{
-		XCloseDisplay(ctx->dpy);
-		ctx->dpy = NULL;
-		fprintf(stderr, "Unable to grab keyboard");
+		fprintf(stderr, "curl_multi_init() fail\n");
+		ctx_deinit(ctx);
 		return (0);
 	}
+	if (!net_multi_init(ctx->curl_multi))
+	{
+		ctx_deinit(ctx);
+		return (0);
+	}
+	if (!share_ctx_init(&ctx->share_ctx))
+	{
+		ctx_deinit(ctx);
+		return (0);
+	}
+	if (!api_ctx_init(&ctx->api_ctx, api_endpoint_base, ctx->curl_multi, ctx->share_ctx.share))
+	{
+		ctx_deinit(ctx);
+		return (0);
+	}
+	paged_list_init(&ctx->tournament_pages, &ctx->api_ctx, "api/local-tournaments/history",
+		tournaments_def, sizeof(tournaments), offsetof(tournaments, data.tournaments),
+		sizeof(tournament), TOURNAMENT_PAGE_SIZE);
+	chat_log_init(&ctx->chat_log);
+	// sessions saved by the previous launch, both handshakes below can resume them
+	share_ctx_load_sessions(&ctx->share_ctx, ctx->api_ctx.curl);
+	ctx_phase_end(ctx, startup_phase_CURL_INIT);
 
-	CURLcode curl_err = curl_global_init(CURL_GLOBAL_ALL);
-	if (curl_err)
+	ctx_phase_begin(ctx, startup_phase_API_PROBE);
+	ctx->api_ctx.transfer.on_done = on_api_probe_done;
+	ctx->api_ctx.transfer.param = ctx;
+	if (!api_ctx_probe_start(&ctx->api_ctx))
 	{
-		fprintf(stderr, "curl_global_init() fail: %s\n", curl_easy_strerror(curl_err));
 		ctx_deinit(ctx);
 		return (0);
 	}
-	if (!api_ctx_init(&ctx->api_ctx, api_endpoint_base))
+	ctx_phase_begin(ctx, startup_phase_WS_HANDSHAKE);
+	if (!ws_ctx_init(&ctx->ws_ctx, ws_endpoint, ctx->share_ctx.share))
 	{
 		ctx_deinit(ctx);
 		return (0);
 	}
-	if (!ws_ctx_init(&ctx->ws_ctx, ws_endpoint))
+	ctx_pump_connections(ctx);
+
+	ctx_phase_begin(ctx, startup_phase_X11_OPEN);
+	ctx->dpy = XOpenDisplay(NULL);
+	ctx_phase_end(ctx, startup_phase_X11_OPEN);
+	if (!ctx->dpy)
 	{
+		fprintf(stderr, "Unable to open a display\n");
 		ctx_deinit(ctx);
 		return (0);
 	}
+	ctx_pump_connections(ctx);
+
+	ctx_phase_begin(ctx, startup_phase_KEYBOARD_GRAB);
+	ctx->root_win = XDefaultRootWindow(ctx->dpy);
+	if (!input_init(ctx))
+	{
+		XCloseDisplay(ctx->dpy);
+		ctx->dpy = NULL;
+		fprintf(stderr, "Unable to grab keyboard");
+		ctx_deinit(ctx);
+		return (0);
+	}
+	ctx_phase_end(ctx, startup_phase_KEYBOARD_GRAB);
+	ctx_pump_connections(ctx);
 	return (1);
 }
 
+void ctx_wait_connected(ctx *ctx)
+{
+	// the websocket handshake goes on in its thread while the probe is waited for
+	CURLcode res = net_transfer_wait(ctx->curl_multi, &ctx->api_ctx.transfer);
+	ctx->api_ctx.transfer.on_done = NULL;
+	if (res)
+		clean_and_fail("curl error connecting to `%s`: %s\n",
+			ctx->api_ctx.api_base_url, curl_easy_strerror(res));
+	res = ws_ctx_wait_connected(&ctx->ws_ctx);
+	ctx->startup[startup_phase_WS_HANDSHAKE].end_ns = ctx->ws_ctx.handshake_end_ns;
+	if (res)
+		clean_and_fail("websocket handshake fail: %s\n", curl_easy_strerror(res));
+	ctx_phase_end(ctx, startup_phase_TOTAL);
+}
+
 void ctx_deinit(ctx *ctx)
 {
 	if (!ctx)
@@ -48,11 +160,23 @@ void ctx_deinit(ctx *ctx)
 		XCloseDisplay(ctx->dpy);
 		ctx->dpy = NULL;
 	}
-	curl_global_cleanup();
+	share_ctx_save_sessions(&ctx->share_ctx, ctx->api_ctx.curl);
+	paged_list_deinit(&ctx->tournament_pages);
+	api_cache_cancel(&ctx->friends_cache);
 	ws_ctx_deinit(&ctx->ws_ctx);
 	api_ctx_deinit(&ctx->api_ctx);
+	share_ctx_deinit(&ctx->share_ctx);
+	if (ctx->curl_multi)
+	{
+		curl_multi_cleanup(ctx->curl_multi);
+		ctx->curl_multi = NULL;
+		net_multi_deinit();
+	}
+	curl_global_cleanup();
 
 	json_clean_obj(&ctx->user_login, login_def);
-	json_clean_obj(&ctx->tournaments, tournaments_def);
+	json_clean_obj(&ctx->friends, friends_def);
+	friends_store_deinit(&ctx->friends_store);
 	json_clean_obj(&ctx->pong_invite, friend_pong_invite_def);
+	chat_log_deinit(&ctx->chat_log);
 }
@@ -0,0 +1,304 @@
+#include "event_loop.h"
+#include "soft_fail.h"
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+event_loop_backend	event_loop_default_backend = event_loop_backend_EPOLL;
+
+int event_loop_init(event_loop *loop)
+{
+	return (event_loop_init_backend(loop, event_loop_default_backend));
+}
+
+int event_loop_init_backend(event_loop *loop, event_loop_backend backend)
+{
+	memset(loop, 0, sizeof(*loop));
+	loop->epoll_fd = -1;
+	loop->uring.fd = -1;
+	if (backend == event_loop_backend_IO_URING && uring_init(loop))
+	{
+		loop->backend = event_loop_backend_IO_URING;
+		return (1);
+	}
+	loop->backend = event_loop_backend_EPOLL;
+	loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (loop->epoll_fd < 0)
+	{
+		fprintf(stderr, "epoll_create1() fail: %s\n", strerror(errno));
+		return (0);
+	}
+	return (1);
+}
+
+int event_loop_fd(event_loop *loop)
+{
+	return (loop->backend == event_loop_backend_IO_URING ? loop->uring.fd : loop->epoll_fd);
+}
+
+// sources still waiting for an io_uring operation are kept for later
+static void free_removed(event_loop *loop)
+{
+	event_source **link = &loop->removed;
+	while (*link)
+	{
+		event_source *source = *link;
+		if (source->pending)
+		{
+			link = &source->next;
+			continue;
+		}
+		*link = source->next;
+		free(source);
+	}
+}
+
+void event_loop_deinit(event_loop *loop)
+{
+	if (event_loop_fd(loop) <= 0)
+		return ;
+	while (loop->sources)
+		event_loop_remove(loop, loop->sources);
+	if (loop->backend == event_loop_backend_IO_URING)
+		uring_deinit(loop);
+	else
+		close(loop->epoll_fd);
+	free_removed(loop);
+	loop->epoll_fd = -1;
+}
+
+static event_source *add_source(event_loop *loop, event_source_type type, int fd, u32 events, event_func *func, void *param)
+{
+	event_source *source = xcalloc(1, sizeof(*source));
+	source->type = type;
+	source->fd = fd;
+	source->events = events;
+	source->func = func;
+	source->param = param;
+	struct epoll_event event = {.events = events, .data.ptr = source};
+	if (loop->backend == event_loop_backend_IO_URING)
+		uring_arm(loop, source);
+	else if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event))
+	{
+		fprintf(stderr, "epoll_ctl() fail: %s\n", strerror(errno));
+		free(source);
+		return (NULL);
+	}
+	source->next = loop->sources;
+	loop->sources = source;
+	return (source);
+}
+
+event_source *event_loop_add_fd(event_loop *loop, int fd, u32 events, event_func *func, void *param)
+{
+	return (add_source(loop, event_source_FD, fd, events, func, param));
+}
+
+int event_loop_modify_fd(event_loop *loop, event_source *source, u32 events)
+{
+	source->events = events;
+	if (loop->backend == event_loop_backend_IO_URING)
+	{
+		// re-armed with the new events once the removal completes
+		uring_cancel(loop, source);
+		return (1);
+	}
+	struct epoll_event event = {.events = events, .data.ptr = source};
+	return (!epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, source->fd, &event));
+}
+
+event_source *event_loop_add_timer(event_loop *loop, u64 delay_ns, u64 interval_ns, event_func *func, void *param)
+{
+	// io_uring waits in a blocking read, epoll must never block on one
+	int flags = loop->backend == event_loop_backend_EPOLL ? TFD_NONBLOCK : 0;
+	int fd = timerfd_create(CLOCK_MONOTONIC, flags | TFD_CLOEXEC);
+	if (fd < 0)
+	{
+		fprintf(stderr, "timerfd_create() fail: %s\n", strerror(errno));
+		return (NULL);
+	}
+	event_source *source = add_source(loop, event_source_TIMER, fd, EPOLLIN, func, param);
+	if (!source)
+	{
+		close(fd);
+		return (NULL);
+	}
+	event_loop_set_timer(source, delay_ns, interval_ns);
+	return (source);
+}
+
+void event_loop_set_timer(event_source *timer, u64 delay_ns, u64 interval_ns)
+{
+	struct itimerspec spec = {
+		.it_value = {.tv_sec = delay_ns / 1000000000ull, .tv_nsec = delay_ns % 1000000000ull},
+		.it_interval = {.tv_sec = interval_ns / 1000000000ull, .tv_nsec = interval_ns % 1000000000ull},
+	};
+	timerfd_settime(timer->fd, 0, &spec, NULL);
+}
+
+event_source *event_loop_add_signal(event_loop *loop, int signo, event_func *func, void *param)
+{
+	sigset_t mask;
+	sigset_t old_mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, signo);
+	sigprocmask(SIG_BLOCK, &mask, &old_mask);
+	// a nested loop (the game's) may watch the same signal as the outer one
+	int was_blocked = sigismember(&old_mask, signo);
+	int flags = loop->backend == event_loop_backend_EPOLL ? SFD_NONBLOCK : 0;
+	int fd = signalfd(-1, &mask, flags | SFD_CLOEXEC);
+	if (fd < 0)
+	{
+		fprintf(stderr, "signalfd() fail: %s\n", strerror(errno));
+		if (!was_blocked)
+			sigprocmask(SIG_UNBLOCK, &mask, NULL);
+		return (NULL);
+	}
+	event_source *source = add_source(loop, event_source_SIGNAL, fd, EPOLLIN, func, param);
+	if (!source)
+	{
+		close(fd);
+		if (!was_blocked)
+			sigprocmask(SIG_UNBLOCK, &mask, NULL);
+		return (NULL);
+	}
+	source->signo = signo;
+	source->was_blocked = was_blocked;
+	return (source);
+}
+
+void event_loop_remove(event_loop *loop, event_source *source)
+{
+	if (!source || source->removed)
+		return ;
+	event_source **link = &loop->sources;
+	while (*link && *link != source)
+		link = &(*link)->next;
+	if (*link)
+		*link = source->next;
+	// the fd may already be closed by its owner, the error doesn't matter then
+	if (loop->backend == event_loop_backend_IO_URING)
+		uring_cancel(loop, source);
+	else
+		epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
+	if (source->type != event_source_FD)
+		close(source->fd);
+	if (source->type == event_source_SIGNAL && !source->was_blocked)
+	{
+		sigset_t mask;
+		sigemptyset(&mask);
+		sigaddset(&mask, source->signo);
+		sigprocmask(SIG_UNBLOCK, &mask, NULL);
+	}
+	// events of the current iteration may still point to it
+	source->removed = 1;
+	source->next = loop->removed;
+	loop->removed = source;
+	if (!loop->dispatching)
+		free_removed(loop);
+}
+
+void event_loop_defer(event_loop *loop, event_func *func, void *param)
+{
+	if (loop->deferred_count == EVENT_LOOP_MAX_DEFERRED)
+	{
+		func(param, 0);
+		return ;
+	}
+	loop->deferred[loop->deferred_count++] = (event_deferred){.func = func, .param = param};
+}
+
+static void dispatch(event_loop *loop, event_source *source, u32 events)
+{
+	u32 arg = events;
+	if (source->type != event_source_FD)
+		loop->syscalls++;
+	if (source->type == event_source_TIMER)
+	{
+		u64 expirations;
+		if (read(source->fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+			return ;
+		arg = expirations;
+	}
+	else if (source->type == event_source_SIGNAL)
+	{
+		struct signalfd_siginfo info;
+		int received = 0;
+		while (read(source->fd, &info, sizeof(info)) == sizeof(info))
+		{
+			loop->syscalls++;
+			received = 1;
+		}
+		if (!received)
+			return ;
+		arg = source->signo;
+	}
+	source->func(source->param, arg);
+}
+
+static void run_deferred(event_loop *loop)
+{
+	// callbacks deferred from a deferred callback wait for the next iteration
+	event_deferred pending[EVENT_LOOP_MAX_DEFERRED];
+	size_t count = loop->deferred_count;
+	memcpy(pending, loop->deferred, count * sizeof(*pending));
+	loop->deferred_count = 0;
+	for (size_t i = 0; i < count; i++)
+		pending[i].func(pending[i].param, 0);
+}
+
+static int epoll_run_once(event_loop *loop, int timeout_ms)
+{
+	struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+	loop->syscalls++;
+	int count = epoll_wait(loop->epoll_fd, events, EVENT_LOOP_MAX_EVENTS, timeout_ms);
+	if (count < 0)
+	{
+		if (errno == EINTR)
+			return (0);
+		fprintf(stderr, "epoll_wait() fail: %s\n", strerror(errno));
+		return (-1);
+	}
+	for (int i = 0; i < count; i++)
+	{
+		event_source *source = events[i].data.ptr;
+		if (!source->removed)
+			dispatch(loop, source, events[i].events);
+	}
+	return (count);
+}
+
+int event_loop_run_once(event_loop *loop, int timeout_ms)
+{
+	// something deferred has to run without waiting for a source
+	if (loop->deferred_count)
+		timeout_ms = 0;
+	loop->dispatching++;
+	int count = loop->backend == event_loop_backend_IO_URING
+		? uring_run_once(loop, timeout_ms)
+		: epoll_run_once(loop, timeout_ms);
+	if (count >= 0)
+		run_deferred(loop);
+	if (!--loop->dispatching)
+		free_removed(loop);
+	return (count);
+}
+
+int event_loop_run(event_loop *loop)
+{
+	loop->running = 1;
+	while (loop->running)
+	{
+		if (event_loop_run_once(loop, -1) < 0)
+			return (0);
+	}
+	return (1);
+}
+
+void event_loop_stop(event_loop *loop)
+{
+	loop->running = 0;
+}
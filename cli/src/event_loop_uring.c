@@ -0,0 +1,291 @@
+#include "event_loop.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// user_data of the operations whose completion is ignored
+#define IGNORED_COMPLETION 0
+#define WAIT_TIMEOUT_COMPLETION 1
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *params)
+{
+	return (syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+	return (syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0));
+}
+
+// every operation the backend queues has to be known by the kernel
+static int uring_probe(int fd)
+{
+	static const u8 needed_ops[] = {
+		IORING_OP_POLL_ADD,
+		IORING_OP_POLL_REMOVE,
+		IORING_OP_READ,
+		IORING_OP_TIMEOUT,
+		IORING_OP_ASYNC_CANCEL,
+	};
+	struct
+	{
+		struct io_uring_probe		probe;
+		struct io_uring_probe_op	ops[256];
+	}	probe;
+	memset(&probe, 0, sizeof(probe));
+	if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, &probe, 256) < 0)
+		return (0);
+	for (size_t i = 0; i < sizeof(needed_ops); i++)
+	{
+		if (needed_ops[i] > probe.probe.last_op || !(probe.ops[needed_ops[i]].flags & IO_URING_OP_SUPPORTED))
+			return (0);
+	}
+	return (1);
+}
+
+int uring_init(event_loop *loop)
+{
+	event_uring *uring = &loop->uring;
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int fd = sys_io_uring_setup(EVENT_LOOP_URING_ENTRIES, &params);
+	if (fd < 0)
+		return (0);
+	// one mapping for both rings, and completions are never dropped
+	if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP) || !uring_probe(fd))
+	{
+		close(fd);
+		return (0);
+	}
+	size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	uring->ring_size = sq_size > cq_size ? sq_size : cq_size;
+	uring->ring = mmap(NULL, uring->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (uring->ring == MAP_FAILED)
+	{
+		close(fd);
+		return (0);
+	}
+	uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (uring->sqes == MAP_FAILED)
+	{
+		munmap(uring->ring, uring->ring_size);
+		close(fd);
+		return (0);
+	}
+	char *ring = uring->ring;
+	uring->sq_head = (unsigned *)(ring + params.sq_off.head);
+	uring->sq_tail = (unsigned *)(ring + params.sq_off.tail);
+	uring->sq_mask = (unsigned *)(ring + params.sq_off.ring_mask);
+	uring->sq_array = (unsigned *)(ring + params.sq_off.array);
+	uring->cq_head = (unsigned *)(ring + params.cq_off.head);
+	uring->cq_tail = (unsigned *)(ring + params.cq_off.tail);
+	uring->cq_mask = (unsigned *)(ring + params.cq_off.ring_mask);
+	uring->cqes = (struct io_uring_cqe *)(ring + params.cq_off.cqes);
+	uring->fd = fd;
+	uring->to_submit = 0;
+	return (1);
+}
+
+static int uring_submit(event_loop *loop, unsigned min_complete)
+{
+	event_uring *uring = &loop->uring;
+	loop->syscalls++;
+	int submitted = sys_io_uring_enter(uring->fd, uring->to_submit, min_complete,
+		min_complete ? IORING_ENTER_GETEVENTS : 0);
+	if (submitted > 0)
+		uring->to_submit -= (unsigned)submitted > uring->to_submit ? uring->to_submit : (unsigned)submitted;
+	return (submitted);
+}
+
+// queued until the next submission, a full queue is submitted right away
+static struct io_uring_sqe *uring_get_sqe(event_loop *loop)
+{
+	event_uring *uring = &loop->uring;
+	unsigned tail = *uring->sq_tail;
+	unsigned head = __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE);
+	if (tail - head > *uring->sq_mask)
+	{
+		uring_submit(loop, 0);
+		head = __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE);
+		if (tail - head > *uring->sq_mask)
+			return (NULL);
+	}
+	unsigned index = tail & *uring->sq_mask;
+	struct io_uring_sqe *sqe = &uring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	uring->sq_array[index] = index;
+	__atomic_store_n(uring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	uring->to_submit++;
+	return (sqe);
+}
+
+void uring_arm(event_loop *loop, event_source *source)
+{
+	struct io_uring_sqe *sqe = uring_get_sqe(loop);
+	if (!sqe)
+	{
+		fprintf(stderr, "io_uring: submission queue full, source dropped\n");
+		return ;
+	}
+	sqe->fd = source->fd;
+	sqe->user_data = (u64)(uintptr_t)source;
+	switch (source->type)
+	{
+		case event_source_FD:
+			// one-shot, re-armed after dispatch to stay level triggered
+			sqe->opcode = IORING_OP_POLL_ADD;
+			sqe->poll32_events = source->events;
+			break;
+		case event_source_TIMER:
+			sqe->opcode = IORING_OP_READ;
+			sqe->addr = (u64)(uintptr_t)&source->buf.expirations;
+			sqe->len = sizeof(source->buf.expirations);
+			break;
+		case event_source_SIGNAL:
+			sqe->opcode = IORING_OP_READ;
+			sqe->addr = (u64)(uintptr_t)&source->buf.siginfo;
+			sqe->len = sizeof(source->buf.siginfo);
+			break;
+	}
+	source->armed = 1;
+	source->pending++;
+}
+
+// the armed operation completes with -ECANCELED
+void uring_cancel(event_loop *loop, event_source *source)
+{
+	if (!source->armed)
+		return ;
+	struct io_uring_sqe *sqe = uring_get_sqe(loop);
+	if (!sqe)
+		return ;
+	sqe->opcode = source->type == event_source_FD ? IORING_OP_POLL_REMOVE : IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = (u64)(uintptr_t)source;
+	sqe->user_data = IGNORED_COMPLETION;
+}
+
+static int uring_complete(event_loop *loop, struct io_uring_cqe *cqe)
+{
+	if (cqe->user_data == IGNORED_COMPLETION || cqe->user_data == WAIT_TIMEOUT_COMPLETION)
+		return (0);
+	event_source *source = (event_source *)(uintptr_t)cqe->user_data;
+	source->pending--;
+	source->armed = 0;
+	if (source->removed)
+		return (0);
+	int rearm = 1;
+	u32 arg = 0;
+	if (cqe->res == -ECANCELED)
+	{
+		// the poll was removed to change its events
+		uring_arm(loop, source);
+		return (0);
+	}
+	if (source->type == event_source_FD)
+	{
+		// a poll that can't be queued again would complete in a loop
+		if (cqe->res < 0)
+		{
+			arg = EPOLLERR;
+			rearm = 0;
+		}
+		else
+			arg = cqe->res;
+	}
+	else if (cqe->res < 0)
+	{
+		// the fds are blocking, so that the read waits in the kernel
+		if (cqe->res == -EINTR || cqe->res == -EAGAIN)
+			uring_arm(loop, source);
+		else
+			fprintf(stderr, "io_uring: read fail: %s\n", strerror(-cqe->res));
+		return (0);
+	}
+	else if (source->type == event_source_TIMER)
+		arg = source->buf.expirations;
+	else
+		arg = source->signo;
+	source->func(source->param, arg);
+	if (rearm && !source->removed && !source->armed)
+		uring_arm(loop, source);
+	return (1);
+}
+
+int uring_run_once(event_loop *loop, int timeout_ms)
+{
+	event_uring *uring = &loop->uring;
+	unsigned min_complete = 0;
+	struct __kernel_timespec timeout;
+	if (timeout_ms)
+	{
+		min_complete = 1;
+		if (timeout_ms > 0)
+		{
+			// ends the wait after `timeout` or as soon as anything else completes
+			struct io_uring_sqe *sqe = uring_get_sqe(loop);
+			if (sqe)
+			{
+				timeout.tv_sec = timeout_ms / 1000;
+				timeout.tv_nsec = (timeout_ms % 1000) * 1000000ll;
+				sqe->opcode = IORING_OP_TIMEOUT;
+				sqe->fd = -1;
+				sqe->addr = (u64)(uintptr_t)&timeout;
+				sqe->len = 1;
+				sqe->off = 1;
+				sqe->user_data = WAIT_TIMEOUT_COMPLETION;
+			}
+		}
+	}
+	// no syscall at all when nothing is queued and there is no need to wait
+	if (uring->to_submit || min_complete)
+	{
+		if (__atomic_load_n(uring->cq_head, __ATOMIC_RELAXED) != __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE))
+			min_complete = 0;
+		if (uring_submit(loop, min_complete) < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+		{
+			fprintf(stderr, "io_uring_enter() fail: %s\n", strerror(errno));
+			return (-1);
+		}
+	}
+	int count = 0;
+	unsigned head = __atomic_load_n(uring->cq_head, __ATOMIC_RELAXED);
+	while (head != __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE))
+	{
+		struct io_uring_cqe cqe = uring->cqes[head & *uring->cq_mask];
+		// released before the dispatch, which can run the loop again
+		__atomic_store_n(uring->cq_head, ++head, __ATOMIC_RELEASE);
+		count += uring_complete(loop, &cqe);
+		head = __atomic_load_n(uring->cq_head, __ATOMIC_RELAXED);
+	}
+	return (count);
+}
+
+// the sources were all cancelled, their operations have to be done before
+// they can be freed
+void uring_deinit(event_loop *loop)
+{
+	event_uring *uring = &loop->uring;
+	for (int tries = 0; tries < 100; tries++)
+	{
+		int pending = 0;
+		for (event_source *source = loop->removed; source; source = source->next)
+			pending |= source->pending > 0;
+		if (!pending)
+			break;
+		uring_run_once(loop, 10);
+	}
+	munmap(uring->sqes, uring->sqes_size);
+	munmap(uring->ring, uring->ring_size);
+	close(uring->fd);
+	uring->fd = -1;
+	for (event_source *source = loop->removed; source; source = source->next)
+		source->pending = 0;
+}
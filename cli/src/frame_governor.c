@@ -0,0 +1,212 @@
+#include "frame_governor.h"
+#include "soft_fail.h"
+#include "clock.h"
+#include "config.h"
+#include "term.h"
+#include "trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MIN_FRAME_INTERVAL_NS (1000000000ull / GOVERNOR_MAX_FPS)
+#define MAX_FRAME_INTERVAL_NS (1000000000ull / GOVERNOR_MIN_FPS)
+// throughput samples are averaged over windows of busy time this long
+#define THROUGHPUT_WINDOW_NS 250000000ull
+
+void frame_governor_begin(frame_governor *gov)
+{
+	memset(gov, 0, sizeof(*gov));
+	gov->frame_stream = open_memstream(&gov->frame_stream_buf, &gov->frame_stream_len);
+	if (!gov->frame_stream)
+		clean_and_fail("open_memstream() fail\n");
+	fflush(stdout);
+	const char *tty = isatty(STDOUT_FILENO) ? ttyname(STDOUT_FILENO) : NULL;
+	gov->tty_fd = tty ? open(tty, O_WRONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC) : -1;
+	gov->detail = frame_detail_FULL;
+	gov->frame_interval_ns = MIN_FRAME_INTERVAL_NS;
+	gov->is_active = 1;
+}
+
+int frame_governor_should_render(frame_governor *gov)
+{
+	if (clock_ns() - gov->last_frame_ns >= gov->frame_interval_ns)
+		return (1);
+	gov->frames_skipped++;
+	return (0);
+}
+
+void frame_governor_frame_begin(frame_governor *gov)
+{
+	rewind(gov->frame_stream);
+	c_out = gov->frame_stream;
+	// the previous frame may have been dropped, so nothing is known
+	cforget_state();
+	csync_begin();
+}
+
+static void frame_buffer_set(frame_buffer *frame, const char *data, size_t len)
+{
+	if (len > frame->cap)
+	{
+		free(frame->buf);
+		frame->buf = xmalloc(len);
+		frame->cap = len;
+	}
+	memcpy(frame->buf, data, len);
+	frame->len = len;
+	frame->off = 0;
+}
+
+// the frame rate is what the measured throughput allows for an average full
+// frame, and the detail is reduced when even the lowest frame rate is too much
+static void frame_governor_adapt(frame_governor *gov)
+{
+	if (gov->throughput <= 0)
+		return ;
+	double needed_ns = gov->avg_frame_bytes * 1e9 / gov->throughput * GOVERNOR_HEADROOM;
+	if (gov->detail == frame_detail_FULL && needed_ns > MAX_FRAME_INTERVAL_NS)
+		gov->detail = frame_detail_REDUCED;
+	else if (gov->detail == frame_detail_REDUCED && needed_ns < MAX_FRAME_INTERVAL_NS / 2)
+		gov->detail = frame_detail_FULL;
+
+	if (needed_ns < MIN_FRAME_INTERVAL_NS)
+		gov->frame_interval_ns = MIN_FRAME_INTERVAL_NS;
+	else if (needed_ns > MAX_FRAME_INTERVAL_NS)
+		gov->frame_interval_ns = MAX_FRAME_INTERVAL_NS;
+	else
+		gov->frame_interval_ns = needed_ns;
+}
+
+void frame_governor_frame_end(frame_governor *gov)
+{
+	csync_end();
+	c_out = stdout;
+	cforget_state();
+	fflush(gov->frame_stream);
+	size_t len = ftell(gov->frame_stream);
+	gov->last_frame_ns = clock_ns();
+	gov->frames_rendered++;
+	// only full frames are used for the estimation, reduced ones are what we
+	// fall back to, not what we aim for
+	if (gov->detail == frame_detail_FULL)
+		gov->avg_frame_bytes = gov->avg_frame_bytes ? gov->avg_frame_bytes * 0.9 + len * 0.1 : len;
+
+	if (gov->inflight.off >= gov->inflight.len)
+		frame_buffer_set(&gov->inflight, gov->frame_stream_buf, len);
+	else
+	{
+		if (gov->next.len)
+		{
+			// never started, a newer state replaces it
+			gov->frames_skipped++;
+			TRACE_INSTANT("frame_dropped", NULL);
+		}
+		frame_buffer_set(&gov->next, gov->frame_stream_buf, len);
+	}
+	frame_governor_pump(gov);
+	frame_governor_adapt(gov);
+}
+
+static void frame_governor_sample(frame_governor *gov, u64 now)
+{
+	if (gov->busy_since_ns)
+	{
+		gov->window_ns += now - gov->busy_since_ns;
+		gov->busy_since_ns = now;
+	}
+	if (gov->window_ns < THROUGHPUT_WINDOW_NS)
+		return ;
+	double sample = gov->window_bytes * 1e9 / gov->window_ns;
+	gov->throughput = gov->throughput ? gov->throughput * 0.7 + sample * 0.3 : sample;
+	gov->window_bytes = 0;
+	gov->window_ns = 0;
+}
+
+// like a non-blocking write(). without a descriptor of its own, a pipe that
+// polls writable has room for at least PIPE_BUF bytes
+static ssize_t frame_write(frame_governor *gov, const char *buf, size_t len)
+{
+	if (gov->tty_fd != -1)
+		return (write(gov->tty_fd, buf, len));
+	struct pollfd pfd = {.fd = STDOUT_FILENO, .events = POLLOUT};
+	int ready = poll(&pfd, 1, 0);
+	if (ready <= 0)
+	{
+		if (!ready)
+			errno = EAGAIN;
+		return (-1);
+	}
+	return (write(STDOUT_FILENO, buf, len < PIPE_BUF ? len : PIPE_BUF));
+}
+
+size_t frame_governor_pump(frame_governor *gov)
+{
+	int was_busy = gov->busy_since_ns != 0;
+	int blocked = 0;
+	size_t total_written = 0;
+	while (gov->inflight.off < gov->inflight.len)
+	{
+		ssize_t written = frame_write(gov, gov->inflight.buf + gov->inflight.off, gov->inflight.len - gov->inflight.off);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				blocked = 1;
+			else
+				gov->inflight.off = gov->inflight.len; // nothing sensible to do with it
+			break;
+		}
+		gov->inflight.off += written;
+		total_written += written;
+		if (was_busy)
+			gov->window_bytes += written;
+		if (gov->inflight.off == gov->inflight.len && gov->next.len)
+		{
+			frame_buffer tmp = gov->inflight;
+			gov->inflight = gov->next;
+			gov->next = tmp;
+			gov->next.len = 0;
+			gov->next.off = 0;
+		}
+	}
+
+	u64 now = clock_ns();
+	frame_governor_sample(gov, now);
+	if (blocked && !gov->busy_since_ns)
+		gov->busy_since_ns = now;
+	else if (!blocked)
+	{
+		gov->busy_since_ns = 0;
+		// the terminal kept up, probe for more room in case it got faster
+		if (gov->throughput && total_written && !was_busy)
+			gov->throughput *= 1.05;
+	}
+	return (gov->inflight.len - gov->inflight.off + gov->next.len);
+}
+
+void frame_governor_end(frame_governor *gov)
+{
+	if (!gov->is_active)
+		return ;
+	if (gov->tty_fd != -1)
+	{
+		// the descriptor is ours, the last frames are finished blocking
+		fcntl(gov->tty_fd, F_SETFL, fcntl(gov->tty_fd, F_GETFL) & ~O_NONBLOCK);
+		frame_governor_pump(gov);
+		close(gov->tty_fd);
+	}
+	else
+	{
+		while (frame_governor_pump(gov))
+			poll(&(struct pollfd){.fd = STDOUT_FILENO, .events = POLLOUT}, 1, -1);
+	}
+	fclose(gov->frame_stream);
+	free(gov->frame_stream_buf);
+	free(gov->inflight.buf);
+	free(gov->next.buf);
+	memset(gov, 0, sizeof(*gov));
+}
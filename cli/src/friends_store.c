@@ -0,0 +1,65 @@
+#include "friends_store.h"
+#include "soft_fail.h"
+#include <stdlib.h>
+
+static size_t slot_of(int id, size_t cap)
+{
+	return (((u32)id * 2654435761u) & (cap - 1));
+}
+
+void friends_store_rebuild(friends_store *store, friends *friends)
+{
+	i64 size = friends->data.size;
+	size_t cap = 16;
+	while (cap < (size_t)size * 2)
+		cap <<= 1;
+	if (cap != store->slots_cap)
+	{
+		free(store->slots);
+		store->slots = xmalloc(cap * sizeof(*store->slots));
+		store->slots_cap = cap;
+	}
+	for (size_t i = 0; i < cap; i++)
+		store->slots[i] = -1;
+	for (i64 pos = 0; pos < size; pos++)
+	{
+		size_t slot = slot_of(friends->data.arr[pos].id, cap);
+		while (store->slots[slot] != -1)
+			slot = (slot + 1) & (cap - 1);
+		store->slots[slot] = pos;
+	}
+	store->friends = friends;
+	store->is_live = 1;
+}
+
+friend *friends_store_find(friends_store *store, int id, i64 *pos)
+{
+	if (!store->is_live)
+		return (NULL);
+	size_t slot = slot_of(id, store->slots_cap);
+	while (store->slots[slot] != -1)
+	{
+		friend *f = &store->friends->data.arr[store->slots[slot]];
+		if (f->id == id)
+		{
+			if (pos)
+				*pos = store->slots[slot];
+			return (f);
+		}
+		slot = (slot + 1) & (store->slots_cap - 1);
+	}
+	return (NULL);
+}
+
+void friends_store_invalidate(friends_store *store)
+{
+	store->is_live = 0;
+}
+
+void friends_store_deinit(friends_store *store)
+{
+	free(store->slots);
+	store->slots = NULL;
+	store->slots_cap = 0;
+	store->is_live = 0;
+}
@@ -1,10 +1,15 @@
 #include "input.h"
 #include "ctx.h"
+#include "term.h"
+#include "trace.h"
+#include "event_loop.h"
 #include <X11/XKBlib.h>
 #include <poll.h>
+#include <signal.h>
 #include <errno.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 int input_init(ctx *ctx)
 {
@@ -85,52 +90,122 @@ void input_burn_events(ctx *ctx)
 
 #define KEY_BACKSPACE 0x16
 
-void input_loop(ctx *ctx, on_input_func on_key_event, void (*on_ws_sock_event)(struct s_ctx *ctx))
+typedef struct
+{
+	ctx				*ctx;
+	on_input_func	*on_key_event;
+	void			(*on_ws_sock_event)(struct s_ctx *ctx);
+	event_loop		loop;
+}	input_loop_state;
+
+static void on_x11_ready(void *param, u32 events)
 {
+	(void)events;
+	input_loop_state *state = param;
+	ctx *ctx = state->ctx;
 	XEvent event;
-	struct pollfd fds[2] = {
-		{.fd = ConnectionNumber(ctx->dpy), .revents = 0, .events = POLLIN},
-		{.fd = ctx->ws_ctx.sock, .revents = 0, .events = POLLIN}
-	};
-	while (1)
+	TRACE_SCOPE("x11_events");
+	while (state->loop.running && XPending(ctx->dpy))
 	{
-		int err = poll(fds, 2, -1);
-		if (err < 0)
-		{
-			if (errno == EINTR)
-				continue;
-			fprintf(stderr, "poll() error: %s", strerror(errno));
-			break;
-		}
-		if (fds[1].revents & POLLIN)
-			on_ws_sock_event(ctx);
-		if (!(fds[0].revents & POLLIN))
-			continue;
-		while (XPending(ctx->dpy))
+		XNextEvent(ctx->dpy, &event);
+		if (event.type == KeyPress || event.type == KeyRelease)
 		{
-			XNextEvent(ctx->dpy, &event);
-			if (event.type == KeyPress || event.type == KeyRelease)
+			if (event.type == KeyRelease && event.xkey.keycode != KEY_BACKSPACE && XPending(ctx->dpy))
 			{
-				if (event.type == KeyRelease && event.xkey.keycode != KEY_BACKSPACE && XPending(ctx->dpy))
+				// check for auto-repeating key and remove it
+				XEvent next_event;
+				XPeekEvent(ctx->dpy, &next_event);
+				if (next_event.type == KeyPress
+					&& next_event.xkey.time == event.xkey.time
+					&& next_event.xkey.keycode == event.xkey.keycode)
 				{
-					// check for auto-repeating key and remove it
-					XEvent next_event;
-					XPeekEvent(ctx->dpy, &next_event);
-					if (next_event.type == KeyPress
-						&& next_event.xkey.time == event.xkey.time
-						&& next_event.xkey.keycode == event.xkey.keycode)
-					{
-						XNextEvent(ctx->dpy, &next_event); // consume event
-						continue;
-					}
+					XNextEvent(ctx->dpy, &next_event); // consume event
+					continue;
 				}
-				KeySym keysym = XkbKeycodeToKeysym(ctx->dpy, event.xkey.keycode, 0, event.xkey.state & ShiftMask);
-				if (on_key_event(ctx, keysym, event.type == KeyPress))
-					goto end;
 			}
+			KeySym keysym = XkbKeycodeToKeysym(ctx->dpy, event.xkey.keycode, 0, event.xkey.state & ShiftMask);
+			if (state->on_key_event(ctx, keysym, event.type == KeyPress))
+				event_loop_stop(&state->loop);
 		}
 	}
-	end:
+}
+
+static void on_ws_ready(void *param, u32 events)
+{
+	(void)events;
+	input_loop_state *state = param;
+	if (!state->loop.running)
+		return ;
+	TRACE_SCOPE("on_sock_event");
+	state->on_ws_sock_event(state->ctx);
+}
+
+static void on_net_ready(void *param, u32 events)
+{
+	(void)events;
+	input_loop_state *state = param;
+	CURLMcode merr = net_multi_dispatch(state->ctx->curl_multi);
+	if (merr)
+	{
+		fprintf(stderr, "curl multi error: %s", curl_multi_strerror(merr));
+		event_loop_stop(&state->loop);
+	}
+}
+
+static void refresh_after_resize(void *param, u32 arg)
+{
+	(void)param;
+	(void)arg;
+	crefresh(1);
+}
+
+static void on_resize_ready(void *param, u32 events)
+{
+	(void)events;
+	input_loop_state *state = param;
+	// once the other sources ready in the same iteration were handled
+	if (chandle_resize())
+		event_loop_defer(&state->loop, refresh_after_resize, NULL);
+}
+
+static void on_term_replies_ready(void *param, u32 events)
+{
+	(void)param;
+	(void)events;
+	chandle_term_replies();
+}
+
+static void on_quit_signal(void *param, u32 signo)
+{
+	(void)signo;
+	input_loop_state *state = param;
+	event_loop_stop(&state->loop);
+}
+
+void input_loop(ctx *ctx, on_input_func on_key_event, void (*on_ws_sock_event)(struct s_ctx *ctx))
+{
+	input_loop_state state = {.ctx = ctx, .on_key_event = on_key_event, .on_ws_sock_event = on_ws_sock_event};
+	if (!event_loop_init(&state.loop))
+		return ;
+	// the network loop is nested so that background transfers progress too
+	int ok = event_loop_add_fd(&state.loop, ConnectionNumber(ctx->dpy), EPOLLIN, on_x11_ready, &state)
+		&& event_loop_add_fd(&state.loop, ctx->ws_ctx.inbound_fd, EPOLLIN, on_ws_ready, &state)
+		&& event_loop_add_fd(&state.loop, net_multi_fd(), EPOLLIN, on_net_ready, &state)
+		&& event_loop_add_fd(&state.loop, STDIN_FILENO, EPOLLIN, on_term_replies_ready, &state)
+		&& event_loop_add_signal(&state.loop, SIGTERM, on_quit_signal, &state)
+		&& event_loop_add_signal(&state.loop, SIGHUP, on_quit_signal, &state);
+	// without a signalfd resizes are just not noticed
+	if (ok && cresize_fd() >= 0)
+		ok = !!event_loop_add_fd(&state.loop, cresize_fd(), EPOLLIN, on_resize_ready, &state);
+	if (ok)
+	{
+		// Xlib may already hold events read from its socket
+		event_loop_defer(&state.loop, on_x11_ready, &state);
+		ctx->ui_loop = &state.loop;
+		event_loop_run(&state.loop);
+		ctx->ui_loop = NULL;
+	}
+	event_loop_deinit(&state.loop);
 	// burn remaining events
 	input_burn_events(ctx);
 }
@@ -1,34 +1,74 @@
 #include "json_def.h"
+#include "json_index.h"
 #include "soft_fail.h"
 #include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
-static const json_def *find_def(const json_def *defs, const char *const name)
+// FNV-1a
+static u32 hash_name(const char *str, size_t len)
 {
-	const json_def *cur = defs;
-	while (cur->name)
+	u32 hash = 2166136261u;
+	for (size_t i = 0; i < len; i++)
+		hash = (hash ^ (u8)str[i]) * 16777619u;
+	return (hash);
+}
+
+// the tables are built by DEFINE_JSON as mutable arrays, the index is attached
+// to their first entry
+static const json_def_index *def_index(const json_def *defs)
+{
+	if (defs->index)
+		return (defs->index);
+	u32 count = 0;
+	while (defs[count].name)
+		count++;
+	if (count > JSON_DEF_MAX_FIELDS)
 	{
-		if (!strcmp(cur->name, name))
-			return (cur);
-		cur++;
+		fprintf(stderr, "FATAL: json_def table `%s` has more than %d fields\n", defs->name, JSON_DEF_MAX_FIELDS);
+		abort();
 	}
-	return (NULL);
+	// at most half full, so that probes stay short
+	u32 slot_count = 4;
+	while (slot_count < count * 2)
+		slot_count *= 2;
+	json_def_index *index = xcalloc(1, sizeof(*index) + count * sizeof(u32) + slot_count);
+	index->count = count;
+	index->mask = slot_count - 1;
+	index->required = count == 64 ? ~0ull : (1ull << count) - 1;
+	index->hashes = (u32 *)(index + 1);
+	index->slots = (u8 *)(index->hashes + count);
+	for (u32 i = 0; i < count; i++)
+	{
+		index->hashes[i] = hash_name(defs[i].name, defs[i].name_len);
+		u32 slot = index->hashes[i] & index->mask;
+		while (index->slots[slot])
+			slot = (slot + 1) & index->mask;
+		index->slots[slot] = i + 1;
+	}
+	((json_def *)defs)->index = index;
+	return (index);
 }
 
-static size_t def_count(const json_def *defs)
+// returns the index of the field named `name`, -1 if there is none
+static int find_def(const json_def *defs, const json_def_index *index, const char *name, size_t len)
 {
-	const json_def *cur = defs;
-	size_t cnt = 0;
-	while (cur->name)
+	u32 hash = hash_name(name, len);
+	for (u32 slot = hash & index->mask; index->slots[slot]; slot = (slot + 1) & index->mask)
 	{
-		cnt++;
-		cur++;
+		u32 i = index->slots[slot] - 1;
+		if (index->hashes[i] == hash && defs[i].name_len == len && !memcmp(defs[i].name, name, len))
+			return (i);
 	}
-	return (cnt);
+	return (-1);
 }
 
+// partially parsed objects are cleaned with these, see json_clean_obj()
+static void json_clean_obj_rec(const json_def *defs, void *in);
+static void json_clean_field(const json_def *def, void *in);
+
 json_content_error parse_array(cJSON *base, const json_def *def, void *out)
 {
 	json_content_error error;
@@ -45,6 +85,12 @@ json_content_error parse_array(cJSON *base, const json_def *def, void *out)
 		error = json_parse_from_def(elem, def->recursive_object, ptr);
 		if (error.kind)
 		{
+			// the elements before own their arrays
+			while (ptr != *ptr_loc)
+			{
+				ptr -= def->element_len;
+				json_clean_obj_rec(def->recursive_object, ptr);
+			}
 			free(*ptr_loc);
 			*ptr_loc = NULL;
 			return error;
@@ -64,19 +110,22 @@ json_content_error json_parse_from_def(cJSON *obj, const json_def *defs, void *o
 	*(cJSON **)out = NULL;
 	if (!cJSON_IsObject(obj))
 		return (json_content_error_make(json_error_kind_INVALID_JSON, obj));
-	size_t parsed_count = 0;
+	const json_def_index *index = def_index(defs);
+	u64 parsed = 0;
 	cJSON *cur = obj->child;
 	json_content_error recursive_error;
 	while (cur)
 	{
 		if (cJSON_IsInvalid(cur))
 			return (json_content_error_make(json_error_kind_INVALID_JSON, obj));
-		const json_def *def = find_def(defs, cur->string);
-		if (!def)
+		int field = find_def(defs, index, cur->string, strlen(cur->string));
+		// unknown keys are ignored, and a duplicated key only counts once
+		if (field < 0 || (parsed & (1ull << field)))
 		{
 			cur = cur->next;
 			continue;
 		}
+		const json_def *def = &defs[field];
 		if ((def->type & 0xFF) & (cur->type & 0xFF))
 		{
 			if (def->type & cJSON_NULL)
@@ -111,6 +160,13 @@ json_content_error json_parse_from_def(cJSON *obj, const json_def *defs, void *o
 					if (cur->type != cJSON_NULL)
 						*FETCH_AT_OFFSET(out, def->offset, const char *, 1) = cur->valuestring;
 					break;
+				case JSON_STRV:
+					*FETCH_AT_OFFSET(out, def->offset, json_strv, 0) = (json_strv){cur->valuestring, strlen(cur->valuestring), 0};
+					break;
+				case JSON_STRV_N:
+					if (cur->type != cJSON_NULL)
+						*FETCH_AT_OFFSET(out, def->offset, json_strv, 1) = (json_strv){cur->valuestring, strlen(cur->valuestring), 0};
+					break;
 				case JSON_OBJECT:
 					assert(def->recursive_object);
 					recursive_error = json_parse_from_def(cur, def->recursive_object, out + def->offset);
@@ -143,18 +199,474 @@ json_content_error json_parse_from_def(cJSON *obj, const json_def *defs, void *o
 					fprintf(stderr, "FATAL: Invalid json_def.type value: %d\n", cur->type);
 					abort();
 			}
-			parsed_count++;
+			parsed |= 1ull << field;
 		}
 		else
 			return (json_content_error_make(json_error_kind_INCORRECT_TYPE, cur));
 		cur = cur->next;
 	}
-	if (parsed_count != def_count(defs))
+	if (parsed != index->required)
 		return (json_content_error_make(json_error_kind_PARTIALLY_PARSED, obj));
 	*(cJSON **)out = obj;
 	return json_content_error_none;
 }
 
+// reader of json_parse_buffer_from_def(). the buffer is modified as it is read:
+// strings are NUL terminated where their closing quote was, and unescaped there.
+// the ends of strings and of the values to skip come from the structural index
+typedef struct
+{
+	char				*buf;
+	char				*cur;
+	const json_index	*index;
+	u32					next; // first entry of `index` not before `cur`
+	cJSON				*root; // owns the buffer, see json_parse_buffer_from_def()
+}	json_reader;
+
+// built from the main thread only, and kept for the next document
+static json_index	buffer_index = {0};
+
+// entry of the quote or bracket `reader->cur` is on, -1 if it isn't indexed
+static i64 index_entry(json_reader *reader)
+{
+	u32 offset = reader->cur - reader->buf;
+	const json_index *index = reader->index;
+	while (reader->next < index->count && index->pos[reader->next] < offset)
+		reader->next++;
+	if (reader->next == index->count || index->pos[reader->next] != offset)
+		return (-1);
+	return (reader->next);
+}
+
+#define JSON_SYNTAX_ERROR json_content_error_make(json_error_kind_INVALID_JSON)
+
+static void skip_ws(json_reader *reader)
+{
+	while (*reader->cur == ' ' || *reader->cur == '\t' || *reader->cur == '\n' || *reader->cur == '\r')
+		reader->cur++;
+}
+
+static int hex_value(char chr)
+{
+	if (chr >= '0' && chr <= '9')
+		return (chr - '0');
+	if ((chr | 0x20) >= 'a' && (chr | 0x20) <= 'f')
+		return ((chr | 0x20) - 'a' + 10);
+	return (-1);
+}
+
+static int read_hex4(const char *str)
+{
+	int value = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		int digit = hex_value(str[i]);
+		if (digit < 0)
+			return (-1);
+		value = value << 4 | digit;
+	}
+	return (value);
+}
+
+// the escapes were checked by read_string(), and none of them is shorter than
+// what it stands for, so `str` can be written while it is read
+static u32 unescape(char *str, u32 len)
+{
+	char *out = str;
+	const char *end = str + len;
+	for (const char *cur = str; cur < end; cur++)
+	{
+		if (*cur != '\\')
+		{
+			*out++ = *cur;
+			continue;
+		}
+		cur++;
+		switch (*cur)
+		{
+			case 'b': *out++ = '\b'; break;
+			case 'f': *out++ = '\f'; break;
+			case 'n': *out++ = '\n'; break;
+			case 'r': *out++ = '\r'; break;
+			case 't': *out++ = '\t'; break;
+			case 'u':
+			{
+				u32 code = read_hex4(cur + 1);
+				cur += 4;
+				// a lone surrogate is kept as is, like cJSON does not
+				if (code >= 0xD800 && code <= 0xDBFF && cur + 6 < end && cur[1] == '\\' && cur[2] == 'u')
+				{
+					int low = read_hex4(cur + 3);
+					if (low >= 0xDC00 && low <= 0xDFFF)
+					{
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+						cur += 6;
+					}
+				}
+				if (code < 0x80)
+					*out++ = code;
+				else if (code < 0x800)
+				{
+					*out++ = 0xC0 | code >> 6;
+					*out++ = 0x80 | (code & 0x3F);
+				}
+				else if (code < 0x10000)
+				{
+					*out++ = 0xE0 | code >> 12;
+					*out++ = 0x80 | (code >> 6 & 0x3F);
+					*out++ = 0x80 | (code & 0x3F);
+				}
+				else
+				{
+					*out++ = 0xF0 | code >> 18;
+					*out++ = 0x80 | (code >> 12 & 0x3F);
+					*out++ = 0x80 | (code >> 6 & 0x3F);
+					*out++ = 0x80 | (code & 0x3F);
+				}
+				break;
+			}
+			default: *out++ = *cur; // '"', '\\' and '/'
+		}
+	}
+	*out = 0;
+	return (out - str);
+}
+
+static int valid_escapes(const char *cur, const char *end)
+{
+	while ((cur = memchr(cur, '\\', end - cur)))
+	{
+		cur++;
+		if (*cur == 'u')
+		{
+			if (end - cur < 5 || read_hex4(cur + 1) < 0)
+				return (0);
+			cur += 4;
+		}
+		else if (!strchr("\"\\/bfnrt", *cur))
+			return (0);
+		cur++;
+	}
+	return (1);
+}
+
+// `reader->cur` is on the opening quote, the closing one is the next entry of
+// the index. the string is left escaped
+static int read_string(json_reader *reader, json_strv *view)
+{
+	i64 entry = index_entry(reader);
+	if (entry < 0 || entry + 1 >= reader->index->count)
+		return (0);
+	char *start = reader->cur + 1;
+	char *end = reader->buf + reader->index->pos[entry + 1];
+	u8 escaped = memchr(start, '\\', end - start) != NULL;
+	if (escaped && !valid_escapes(start, end))
+		return (0);
+	*end = 0;
+	reader->cur = end + 1;
+	reader->next = entry + 2;
+	*view = (json_strv){start, end - start, escaped};
+	return (1);
+}
+
+static int read_number(json_reader *reader, double *out)
+{
+	const char *start = reader->cur;
+	const char *cur = start;
+	if (*cur == '-')
+		cur++;
+	if (*cur < '0' || *cur > '9')
+		return (0);
+	while ((*cur >= '0' && *cur <= '9') || *cur == '.' || *cur == 'e' || *cur == 'E' || *cur == '+' || *cur == '-')
+		cur++;
+	char *end;
+	*out = strtod(start, &end);
+	if (end != cur)
+		return (0);
+	reader->cur = end;
+	return (1);
+}
+
+static int read_literal(json_reader *reader, const char *literal, size_t len)
+{
+	if (strncmp(reader->cur, literal, len))
+		return (0);
+	reader->cur += len;
+	return (1);
+}
+
+// the cJSON type of the value at `reader->cur`, 0 if nothing can start there
+static int value_type(const json_reader *reader)
+{
+	switch (*reader->cur)
+	{
+		case '"': return (cJSON_String);
+		case '{': return (cJSON_Object);
+		case '[': return (cJSON_Array);
+		case 't': return (cJSON_True);
+		case 'f': return (cJSON_False);
+		case 'n': return (cJSON_NULL);
+		case '-': return (cJSON_Number);
+		default: return (*reader->cur >= '0' && *reader->cur <= '9' ? cJSON_Number : 0);
+	}
+}
+
+// values of keys the defs don't know about. strings, objects and arrays are
+// jumped over in one step: what they contain isn't read, nor checked beyond
+// what the index checked
+static int skip_value(json_reader *reader)
+{
+	double number;
+	i64 entry;
+	u32 last;
+	switch (value_type(reader))
+	{
+		case cJSON_Number: return (read_number(reader, &number));
+		case cJSON_True: return (read_literal(reader, "true", 4));
+		case cJSON_False: return (read_literal(reader, "false", 5));
+		case cJSON_NULL: return (read_literal(reader, "null", 4));
+		case cJSON_String:
+		case cJSON_Object:
+		case cJSON_Array:
+			entry = index_entry(reader);
+			if (entry < 0 || (*reader->cur == '"' && entry + 1 >= reader->index->count))
+				return (0);
+			last = *reader->cur == '"' ? entry + 1 : reader->index->match[entry];
+			reader->cur = reader->buf + reader->index->pos[last] + 1;
+			reader->next = last + 1;
+			return (1);
+		default:
+			return (0);
+	}
+}
+
+static json_content_error read_object(json_reader *reader, const json_def *defs, void *out, int depth);
+
+static json_content_error read_array(json_reader *reader, const json_def *def, void *out, int depth)
+{
+	i64 *size_ptr = (i64 *)((u8 *)out + def->offset);
+	void **ptr_loc = (void **)((u8 *)out + def->offset + sizeof(size_t));
+	*ptr_loc = NULL;
+	*size_ptr = 0;
+	if (depth > JSON_MAX_DEPTH)
+		return (JSON_SYNTAX_ERROR);
+	i64 size = 0;
+	i64 cap = 0;
+	u8 *arr = NULL;
+	json_content_error error = json_content_error_none;
+	reader->cur++;
+	skip_ws(reader);
+	if (*reader->cur == ']')
+	{
+		reader->cur++;
+		return (json_content_error_none);
+	}
+	while (1)
+	{
+		if (size == cap)
+		{
+			cap = cap ? cap * 2 : 8;
+			arr = xrealloc(arr, cap * def->element_len);
+		}
+		error = read_object(reader, def->recursive_object, arr + size * def->element_len, depth + 1);
+		if (error.kind)
+			break;
+		size++;
+		skip_ws(reader);
+		if (*reader->cur == ']')
+		{
+			reader->cur++;
+			*ptr_loc = arr;
+			*size_ptr = size;
+			return (json_content_error_none);
+		}
+		if (*reader->cur++ != ',')
+		{
+			error = JSON_SYNTAX_ERROR;
+			break;
+		}
+		skip_ws(reader);
+	}
+	// the element that failed cleaned itself, the ones before own their arrays
+	for (i64 i = 0; i < size; i++)
+		json_clean_obj_rec(def->recursive_object, arr + i * def->element_len);
+	free(arr);
+	return (error);
+}
+
+static json_content_error read_field(json_reader *reader, const json_def *def, void *out, int depth)
+{
+	json_strv view;
+	double number;
+	int type = value_type(reader);
+	if (!type)
+		return (JSON_SYNTAX_ERROR);
+	if (!((def->type & 0xFF) & type))
+		return (json_content_error_make(json_error_kind_INCORRECT_TYPE));
+	u8 is_nullable = !!(def->type & cJSON_NULL);
+	if (is_nullable)
+		*FETCH_IS_NULL_AT_OFFSET(out, def->offset) = type == cJSON_NULL;
+	switch (type)
+	{
+		case cJSON_NULL:
+			return (read_literal(reader, "null", 4) ? json_content_error_none : JSON_SYNTAX_ERROR);
+		case cJSON_True:
+		case cJSON_False:
+			if (!read_literal(reader, type == cJSON_True ? "true" : "false", type == cJSON_True ? 4 : 5))
+				return (JSON_SYNTAX_ERROR);
+			*FETCH_AT_OFFSET(out, def->offset, u8, is_nullable) = type == cJSON_True;
+			return (json_content_error_none);
+		case cJSON_Number:
+			if (!read_number(reader, &number))
+				return (JSON_SYNTAX_ERROR);
+			if ((def->type & ~cJSON_NULL) == JSON_DOUBLE)
+				*FETCH_AT_OFFSET(out, def->offset, double, is_nullable) = number;
+			// saturated, as cJSON's valueint
+			else if (number >= INT_MAX)
+				*FETCH_AT_OFFSET(out, def->offset, int, is_nullable) = INT_MAX;
+			else if (number <= INT_MIN)
+				*FETCH_AT_OFFSET(out, def->offset, int, is_nullable) = INT_MIN;
+			else
+				*FETCH_AT_OFFSET(out, def->offset, int, is_nullable) = number;
+			return (json_content_error_none);
+		case cJSON_String:
+			if (!read_string(reader, &view))
+				return (JSON_SYNTAX_ERROR);
+			if ((def->type & ~cJSON_NULL) == JSON_STRV)
+				*FETCH_AT_OFFSET(out, def->offset, json_strv, is_nullable) = view;
+			else
+				*FETCH_AT_OFFSET(out, def->offset, const char *, is_nullable) = json_strv_cstr(&view);
+			return (json_content_error_none);
+		case cJSON_Object:
+			assert(def->recursive_object);
+			return (read_object(reader, def->recursive_object, out + def->offset + is_nullable, depth + 1));
+		default:
+			return (read_array(reader, def, out, depth + 1));
+	}
+}
+
+// the fields already read own their arrays, the one that failed cleaned itself
+static json_content_error fail_object(const json_def *defs, void *out, u64 parsed, json_content_error error)
+{
+	for (int i = 0; defs[i].name; i++)
+		if (parsed & (1ull << i))
+			json_clean_field(&defs[i], out);
+	return (error);
+}
+
+static json_content_error read_object(json_reader *reader, const json_def *defs, void *out, int depth)
+{
+	*(cJSON **)out = NULL;
+	if (*reader->cur != '{')
+		return (json_content_error_make(json_error_kind_INVALID_JSON));
+	if (depth > JSON_MAX_DEPTH)
+		return (JSON_SYNTAX_ERROR);
+	const json_def_index *index = def_index(defs);
+	u64 parsed = 0;
+	json_strv key;
+	reader->cur++;
+	skip_ws(reader);
+	if (*reader->cur == '}')
+		reader->cur++;
+	else while (1)
+	{
+		if (*reader->cur != '"' || !read_string(reader, &key))
+			return (fail_object(defs, out, parsed, JSON_SYNTAX_ERROR));
+		json_strv_cstr(&key);
+		skip_ws(reader);
+		if (*reader->cur++ != ':')
+			return (fail_object(defs, out, parsed, JSON_SYNTAX_ERROR));
+		skip_ws(reader);
+		int field = find_def(defs, index, key.ptr, key.len);
+		// unknown keys are ignored, and a duplicated key only counts once
+		if (field < 0 || (parsed & (1ull << field)))
+		{
+			if (!skip_value(reader))
+				return (fail_object(defs, out, parsed, JSON_SYNTAX_ERROR));
+		}
+		else
+		{
+			json_content_error error = read_field(reader, &defs[field], out, depth);
+			if (error.kind)
+			{
+				if (!error.field)
+					error.field = defs[field].name;
+				return (fail_object(defs, out, parsed, error));
+			}
+			parsed |= 1ull << field;
+		}
+		skip_ws(reader);
+		if (*reader->cur == '}')
+		{
+			reader->cur++;
+			break;
+		}
+		if (*reader->cur++ != ',')
+			return (fail_object(defs, out, parsed, JSON_SYNTAX_ERROR));
+		skip_ws(reader);
+	}
+	if (parsed != index->required)
+	{
+		json_content_error error = json_content_error_make(json_error_kind_PARTIALLY_PARSED);
+		for (int i = 0; defs[i].name && !error.field; i++)
+			if (!(parsed & (1ull << i)))
+				error.field = defs[i].name;
+		return (fail_object(defs, out, parsed, error));
+	}
+	// nested objects have nothing to own, they only show they were parsed
+	*(cJSON **)out = reader->root;
+	return (json_content_error_none);
+}
+
+json_content_error json_parse_buffer_from_def(char *buf, size_t len, const json_def *defs, void *out)
+{
+	assert(out && defs && !buf[len]);
+	*(cJSON **)out = NULL;
+	// a raw node frees its valuestring with it, so the buffer lives as long as
+	// the object that points into it
+	cJSON *root = cJSON_CreateNull();
+	if (!root)
+	{
+		free(buf);
+		return (json_content_error_make(json_error_kind_INVALID_JSON));
+	}
+	root->type = cJSON_Raw;
+	root->valuestring = buf;
+	json_reader reader = {.buf = buf, .cur = buf, .index = &buffer_index, .root = root};
+	json_content_error error = JSON_SYNTAX_ERROR;
+	skip_ws(&reader);
+	if (json_index_build(&buffer_index, buf, len))
+		error = read_object(&reader, defs, out, 0);
+	if (!error.kind)
+	{
+		skip_ws(&reader);
+		if (reader.cur != buf + len)
+		{
+			json_clean_obj_rec(defs, out);
+			error = JSON_SYNTAX_ERROR;
+		}
+	}
+	if (error.kind)
+	{
+		*(cJSON **)out = NULL;
+		cJSON_Delete(root);
+		error.in_buffer = 1;
+		error.offset = reader.cur - buf;
+	}
+	return (error);
+}
+
+const char *json_strv_cstr(json_strv *view)
+{
+	// the view is only escaped when it points into a buffer owned by the parsed object
+	if (view->escaped)
+	{
+		view->len = unescape((char *)view->ptr, view->len);
+		view->escaped = 0;
+	}
+	return (view->ptr);
+}
+
 void json_parse_from_def_force(cJSON *obj, const json_def *defs, void *out)
 {
 	json_content_error err = json_parse_from_def(obj, defs, out);
@@ -164,8 +676,6 @@ void json_parse_from_def_force(cJSON *obj, const json_def *defs, void *out)
 	}
 }
 
-static void json_clean_obj_rec(const json_def *defs, void *in);
-
 static void json_clean_array(const json_def *def, void *in)
 {
 	i64 *size_ptr = (i64 *)((u8 *)in + def->offset);
@@ -182,30 +692,31 @@ static void json_clean_array(const json_def *def, void *in)
 	*ptr_loc = NULL;
 }
 
-static void json_clean_obj_rec(const json_def *defs, void *in)
+static void json_clean_field(const json_def *def, void *in)
 {
-	const json_def *cur = defs;
-	while (cur->name)
+	switch (def->type)
 	{
-		switch (cur->type)
-		{
-			case JSON_ARRAY:
-				json_clean_array(cur, in);
-				break;
-			case JSON_OBJECT:
-				json_clean_obj_rec(cur->recursive_object, in + cur->offset);
-				break;
-			case JSON_OBJECT_N:
-				if (!*FETCH_IS_NULL_AT_OFFSET(in, cur->offset))
-					json_clean_obj_rec(cur->recursive_object, in + cur->offset + sizeof(u8));
-				break;
-			default:
-				break;
-		}
-		cur++;
+		case JSON_ARRAY:
+			json_clean_array(def, in);
+			break;
+		case JSON_OBJECT:
+			json_clean_obj_rec(def->recursive_object, in + def->offset);
+			break;
+		case JSON_OBJECT_N:
+			if (!*FETCH_IS_NULL_AT_OFFSET(in, def->offset))
+				json_clean_obj_rec(def->recursive_object, in + def->offset + sizeof(u8));
+			break;
+		default:
+			break;
 	}
 }
 
+static void json_clean_obj_rec(const json_def *defs, void *in)
+{
+	for (const json_def *cur = defs; cur->name; cur++)
+		json_clean_field(cur, in);
+}
+
 void json_clean_obj(void *in, const json_def *defs)
 {
 	cJSON *json = *(cJSON **)in;
@@ -245,6 +756,12 @@ void json_def_prettyprint(const json_def *defs, const void *in, FILE *stream, in
 				case JSON_STRING:
 					fprintf(stream, "\"%s\"\n", *FETCH_AT_OFFSET(in, cur->offset, const char *, is_nullable));
 					break;
+				case JSON_STRV:
+				{
+					const json_strv *view = FETCH_AT_OFFSET(in, cur->offset, json_strv, is_nullable);
+					fprintf(stream, "\"%.*s\"\n", (int)view->len, view->ptr);
+					break;
+				}
 				case JSON_OBJECT:
 					assert(cur->recursive_object);
 					fputs("{\n", stream);
@@ -290,7 +807,9 @@ void json_content_error_print(FILE *stream, json_content_error err)
 			break;
 	}
 	fprintf(stream, ". Erroring json: ");
-	if (!err.node)
+	if (!err.node && err.in_buffer)
+		fprintf(stream, "byte %u, in `%s`\n", err.offset, err.field ? err.field : "<TOP LEVEL>");
+	else if (!err.node)
 		fprintf(stream, "<NONE>\n");
 	else
 	{
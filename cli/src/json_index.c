@@ -0,0 +1,225 @@
+#include "json_index.h"
+#include "config.h"
+#include "soft_fail.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+# define HAS_X86 1
+#else
+# define HAS_X86 0
+#endif
+
+// the buffer is classified 64 bytes at a time, one bit per byte
+#define BLOCK_SIZE 64
+
+typedef struct
+{
+	u64	backslash;
+	u64	quote;
+	u64	structural; // { } [ ] : , wherever they are, strings are masked later
+}	block_masks;
+
+typedef void (classify_func)(const u8 *block, block_masks *masks);
+typedef u64 (prefix_xor_func)(u64 bits);
+
+static void classify_scalar(const u8 *block, block_masks *masks)
+{
+	*masks = (block_masks){0};
+	for (int i = 0; i < BLOCK_SIZE; i++)
+	{
+		u64 bit = 1ull << i;
+		u8 chr = block[i];
+		if (chr == '\\')
+			masks->backslash |= bit;
+		else if (chr == '"')
+			masks->quote |= bit;
+		// '[' and ']' are '{' and '}' without the 0x20 bit
+		else if ((chr | 0x20) == '{' || (chr | 0x20) == '}' || chr == ':' || chr == ',')
+			masks->structural |= bit;
+	}
+}
+
+// bit n set if an odd number of bits are set up to n included
+static u64 prefix_xor_shift(u64 bits)
+{
+	bits ^= bits << 1;
+	bits ^= bits << 2;
+	bits ^= bits << 4;
+	bits ^= bits << 8;
+	bits ^= bits << 16;
+	bits ^= bits << 32;
+	return (bits);
+}
+
+#if HAS_X86
+
+__attribute__((target("sse2")))
+static void classify_sse2(const u8 *block, block_masks *masks)
+{
+	*masks = (block_masks){0};
+	for (int i = 0; i < BLOCK_SIZE / 16; i++)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i *)(block + i * 16));
+		__m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+		__m128i structural = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(','))));
+		masks->backslash |= (u64)(u16)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'))) << (i * 16);
+		masks->quote |= (u64)(u16)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"'))) << (i * 16);
+		masks->structural |= (u64)(u16)_mm_movemask_epi8(structural) << (i * 16);
+	}
+}
+
+__attribute__((target("avx2")))
+static void classify_avx2(const u8 *block, block_masks *masks)
+{
+	*masks = (block_masks){0};
+	for (int i = 0; i < BLOCK_SIZE / 32; i++)
+	{
+		__m256i chunk = _mm256_loadu_si256((const __m256i *)(block + i * 32));
+		__m256i lower = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+		__m256i structural = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'))),
+			_mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(','))));
+		masks->backslash |= (u64)(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\'))) << (i * 32);
+		masks->quote |= (u64)(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"'))) << (i * 32);
+		masks->structural |= (u64)(u32)_mm256_movemask_epi8(structural) << (i * 32);
+	}
+}
+
+// a carry-less multiplication by all ones is a prefix xor
+__attribute__((target("sse2,pclmul")))
+static u64 prefix_xor_clmul(u64 bits)
+{
+	__m128i product = _mm_clmulepi64_si128(_mm_set_epi64x(0, bits), _mm_set1_epi8(0xFF), 0);
+	return (_mm_cvtsi128_si64(product));
+}
+
+#endif
+
+static classify_func	*classify = NULL;
+static prefix_xor_func	*prefix_xor = NULL;
+static json_index_impl	impl_in_use;
+
+json_index_impl json_index_select(json_index_impl impl)
+{
+#if HAS_X86
+	__builtin_cpu_init();
+	if (impl == json_index_impl_AVX2 && !__builtin_cpu_supports("avx2"))
+		impl = json_index_impl_SSE2;
+	if (impl == json_index_impl_SSE2 && !__builtin_cpu_supports("sse2"))
+		impl = json_index_impl_SCALAR;
+	classify = impl == json_index_impl_AVX2 ? classify_avx2
+		: impl == json_index_impl_SSE2 ? classify_sse2
+		: classify_scalar;
+	prefix_xor = impl != json_index_impl_SCALAR && __builtin_cpu_supports("pclmul") ? prefix_xor_clmul : prefix_xor_shift;
+#else
+	impl = json_index_impl_SCALAR;
+	classify = classify_scalar;
+	prefix_xor = prefix_xor_shift;
+#endif
+	impl_in_use = impl;
+	return (impl_in_use);
+}
+
+// bits of the characters that follow an odd number of backslashes. `prev_odd`
+// is 1 when the previous block ended with such a run
+static u64 escaped_chars(u64 backslash, u64 *prev_odd)
+{
+	const u64 even_bits = 0x5555555555555555ull;
+	const u64 odd_bits = ~even_bits;
+	u64 starts = backslash & ~(backslash << 1);
+	// a run continued from the previous block starts one position earlier
+	u64 even_start_mask = even_bits ^ *prev_odd;
+	u64 even_starts = starts & even_start_mask;
+	u64 odd_starts = starts & ~even_start_mask;
+	// adding the start of a run to it carries past its end
+	u64 even_carries = backslash + even_starts;
+	u64 odd_carries;
+	u64 ends_odd = __builtin_add_overflow(backslash, odd_starts, &odd_carries);
+	odd_carries |= *prev_odd;
+	*prev_odd = ends_odd;
+	u64 even_carry_ends = even_carries & ~backslash;
+	u64 odd_carry_ends = odd_carries & ~backslash;
+	return ((even_carry_ends & odd_bits) | (odd_carry_ends & even_bits));
+}
+
+static void reserve(json_index *index, u32 count)
+{
+	if (count <= index->cap)
+		return ;
+	u32 cap = index->cap ? index->cap : 256;
+	while (cap < count)
+		cap *= 2;
+	index->pos = xrealloc(index->pos, cap * sizeof(*index->pos));
+	index->match = xrealloc(index->match, cap * sizeof(*index->match));
+	index->cap = cap;
+}
+
+// pairs the brackets, the strings were checked by the scan
+static int match_brackets(json_index *index, const char *buf)
+{
+	u32 stack[JSON_MAX_DEPTH + 1];
+	int depth = 0;
+	for (u32 i = 0; i < index->count; i++)
+	{
+		char chr = buf[index->pos[i]];
+		if (chr == '{' || chr == '[')
+		{
+			if (depth > JSON_MAX_DEPTH)
+				return (0);
+			stack[depth++] = i;
+		}
+		else if (chr == '}' || chr == ']')
+		{
+			if (!depth || buf[index->pos[stack[depth - 1]]] != (chr == '}' ? '{' : '['))
+				return (0);
+			index->match[stack[--depth]] = i;
+		}
+	}
+	return (!depth);
+}
+
+int json_index_build(json_index *index, const char *buf, size_t len)
+{
+	if (!classify)
+		json_index_select(json_index_impl_AVX2);
+	index->count = 0;
+	u64 prev_odd = 0;
+	u64 prev_in_string = 0;
+	u8 tail[BLOCK_SIZE];
+	for (size_t base = 0; base < len; base += BLOCK_SIZE)
+	{
+		const u8 *block = (const u8 *)buf + base;
+		if (len - base < BLOCK_SIZE)
+		{
+			memset(tail, ' ', sizeof(tail));
+			memcpy(tail, block, len - base);
+			block = tail;
+		}
+		block_masks masks;
+		classify(block, &masks);
+		u64 quote = masks.quote & ~escaped_chars(masks.backslash, &prev_odd);
+		// set from an opening quote up to its closing one, excluded
+		u64 in_string = prefix_xor(quote) ^ prev_in_string;
+		prev_in_string = (u64)((i64)in_string >> 63);
+		u64 bits = (masks.structural & ~in_string) | quote;
+		reserve(index, index->count + BLOCK_SIZE);
+		while (bits)
+		{
+			index->pos[index->count++] = base + __builtin_ctzll(bits);
+			bits &= bits - 1;
+		}
+	}
+	if (prev_in_string)
+		return (0);
+	return (match_brackets(index, buf));
+}
+
+void json_index_deinit(json_index *index)
+{
+	free(index->pos);
+	free(index->match);
+	*index = (json_index){0};
+}
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <curl/curl.h>
 #include <string.h>
+#include <signal.h>
 #define JSON_DEF_IMPLEMENTATION
 #include "json_def.h"
 #include "api.h"
@@ -10,25 +11,77 @@
 #include "soft_fail.h"
 #include "json_defs.h"
 #include "ctx.h"
+#include "pong_render.h"
+#include "trace.h"
 #include "term.h"
+#include "event_loop.h"
+#include "clock.h"
 
 ctx g_ctx = {0}; 
 
-static int on_key_event(ctx *ctx, KeySym key, int on_press)
+// left/right move the cursor of the list of the current window, page up/down move it by a page
+// up/down are left to the component navigation so the buttons stay reachable
+static int list_views_move(ctx *ctx, KeySym key)
 {
-	(void)ctx;
-	if (key == XK_Left && on_press)
+	list_view *list_view;
+	if (cur_term_window_type == ctx->tournament_view.list_view.my_window)
+		list_view = &ctx->tournament_view.list_view;
+	else if (cur_term_window_type == ctx->friends_view.list_view.my_window)
+		list_view = &ctx->friends_view.list_view;
+	else
+		return (0);
+	switch (key)
 	{
-		if (list_view_update(&ctx->tournament_view.list_view, ctx, -1)
-			|| list_view_update(&ctx->friends_view.list_view, ctx, -1))
+		case XK_Left:
+			list_view_update(list_view, ctx, -1);
+			return (1);
+		case XK_Right:
+			list_view_update(list_view, ctx, 1);
+			return (1);
+		case XK_Prior:
+			list_view_update(list_view, ctx, -list_view->rows_count);
+			return (1);
+		case XK_Next:
+			list_view_update(list_view, ctx, list_view->rows_count);
+			return (1);
+		default:
 			return (0);
 	}
-	else if (key == XK_Right && on_press)
+}
+
+// up/down scroll the chat by one message, page up/down by a screen
+static int chat_view_move(ctx *ctx, KeySym key)
+{
+	if (cur_term_window_type != term_window_type_CHAT)
+		return (0);
+	int page = ctx->chat_view.pane->u.c_chat_pane.h;
+	int delta;
+	switch (key)
 	{
-		if (list_view_update(&ctx->tournament_view.list_view, ctx, 1)
-			|| list_view_update(&ctx->friends_view.list_view, ctx, 1))
+		case XK_Up:
+			delta = 1;
+			break;
+		case XK_Down:
+			delta = -1;
+			break;
+		case XK_Prior:
+			delta = page;
+			break;
+		case XK_Next:
+			delta = -page;
+			break;
+		default:
 			return (0);
 	}
+	if (chat_pane_scroll(ctx->chat_view.pane, delta))
+		crefresh(0);
+	return (1);
+}
+
+static int on_key_event(ctx *ctx, KeySym key, int on_press)
+{
+	if (on_press && (list_views_move(ctx, key) || chat_view_move(ctx, key)))
+		return (0);
 	else if (on_press && key == XK_Escape)
 	{
 		if (cur_term_window_type == term_window_type_LOGIN)
@@ -38,6 +91,9 @@ static int on_key_event(ctx *ctx, KeySym key, int on_press)
 		{
 			if (cur_term_window_type == term_window_type_LOGIN)
 			{
+				paged_list_reset(&ctx->tournament_pages);
+				api_cache_cancel(&ctx->friends_cache);
+				friends_store_invalidate(&ctx->friends_store);
 				api_ctx_remove_token(&ctx->api_ctx);
 				json_clean_obj(&ctx->user_login, login_def);
 			}
@@ -53,6 +109,12 @@ static int on_key_event(ctx *ctx, KeySym key, int on_press)
 	return (0);
 }
 
+static void tournament_row_text(void *obj, char *buf, size_t buf_size)
+{
+	tournament *t = obj;
+	snprintf(buf, buf_size, "%s", t->name);
+}
+
 static void update_tournament_view(void *obj, void *param)
 {
 	tournament *t = obj;
@@ -60,19 +122,30 @@ static void update_tournament_view(void *obj, void *param)
 
 	if (t)
 	{
-		label_update_text(ctx->tournament_view.tournament_name, t->name, 0);
+		label_update_text(ctx->tournament_view.tournament_name, t->name);
+	}
+	else if (paged_list_is_loading(&ctx->tournament_pages))
+	{
+		label_update_text(ctx->tournament_view.tournament_name, "LOADING...");
 	}
 	else
 	{
-		label_update_text(ctx->tournament_view.tournament_name, "NO TOURNAMENT", 0);
+		label_update_text(ctx->tournament_view.tournament_name, "NO TOURNAMENT");
 	}
 }
 
+// the rows that were missing are filled once their page arrived
+static void on_tournament_page_loaded(void *param)
+{
+	ctx *ctx = param;
+	list_view_update(&ctx->tournament_view.list_view, ctx, 0);
+}
+
 static void refresh_tournaments(ctx *ctx)
 {
 	cswitch_window(term_window_type_TOURNAMENT_VIEW, 0);
-	json_clean_obj(&ctx->tournaments, tournaments_def);
-	do_api_request_to_def(&ctx->api_ctx, "api/local-tournaments/history", GET, tournaments_def, &ctx->tournaments);
+	// only the pages around the cursor are fetched, starting from the first one
+	paged_list_reset(&ctx->tournament_pages);
 	ctx->tournament_view.list_view.list_cursor = 0;
 	list_view_update(&ctx->tournament_view.list_view, ctx, 0);
 }
@@ -111,7 +184,7 @@ static void attempt_login(ctx *ctx)
 	char *error;
 	if (!json_success(json, &error))
 	{
-		label_update_text(ctx->login_view.login_error_label, xstrdup(error), 1);
+		label_copy_text(ctx->login_view.login_error_label, error);
 		cJSON_Delete(json);
 		crefresh(0);
 	}
@@ -147,7 +220,7 @@ static void attempt_register(ctx *ctx)
 	char *error;
 	if (!json_success(json, &error))
 	{
-		label_update_text(ctx->register_view.register_error_label, xstrdup(error), 1);
+		label_copy_text(ctx->register_view.register_error_label, error);
 		cJSON_Delete(json);
 		crefresh(0);
 	}
@@ -201,41 +274,105 @@ static void handle_friend_challenge_button(console_component *button, int press,
 		cJSON *json = do_api_request(&ctx->api_ctx, endpoint_buf, POST);
 		char *error;
 		if (!json_success(json, &error))
-			label_update_text(ctx->friends_view.friend_challenge_text, xstrdup(error), 1);
+			label_copy_text(ctx->friends_view.friend_challenge_text, error);
 		else
-			label_update_text(ctx->friends_view.friend_challenge_text, "Request sent !", 0);
+			label_update_text(ctx->friends_view.friend_challenge_text, "Request sent !");
 		crefresh(0);
 		cJSON_Delete(json);
 	}
 
 }
 
+static void friend_row_text(void *obj, char *buf, size_t buf_size)
+{
+	friend *f = obj;
+	snprintf(buf, buf_size, "%c %s", f->is_online ? '*' : ' ', json_strv_cstr(&f->display_name));
+}
+
+// only the labels fed by fields that websocket events can change
+static void update_friend_live_fields(ctx *ctx, const friend *f)
+{
+	label_update_text(ctx->friends_view.friend_status, f->is_online ? "online" : "offline");
+	label_printf(ctx->friends_view.friend_record, "W %d / L %d", f->total_wins, f->total_losses);
+}
+
 static void update_friends_view(void *obj, void *param)
 {
 	friend *f = obj;
 	ctx *ctx = param;
 	
-	label_update_text(ctx->friends_view.friend_challenge_text, NULL, 0);
+	label_update_text(ctx->friends_view.friend_challenge_text, NULL);
 	if (f)
 	{
 		ctx->friends_view.selected_friend = f;
-		label_update_text(ctx->friends_view.friend_name, f->display_name, 0);
+		// copied, the list can be replaced while another window is shown
+		label_copy_text(ctx->friends_view.friend_name, json_strv_cstr(&f->display_name));
+		update_friend_live_fields(ctx, f);
 	}
 	else
 	{
 		ctx->friends_view.selected_friend = NULL;
-		label_update_text(ctx->friends_view.friend_name, "NO FRIEND :(", 0);
+		label_update_text(ctx->friends_view.friend_name, "NO FRIEND :(");
+		label_update_text(ctx->friends_view.friend_status, NULL);
+		label_update_text(ctx->friends_view.friend_record, NULL);
+	}
+}
+
+static void on_friends_revalidated(api_cache_entry *entry, api_cache_result result, void *param)
+{
+	ctx *ctx = param;
+	(void)entry;
+	// also after a 304, a reconnection may have invalidated the store
+	friends_store_rebuild(&ctx->friends_store, &ctx->friends);
+	if (result == api_cache_result_UPDATED && cur_term_window_type != term_window_type_FRIENDS_VIEW)
+	{
+		// the selection was in the previous body, it comes back with the cursor
+		ctx->friends_view.selected_friend = NULL;
+		if (ctx->friends_view.friend_name)
+		{
+			label_update_text(ctx->friends_view.friend_name, NULL);
+			label_update_text(ctx->friends_view.friend_status, NULL);
+			label_update_text(ctx->friends_view.friend_record, NULL);
+			label_update_text(ctx->friends_view.friend_challenge_text, NULL);
+		}
 	}
+	if (cur_term_window_type != term_window_type_FRIENDS_VIEW
+		|| (result == api_cache_result_NOT_MODIFIED && API_CACHE_STALE_WHILE_REVALIDATE))
+		return ;
+	ctx->friends_view.list_view.list_cursor = 0;
+	list_view_update(&ctx->friends_view.list_view, ctx, 0);
+	crefresh(0);
 }
 
 static void refresh_friends(ctx *ctx)
 {
 	cswitch_window(term_window_type_FRIENDS_VIEW, 0);
-
-	json_clean_obj(&ctx->friends, friends_def);
-	do_api_request_to_def(&ctx->api_ctx, "api/friends", GET, friends_def, &ctx->friends);
 	ctx->friends_view.list_view.list_cursor = 0;
-	list_view_update(&ctx->friends_view.list_view, ctx, 0);
+	// websocket events only patch the list in between, it is revalidated on each
+	// entry since the server doesn't announce every change (e.g. a new friend).
+	// the list is drawn again by on_friends_revalidated() when the server answers,
+	// a list fetched with another token is never shown
+	if (!api_cache_is_fresh_for(&ctx->api_ctx, &ctx->friends_cache))
+	{
+		json_clean_obj(&ctx->friends, friends_def);
+		list_view_update(&ctx->friends_view.list_view, ctx, 0);
+	}
+	else if (API_CACHE_STALE_WHILE_REVALIDATE)
+		list_view_update(&ctx->friends_view.list_view, ctx, 0);
+	if (!api_cache_revalidate(&ctx->api_ctx, &ctx->friends_cache, "api/friends", friends_def,
+		&ctx->friends, on_friends_revalidated, ctx))
+		clean_and_fail("api/friends: unable to start the request\n");
+}
+
+// called when the friend at `pos` was modified in place
+static void friend_entry_changed(ctx *ctx, const friend *f, i64 pos)
+{
+	if (cur_term_window_type != term_window_type_FRIENDS_VIEW)
+		return ;
+	list_view_refresh_index(&ctx->friends_view.list_view, pos);
+	if (ctx->friends_view.list_view.list_cursor == pos)
+		update_friend_live_fields(ctx, f);
+	crefresh(0);
 }
 
 static void handle_tournament_window_switch_button(console_component *button, int press, void *param)
@@ -252,6 +389,187 @@ static void handle_friends_window_switch_button(console_component *button, int p
 		refresh_friends((ctx *)param);
 }
 
+static void handle_chat_window_switch_button(console_component *button, int press, void *param)
+{
+	(void)button;
+	(void)param;
+	if (press)
+		cswitch_window(term_window_type_CHAT, 1);
+}
+
+static void on_chat_redraw_timer(void *param, u32 expirations)
+{
+	(void)expirations;
+	ctx *ctx = param;
+	ctx->chat_view.redraw_pending = 0;
+	if (cur_term_window_type != term_window_type_CHAT)
+		return ;
+	mark_dirty(ctx->chat_view.pane, 0);
+	crefresh(0);
+}
+
+// a burst of messages is drawn at once, at most every CHAT_REDRAW_INTERVAL_MS
+static void schedule_chat_redraw(ctx *ctx)
+{
+	if (cur_term_window_type != term_window_type_CHAT || !ctx->ui_loop || ctx->chat_view.redraw_pending)
+		return ;
+	if (!ctx->chat_view.redraw_timer)
+		ctx->chat_view.redraw_timer = event_loop_add_timer(ctx->ui_loop, 0, 0, on_chat_redraw_timer, ctx);
+	if (!ctx->chat_view.redraw_timer)
+		return ;
+	event_loop_set_timer(ctx->chat_view.redraw_timer, CHAT_REDRAW_INTERVAL_MS * 1000000ull, 0);
+	ctx->chat_view.redraw_pending = 1;
+}
+
+static const char *chat_user_name(ctx *ctx, int id, char *buf, size_t buf_size)
+{
+	i64 pos;
+	friend *f = friends_store_find(&ctx->friends_store, id, &pos);
+	if (f)
+		return (json_strv_cstr(&f->display_name));
+	snprintf(buf, buf_size, "#%d", id);
+	return (buf);
+}
+
+// returns 0 if it isn't a chat message. they are only stored while the chat
+// isn't shown, so the game isn't slowed down by a busy channel
+static int receive_chat_message(ctx *ctx, ws_recv_data *data)
+{
+	char name_buf[16];
+	if (!strcmp(data->type, "chat_message"))
+	{
+		chat_message message;
+		if (json_parse_from_def(data->json, chat_message_def, &message).kind)
+			return (1);
+		chat_log_push(&ctx->chat_log, chat_kind_CHANNEL, message.userId,
+			chat_user_name(ctx, message.userId, name_buf, sizeof(name_buf)), message.message);
+	}
+	else if (!strcmp(data->type, "direct_message_received") || !strcmp(data->type, "direct_message_sent"))
+	{
+		direct_message dm;
+		if (json_parse_from_def(data->json, direct_message_def, &dm).kind)
+			return (1);
+		direct_message_content *content = &dm.data.message;
+		if (!strcmp(data->type, "direct_message_sent"))
+			chat_log_push(&ctx->chat_log, chat_kind_DM_SENT, content->sender_id, "me", content->content);
+		else
+			chat_log_push(&ctx->chat_log, chat_kind_DM_RECEIVED, content->sender_id,
+				chat_user_name(ctx, content->sender_id, name_buf, sizeof(name_buf)), content->content);
+	}
+	else
+		return (0);
+	schedule_chat_redraw(ctx);
+	return (1);
+}
+
+// only the labels of the matchmaking window, which has to be the one shown
+static void update_matchmaking_labels(ctx *ctx)
+{
+	const matchmaking *mm = &ctx->matchmaking;
+	if (mm->status == matchmaking_status_IDLE)
+	{
+		label_update_text(ctx->matchmaking_view.status, "Not searching");
+		label_update_text(ctx->matchmaking_view.waited, NULL);
+		label_update_text(ctx->matchmaking_view.estimate, NULL);
+		return ;
+	}
+	if (mm->status == matchmaking_status_MATCHED)
+	{
+		label_update_text(ctx->matchmaking_view.status, "Match found, starting the game...");
+		label_update_text(ctx->matchmaking_view.waited, NULL);
+		label_update_text(ctx->matchmaking_view.estimate, NULL);
+		return ;
+	}
+	u64 now = clock_ns();
+	if (mm->status == matchmaking_status_JOINING)
+		label_update_text(ctx->matchmaking_view.status, "Joining the queue...");
+	else
+		label_printf(ctx->matchmaking_view.status, "Position %d of %d", mm->position, mm->total);
+	u32 waited = (now - mm->joined_ns) / 1000000000ull;
+	label_printf(ctx->matchmaking_view.waited, "Waiting for %u:%02u", waited / 60, waited % 60);
+	u64 estimate_ns = matchmaking_estimate_ns(mm, now);
+	u32 estimate = (estimate_ns + 999999999ull) / 1000000000ull;
+	if (estimate)
+		label_printf(ctx->matchmaking_view.estimate, "About %u:%02u left", estimate / 60, estimate % 60);
+	else
+		label_update_text(ctx->matchmaking_view.estimate, "No estimate yet");
+}
+
+static void on_matchmaking_tick(void *param, u32 expirations)
+{
+	(void)expirations;
+	ctx *ctx = param;
+	if (cur_term_window_type != term_window_type_MATCHMAKING)
+		return ;
+	update_matchmaking_labels(ctx);
+	crefresh(0);
+}
+
+// the time waited keeps going up while in the queue, whatever window is shown
+static void set_matchmaking_ticking(ctx *ctx, int is_ticking)
+{
+	if (!ctx->ui_loop)
+		return ;
+	if (!ctx->matchmaking_view.tick_timer)
+		ctx->matchmaking_view.tick_timer = event_loop_add_timer(ctx->ui_loop, 0, 0, on_matchmaking_tick, ctx);
+	if (!ctx->matchmaking_view.tick_timer)
+		return ;
+	u64 interval_ns = is_ticking ? MATCHMAKING_TICK_MS * 1000000ull : 0;
+	event_loop_set_timer(ctx->matchmaking_view.tick_timer, interval_ns, interval_ns);
+}
+
+// a match that was found can't be left, the server is starting its game
+static void leave_matchmaking(ctx *ctx)
+{
+	if (ctx->matchmaking.status != matchmaking_status_JOINING
+		&& ctx->matchmaking.status != matchmaking_status_QUEUED)
+		return ;
+	REQ_WS_MATCHMAKING_LEAVE(ctx->ws_ctx.send_buf);
+	ws_send(&ctx->ws_ctx);
+	matchmaking_leave(&ctx->matchmaking);
+	set_matchmaking_ticking(ctx, 0);
+	if (cur_term_window_type == term_window_type_MATCHMAKING)
+	{
+		update_matchmaking_labels(ctx);
+		crefresh(0);
+	}
+}
+
+static void handle_matchmaking_window_switch_button(console_component *button, int press, void *param)
+{
+	(void)button;
+	ctx *ctx = param;
+	if (press)
+	{
+		cswitch_window(term_window_type_MATCHMAKING, 0);
+		update_matchmaking_labels(ctx);
+		crefresh(1);
+	}
+}
+
+// the answers come as events, see on_sock_event()
+static void handle_matchmaking_join_button(console_component *button, int press, void *param)
+{
+	(void)button;
+	ctx *ctx = param;
+	if (!press || ctx->matchmaking.status != matchmaking_status_IDLE)
+		return ;
+	REQ_WS_MATCHMAKING_JOIN(ctx->ws_ctx.send_buf);
+	ws_send(&ctx->ws_ctx);
+	matchmaking_join(&ctx->matchmaking, clock_ns());
+	set_matchmaking_ticking(ctx, 1);
+	label_update_text(ctx->matchmaking_view.error, NULL);
+	update_matchmaking_labels(ctx);
+	crefresh(0);
+}
+
+static void handle_matchmaking_leave_button(console_component *button, int press, void *param)
+{
+	(void)button;
+	if (press)
+		leave_matchmaking((ctx *)param);
+}
+
 static void handle_invite_decline_button(console_component *button, int press, void *param)
 {
 	(void)button;
@@ -297,157 +615,135 @@ static void handle_get_ready_button(console_component *button, int press, void *
 	}
 }
 
-static void init_windows(ctx *ctx)
-{
-	console_component component;
+#define LIST_BOX_X 4
+#define LIST_BOX_Y 4
+#define LIST_BOX_W 30
+#define LIST_BOX_H 14
+#define LIST_DETAILS_X (LIST_BOX_X + LIST_BOX_W + 3)
 
-	cswitch_window(term_window_type_LOGIN, 0);
-	{
-		label_init(&component, 2, 2, "USERNAME", 0);
-		ccomponent_add(component);
+#define INVITE_BOX_X 4
+#define INVITE_BOX_Y 4
+#define INVITE_BOX_W 20
+#define INVITE_BOX_H 8
 
-		label_init(&component, 2, 6, "PASSWORD", 0);
-		ccomponent_add(component);
-		
-		label_init(&component, 40, 6, "2FA KEY", 0);
-		ccomponent_add(component);		
+#define READY_BOX_X 4
+#define READY_BOX_Y 4
+#define READY_BOX_W 22
+#define READY_BOX_H 9
 
-		ctx->login_view.username_field = add_pretty_textarea(3, 3, 32, "...", 0);
-		ctx->login_view.password_field = add_pretty_textarea(3, 7, 32, "...", 1);
-		ctx->login_view.totp_field = add_pretty_textarea(41, 7, 6, "XXXXXX", 0);
+#define CHAT_PANE_H 18
 
-		add_pretty_button(15, 10, " LOGIN ", handle_login_button, ctx);
+static const component_layout login_layout[] = {
+	{.type = layout_LABEL, .x = 2, .y = 2, .text = "USERNAME"},
+	{.type = layout_LABEL, .x = 2, .y = 6, .text = "PASSWORD"},
+	{.type = layout_LABEL, .x = 40, .y = 6, .text = "2FA KEY"},
+	{.type = layout_PRETTY_TEXT_AREA, .x = 3, .y = 3, .w = 32, .text = "...", .ref = &g_ctx.login_view.username_field},
+	{.type = layout_PRETTY_TEXT_AREA, .x = 3, .y = 7, .w = 32, .text = "...", .text_hidden = 1, .ref = &g_ctx.login_view.password_field},
+	{.type = layout_PRETTY_TEXT_AREA, .x = 41, .y = 7, .w = 6, .text = "XXXXXX", .ref = &g_ctx.login_view.totp_field},
+	{.type = layout_PRETTY_BUTTON, .x = 15, .y = 10, .text = " LOGIN ", .func = handle_login_button, .param = &g_ctx},
+	{.type = layout_BUTTON, .x = 15, .y = 14, .text = "REGISTER", .func = handle_register_window_switch_button, .param = &g_ctx},
+	{.type = layout_LABEL, .x = 2, .y = 17, .ref = &g_ctx.login_view.login_error_label},
+};
 
-		button_init(&component, 15, 14, "REGISTER", handle_register_window_switch_button, ctx);
-		ccomponent_add(component);
+static const component_layout register_layout[] = {
+	{.type = layout_LABEL, .x = 2, .y = 2, .text = "USERNAME"},
+	{.type = layout_PRETTY_TEXT_AREA, .x = 3, .y = 3, .w = 32, .text = "...", .ref = &g_ctx.register_view.username_field},
+	{.type = layout_LABEL, .x = 2, .y = 6, .text = "PASSWORD"},
+	{.type = layout_PRETTY_TEXT_AREA, .x = 3, .y = 7, .w = 32, .text = "...", .text_hidden = 1, .ref = &g_ctx.register_view.password_field},
+	{.type = layout_LABEL, .x = 2, .y = 10, .text = "EMAIL"},
+	{.type = layout_PRETTY_TEXT_AREA, .x = 3, .y = 11, .w = 32, .text = "...", .ref = &g_ctx.register_view.email_field},
+	{.type = layout_LABEL, .x = 2, .y = 14, .text = "DISPLAY NAME"},
+	{.type = layout_PRETTY_TEXT_AREA, .x = 3, .y = 15, .w = 32, .text = "...", .ref = &g_ctx.register_view.display_name_field},
+	{.type = layout_PRETTY_BUTTON, .x = 14, .y = 18, .text = " REGISTER ", .func = handle_register_button, .param = &g_ctx},
+	{.type = layout_LABEL, .x = 2, .y = 21, .ref = &g_ctx.register_view.register_error_label},
+};
 
-		label_init(&component, 2, 17, NULL, 0);
-		ctx->login_view.login_error_label = ccomponent_add(component);
-	}
+static const component_layout dashboard_layout[] = {
+	{.type = layout_PRETTY_BUTTON, .x = 15, .y = 6, .text = " TOURNAMENTS ", .func = handle_tournament_window_switch_button, .param = &g_ctx},
+	{.type = layout_PRETTY_BUTTON, .x = 15, .y = 11, .text = " FRIENDS ", .func = handle_friends_window_switch_button, .param = &g_ctx},
+	{.type = layout_PRETTY_BUTTON, .x = 15, .y = 16, .text = " CHAT ", .func = handle_chat_window_switch_button, .param = &g_ctx},
+	{.type = layout_PRETTY_BUTTON, .x = 15, .y = 21, .text = " MATCHMAKING ", .func = handle_matchmaking_window_switch_button, .param = &g_ctx},
+};
 
-	cswitch_window(term_window_type_REGISTER, 0);
-	{
-		label_init(&component, 2, 2, "USERNAME", 0);
-		ccomponent_add(component);
-		ctx->register_view.username_field = add_pretty_textarea(3, 3, 32, "...", 0);
+static const component_layout friends_layout[] = {
+	{.type = layout_LIST_VIEW, .x = LIST_BOX_X, .y = LIST_BOX_Y, .w = LIST_BOX_W, .h = LIST_BOX_H, .list_view = &g_ctx.friends_view.list_view},
+	{.type = layout_LABEL, .x = LIST_BOX_X, .y = LIST_BOX_Y - 1, .text = "FRIENDS"},
+	{.type = layout_LABEL, .x = LIST_DETAILS_X, .y = LIST_BOX_Y + 1, .ref = &g_ctx.friends_view.friend_name},
+	{.type = layout_LABEL, .x = LIST_DETAILS_X, .y = LIST_BOX_Y + 3, .ref = &g_ctx.friends_view.friend_status},
+	{.type = layout_LABEL, .x = LIST_DETAILS_X, .y = LIST_BOX_Y + 4, .ref = &g_ctx.friends_view.friend_record},
+	{.type = layout_BUTTON, .x = LIST_DETAILS_X, .y = LIST_BOX_Y + 7, .text = "CHALLENGE", .func = handle_friend_challenge_button, .param = &g_ctx},
+	{.type = layout_LABEL, .x = LIST_DETAILS_X, .y = LIST_BOX_Y + 9, .wrap_around = 25, .ref = &g_ctx.friends_view.friend_challenge_text},
+};
 
-		label_init(&component, 2, 6, "PASSWORD", 0);
-		ccomponent_add(component);
-		ctx->register_view.password_field = add_pretty_textarea(3, 7, 32, "...", 1);
+static const component_layout tournaments_layout[] = {
+	{.type = layout_LIST_VIEW, .x = LIST_BOX_X, .y = LIST_BOX_Y, .w = LIST_BOX_W, .h = LIST_BOX_H, .list_view = &g_ctx.tournament_view.list_view},
+	{.type = layout_LABEL, .x = LIST_BOX_X, .y = LIST_BOX_Y - 1, .text = "TOURNAMENTS"},
+	{.type = layout_LABEL, .x = LIST_DETAILS_X, .y = LIST_BOX_Y + 1, .ref = &g_ctx.tournament_view.tournament_name},
+	{.type = layout_BUTTON, .x = LIST_DETAILS_X, .y = LIST_BOX_Y + 3, .text = "ENTER", .func = handle_tournament_enter_button, .param = &g_ctx},
+};
 
-		label_init(&component, 2, 10, "EMAIL", 0);
-		ccomponent_add(component);
-		ctx->register_view.email_field = add_pretty_textarea(3, 11, 32, "...", 0);
+static const component_layout invite_overlay_layout[] = {
+	{.type = layout_BOX, .x = INVITE_BOX_X, .y = INVITE_BOX_Y, .w = INVITE_BOX_W, .h = INVITE_BOX_H},
+	{.type = layout_LABEL, .x = INVITE_BOX_X + 1, .y = INVITE_BOX_Y + 1, .wrap_around = INVITE_BOX_W - 1, .ref = &g_ctx.invite_overlay_view.from_username},
+	{.type = layout_LABEL, .x = INVITE_BOX_X + 1, .y = INVITE_BOX_Y + 3, .text = "has invited you to play a game !!", .wrap_around = INVITE_BOX_W - 1},
+	{.type = layout_BUTTON, .x = INVITE_BOX_X + 4, .y = INVITE_BOX_Y + INVITE_BOX_H - 2, .text = "ACCEPT", .func = handle_invite_accept_button, .param = &g_ctx},
+	{.type = layout_BUTTON, .x = INVITE_BOX_X + 11, .y = INVITE_BOX_Y + INVITE_BOX_H - 2, .text = "DECLINE", .func = handle_invite_decline_button, .param = &g_ctx},
+	{.type = layout_LABEL, .x = INVITE_BOX_X + 1, .y = INVITE_BOX_Y + INVITE_BOX_H + 1, .ref = &g_ctx.invite_overlay_view.invite_error},
+};
 
-		label_init(&component, 2, 14, "DISPLAY NAME", 0);
-		ccomponent_add(component);
-		ctx->register_view.display_name_field = add_pretty_textarea(3, 15, 32, "...", 0);
+static const component_layout get_ready_layout[] = {
+	{.type = layout_BOX, .x = READY_BOX_X, .y = READY_BOX_Y, .w = READY_BOX_W, .h = READY_BOX_H},
+	{.type = layout_LABEL, .x = READY_BOX_X + 4, .y = READY_BOX_Y + 4, .text = "GET READY !!", .wrap_around = READY_BOX_W - 4},
+	{.type = layout_LABEL, .x = READY_BOX_X + 4, .y = READY_BOX_Y + 6, .wrap_around = READY_BOX_W - 4, .ref = &g_ctx.get_ready_view.opponent_ready_message},
+	{.type = layout_PRETTY_BUTTON, .x = READY_BOX_X + 4, .y = READY_BOX_Y + READY_BOX_H - 3, .text = "GO", .func = handle_get_ready_button, .param = &g_ctx},
+};
 
-		add_pretty_button(14, 18, " REGISTER ", handle_register_button, ctx);
+static const component_layout game_over_layout[] = {
+	{.type = layout_LABEL, .x = 4, .y = 4, .text = "GAME OVER"},
+	{.type = layout_LABEL, .x = 5, .y = 6, .text = "Your score: "},
+	{.type = layout_LABEL, .x = 5, .y = 8, .text = "Opponent's score: "},
+	{.type = layout_LABEL, .x = 5 + 13, .y = 6, .ref = &g_ctx.game_over_view.your_score},
+	{.type = layout_LABEL, .x = 5 + 19, .y = 8, .ref = &g_ctx.game_over_view.opponent_score},
+};
 
-		label_init(&component, 2, 21, NULL, 0);
-		ctx->register_view.register_error_label = ccomponent_add(component);
-	}
+static const component_layout chat_layout[] = {
+	{.type = layout_LABEL, .x = 2, .y = 1, .text = "CHAT"},
+	{.type = layout_CHAT_PANE, .y = 3, .h = CHAT_PANE_H, .chat_log = &g_ctx.chat_log, .ref = &g_ctx.chat_view.pane},
+};
 
-	cswitch_window(term_window_type_DASHBOARD, 0);
-	{
-		label_init(&component, 2, 2, "DASHBOARD", 0);
-		add_pretty_button(15, 6, " TOURNAMENTS ", handle_tournament_window_switch_button, ctx);
+static const component_layout matchmaking_layout[] = {
+	{.type = layout_LABEL, .x = 2, .y = 1, .text = "MATCHMAKING"},
+	{.type = layout_LABEL, .x = 4, .y = 4, .ref = &g_ctx.matchmaking_view.status},
+	{.type = layout_LABEL, .x = 4, .y = 6, .ref = &g_ctx.matchmaking_view.waited},
+	{.type = layout_LABEL, .x = 4, .y = 7, .ref = &g_ctx.matchmaking_view.estimate},
+	{.type = layout_LABEL, .x = 4, .y = 8, .ref = &g_ctx.matchmaking_view.error},
+	{.type = layout_PRETTY_BUTTON, .x = 4, .y = 10, .text = " SEARCH ", .func = handle_matchmaking_join_button, .param = &g_ctx},
+	{.type = layout_BUTTON, .x = 18, .y = 11, .text = "CANCEL", .func = handle_matchmaking_leave_button, .param = &g_ctx},
+};
 
-		add_pretty_button(15, 11, " FRIENDS ", handle_friends_window_switch_button, ctx);
-	}
+static const window_layout window_layouts[term_window_type__MAX] = {
+	[term_window_type_LOGIN] = WINDOW_LAYOUT(login_layout),
+	[term_window_type_REGISTER] = WINDOW_LAYOUT(register_layout),
+	[term_window_type_DASHBOARD] = WINDOW_LAYOUT(dashboard_layout),
+	[term_window_type_FRIENDS_VIEW] = WINDOW_LAYOUT(friends_layout),
+	[term_window_type_TOURNAMENT_VIEW] = WINDOW_LAYOUT(tournaments_layout),
+	[term_window_type_PONG_INVITE_OVERLAY] = WINDOW_LAYOUT(invite_overlay_layout),
+	[term_window_type_PONG_GET_READY] = WINDOW_LAYOUT(get_ready_layout),
+	[term_window_type_PONG_GAME_OVER] = WINDOW_LAYOUT(game_over_layout),
+	[term_window_type_CHAT] = WINDOW_LAYOUT(chat_layout),
+	[term_window_type_MATCHMAKING] = WINDOW_LAYOUT(matchmaking_layout),
+};
 
-	cswitch_window(term_window_type_FRIENDS_VIEW, 0);
-	{
-		const int BOX_X = 4;
-		const int BOX_Y = 4;
-		const int BOX_W = 50;
-		const int BOX_H = 14;
-
-		list_view_init(&ctx->friends_view.list_view, BOX_X, BOX_Y, BOX_W, BOX_H, update_friends_view, &ctx->friends.data.size, (void **)&ctx->friends.data.arr, sizeof(friend));
-		label_init(&component, BOX_X, BOX_Y - 1, "FRIENDS", 0);
-		ccomponent_add(component);
-		label_init(&component, BOX_X + 2, BOX_Y + 2, NULL, 0);
-		ctx->friends_view.friend_name = ccomponent_add(component);
-		button_init(&component, BOX_X + 4, BOX_Y + BOX_H - 3, "CHALLENGE", handle_friend_challenge_button, ctx);
-		ccomponent_add(component);
-		label_init(&component, BOX_X + 4, BOX_Y + BOX_H - 2, NULL, 0);
-		label_wrap_around(&component, BOX_W - 5);
-		ctx->friends_view.friend_challenge_text = ccomponent_add(component);
-	}
-	
-	cswitch_window(term_window_type_TOURNAMENT_VIEW, 0);
-	{
-		const int BOX_X = 4;
-		const int BOX_Y = 4;
-		const int BOX_W = 50;
-		const int BOX_H = 14;
-
-		list_view_init(&ctx->tournament_view.list_view, BOX_X, BOX_Y, BOX_W, BOX_H, update_tournament_view, &ctx->tournaments.data.tournaments.size, (void **)&ctx->tournaments.data.tournaments.arr, sizeof(tournament));
-		label_init(&component, BOX_X, BOX_Y - 1, "TOURNAMENTS", 0);
-		ccomponent_add(component);
-		label_init(&component, BOX_X + 2, BOX_Y + 1, NULL, 0);
-		ctx->tournament_view.tournament_name = ccomponent_add(component);
-		button_init(&component, BOX_X + 4, BOX_Y + BOX_H - 2, "ENTER", handle_tournament_enter_button, ctx);
-		ccomponent_add(component);
-	}
-	cswitch_window(term_window_type_PONG_INVITE_OVERLAY, 0);
-	{
-		const int BOX_X = 4;
-		const int BOX_Y = 4;
-		const int BOX_W = 20;
-		const int BOX_H = 8;
-
-		box_init(
-			&component, BOX_X, BOX_Y, BOX_W, BOX_H, DEFAULT_BOX_STYLE
-		);
-		ccomponent_add(component);
-		label_init(&component, BOX_X + 1, BOX_Y + 1, NULL, 0);
-		label_wrap_around(&component, BOX_W - 1);
-		ctx->invite_overlay_view.from_username = ccomponent_add(component);
-		label_init(&component, BOX_X + 1, BOX_Y + 3, "has invited you to play a game !!", 0);
-		label_wrap_around(&component, BOX_W - 1);
-		ccomponent_add(component);
-		button_init(&component, BOX_X + 4, BOX_Y + BOX_H - 2, "ACCEPT", handle_invite_accept_button, ctx);
-		ccomponent_add(component);
-		button_init(&component, BOX_X + 11, BOX_Y + BOX_H - 2, "DECLINE", handle_invite_decline_button, ctx);
-		ccomponent_add(component);
-		label_init(&component, BOX_X + 1, BOX_Y + BOX_H + 1, NULL, 0);
-		ctx->invite_overlay_view.invite_error = ccomponent_add(component);
-	}
-	cswitch_window(term_window_type_PONG_GET_READY, 0);
-	{
-		const int BOX_X = 4;
-		const int BOX_Y = 4;
-		const int BOX_W = 22;
-		const int BOX_H = 9;
-
-		box_init(
-			&component, BOX_X, BOX_Y, BOX_W, BOX_H, DEFAULT_BOX_STYLE
-		);
-		ccomponent_add(component);
-		label_init(&component, BOX_X + 4, BOX_Y + 4, "GET READY !!", 0);
-		label_wrap_around(&component, BOX_W - 4);
-		ccomponent_add(component);
-		label_init(&component, BOX_X + 4, BOX_Y + 6, NULL, 0);
-		label_wrap_around(&component, BOX_W - 4);
-		ctx->get_ready_view.opponent_ready_message = ccomponent_add(component);
-		ccomponent_add(component);
-		add_pretty_button(BOX_X + 4, BOX_Y + BOX_H - 3, "GO", handle_get_ready_button, ctx);
-	}
-	cswitch_window(term_window_type_PONG_GAME_OVER, 0);
-	{
-		label_init(&component, 4, 4, "GAME OVER", 0);
-		ccomponent_add(component);
-		label_init(&component, 5, 6, "Your score: ", 0);
-		ccomponent_add(component);
-		label_init(&component, 5, 8, "Opponent's score: ", 0);
-		ccomponent_add(component);
-		label_init(&component, 5 + 13, 6, NULL, 0);
-		ctx->game_over_view.your_score = ccomponent_add(component);
-		label_init(&component, 5 + 19, 8, NULL, 0);
-		ctx->game_over_view.opponent_score = ccomponent_add(component);
-	}
+// the windows themselves are only built when they are first shown
+static void init_windows(ctx *ctx)
+{
+	list_view_init(&ctx->friends_view.list_view, update_friends_view, friend_row_text,
+		&ctx->friends.data.size, (void **)&ctx->friends.data.arr, sizeof(friend));
+	list_view_init_source(&ctx->tournament_view.list_view, update_tournament_view, tournament_row_text,
+		paged_list_get, paged_list_may_have, &ctx->tournament_pages);
+	ctx->tournament_pages.on_loaded = on_tournament_page_loaded;
+	ctx->tournament_pages.on_loaded_param = ctx;
+	cset_window_layouts(window_layouts);
 }
 
 static const char * get_ws_message(cJSON *json)
@@ -458,152 +754,228 @@ static const char * get_ws_message(cJSON *json)
 	return (message_obj->valuestring);
 }
 
-# define FULL_LINE "\u2503"
-# define HALF_UP_LINE "\u2579"
-# define HALF_DOWN_LINE "\u257B"
-# define FULL_BLOCK "\u2588"
-# include <math.h>
+// the game is driven by its own event loop: states are stored when they come
+// in, and a timer at the rate allowed by the frame governor renders the latest
+typedef struct
+{
+	ctx				*ctx;
+	event_loop		loop;
+	event_source	*frame_timer;
+	event_source	*ws_watchdog;
+	u64				frame_timer_interval_ns;
+	frame_governor	governor;
+	game_state		state;
+	int				has_new_state;
+	int				last_up;
+	int				last_down;
+	int				my_score;
+	int				opponent_score;
+	int				quit; // SIGTERM or SIGHUP, the whole program exits
+}	game_session;
 
-static void render_paddle(u16 x, float y, float height)
+static void game_on_ws_ready(void *param, u32 events)
 {
-	float integral, fractional;
-	
-	float paddle_start = y - height / 2;
-	float paddle_end = y + height / 2;
-	fractional = modff(paddle_start, &integral);
-	if (fractional < 0.45)
+	(void)events;
+	game_session *game = param;
+	ctx *ctx = game->ctx;
+	ws_recv_data data;
+	if (!game->loop.running || !ws_try_recv(&ctx->ws_ctx, &data))
+		return ;
+	TRACE_SCOPE_DETAIL("game_state", data.type);
+	// the server sends states continuously, silence means it is gone
+	event_loop_set_timer(game->ws_watchdog, MAX_WS_TIMEOUT * 1000000ull, 0);
+	if (!strcmp(data.type, "simple_pong_state") || !strcmp(data.type, "friend_pong_state"))
 	{
-		cursor_goto(x, paddle_start - 1);
-		PUTS(HALF_DOWN_LINE);
+		json_parse_from_def_force(data.json, game_state_def, &game->state);
+		if (ctx->i_was_invited || ctx->matchmaking.plays_left)
+		{
+			game->my_score = game->state.gameState.leftScore;
+			game->opponent_score = game->state.gameState.rightScore;
+		}
+		else
+		{
+			game->opponent_score = game->state.gameState.leftScore;
+			game->my_score = game->state.gameState.rightScore;
+		}
+		game->has_new_state = !game->state.gameState.gameOver;
 	}
-	int pos = paddle_start;
-	int paddle_end_int = paddle_end;
-	while (pos < paddle_end_int)
+	else if (!strcmp(data.type, "opponent_disconnected"))
+		event_loop_stop(&game->loop);
+	else
+		receive_chat_message(ctx, &data);
+	cJSON_Delete(data.json);
+}
+
+static void game_on_ws_timeout(void *param, u32 expirations)
+{
+	(void)param;
+	(void)expirations;
+	clean_and_fail("no message from the server for %dms\n", MAX_WS_TIMEOUT);
+}
+
+static void game_on_frame_timer(void *param, u32 expirations)
+{
+	(void)expirations;
+	game_session *game = param;
+	if (game->has_new_state && frame_governor_should_render(&game->governor))
 	{
-		cursor_goto(x, pos++);
-		PUTS(FULL_LINE);
+		TRACE_SCOPE("game_frame");
+		frame_governor_frame_begin(&game->governor);
+		render_pong_scene(&game->state, game->governor.detail);
+		frame_governor_frame_end(&game->governor);
+		game->has_new_state = 0;
 	}
-	fractional = modff(paddle_end, &integral);
-	if (fractional > 0.55)
+	frame_governor_pump(&game->governor);
+	// the governor adapts the frame rate to the terminal
+	if (game->governor.frame_interval_ns != game->frame_timer_interval_ns)
 	{
-		cursor_goto(x, paddle_end_int);
-		PUTS(HALF_UP_LINE);
+		game->frame_timer_interval_ns = game->governor.frame_interval_ns;
+		event_loop_set_timer(game->frame_timer, game->frame_timer_interval_ns, game->frame_timer_interval_ns);
 	}
 }
 
-static void render_ball(float x, float y, float width_ratio, float height_ratio)
+static void game_on_x11_ready(void *param, u32 events)
 {
-	const float true_ball_width = BALL_SIZE * width_ratio;
-	const float true_ball_height = BALL_SIZE * height_ratio;
-	float ball_start_x, ball_start_y;
-	const float ball_end_x = x + true_ball_width;
-	const float ball_end_y = y + true_ball_height;
-	
-	ball_start_y = y - true_ball_height;
-	while (ball_start_y < ball_end_y)
+	(void)events;
+	game_session *game = param;
+	ctx *ctx = game->ctx;
+	input_poll(ctx);
+	if (ctx->input.pressed.up != game->last_up || ctx->input.pressed.down != game->last_down)
 	{
-		ball_start_x = x - true_ball_width;
-		while (ball_start_x < ball_end_x)
-		{
-			float dist = ((x - ball_start_x) * (x - ball_start_x) / (true_ball_width * true_ball_width)) + ((y - ball_start_y) * (y - ball_start_y) / (true_ball_height * true_ball_height));
-			if (dist <= 1)
-			{
-				cursor_goto(ball_start_x, ball_start_y);
-				PUTS(FULL_BLOCK);
-			}
-			ball_start_x++;
-		}
-		ball_start_y++;
+		game->last_up = ctx->input.pressed.up;
+		game->last_down = ctx->input.pressed.down;
+		REQ_WS_INPUT_UPDATE(ctx->ws_ctx.send_buf, game->last_up, game->last_down);
+		ws_send(&ctx->ws_ctx);
 	}
 }
 
-static void render_pong_scene(const game_state *state)
+static void game_on_net_ready(void *param, u32 events)
 {
-	PUTS(ESC_CLEAR_SCREEN);
-	if (c_x >= 10 && c_y >= 5)
-	{
-		float height_ratio = c_y / (float)ARENA_HEIGHT;
-		float width_ratio = c_x / (float)ARENA_WIDTH;
+	(void)events;
+	game_session *game = param;
+	// background transfers keep going, their errors can wait for the ui
+	net_multi_dispatch(game->ctx->curl_multi);
+}
 
-		float paddle_height = PADDLE_HEIGHT * height_ratio;
-		render_paddle(1, state->gameState.leftPaddleY * height_ratio, paddle_height);
-		render_paddle(c_x - 1, state->gameState.rightPaddleY  * height_ratio, paddle_height);
-		render_ball(state->gameState.ballX * width_ratio, state->gameState.ballY * height_ratio, width_ratio, height_ratio);
-		cursor_goto(c_x / 2 - 1, c_y - 1);
-		printf("%d/%d", state->gameState.leftScore, state->gameState.rightScore);
-	}
-	fflush(stdout);
+static void game_on_resize_ready(void *param, u32 events)
+{
+	(void)param;
+	(void)events;
+	// the next frame is drawn with the new size, nothing else to redraw
+	chandle_resize();
+}
+
+static void game_on_term_replies_ready(void *param, u32 events)
+{
+	(void)param;
+	(void)events;
+	chandle_term_replies();
+}
+
+static void game_on_quit_signal(void *param, u32 signo)
+{
+	(void)signo;
+	game_session *game = param;
+	game->quit = 1;
+	event_loop_stop(&game->loop);
 }
 
 static void game_loop(ctx *ctx)
 {
-	int last_up = -1;
-	int last_down = -1;
-	int my_score, opponent_score;
-	while (1)
+	game_session game = {.ctx = ctx, .last_up = -1, .last_down = -1};
+	if (!event_loop_init(&game.loop))
+		clean_and_fail("game event loop init fail\n");
+	frame_governor_begin(&game.governor);
+	game.frame_timer_interval_ns = game.governor.frame_interval_ns;
+	game.frame_timer = event_loop_add_timer(&game.loop, game.frame_timer_interval_ns,
+		game.frame_timer_interval_ns, game_on_frame_timer, &game);
+	game.ws_watchdog = event_loop_add_timer(&game.loop, MAX_WS_TIMEOUT * 1000000ull, 0, game_on_ws_timeout, &game);
+	if (!game.frame_timer || !game.ws_watchdog
+		|| !event_loop_add_fd(&game.loop, ConnectionNumber(ctx->dpy), EPOLLIN, game_on_x11_ready, &game)
+		|| !event_loop_add_fd(&game.loop, ctx->ws_ctx.inbound_fd, EPOLLIN, game_on_ws_ready, &game)
+		|| !event_loop_add_fd(&game.loop, net_multi_fd(), EPOLLIN, game_on_net_ready, &game)
+		|| !event_loop_add_fd(&game.loop, STDIN_FILENO, EPOLLIN, game_on_term_replies_ready, &game)
+		|| !event_loop_add_signal(&game.loop, SIGTERM, game_on_quit_signal, &game)
+		|| !event_loop_add_signal(&game.loop, SIGHUP, game_on_quit_signal, &game)
+		|| (cresize_fd() >= 0 && !event_loop_add_fd(&game.loop, cresize_fd(), EPOLLIN, game_on_resize_ready, &game)))
+		clean_and_fail("game event loop setup fail\n");
+	// keys pressed before the game started may already be queued by Xlib
+	event_loop_defer(&game.loop, game_on_x11_ready, &game);
+	if (!event_loop_run(&game.loop))
+		clean_and_fail("game event loop fail\n");
+	event_loop_deinit(&game.loop);
+	frame_governor_end(&game.governor);
+	if (game.quit)
 	{
-		input_poll(ctx);
-		if (ctx->input.pressed.up != last_up || ctx->input.pressed.down != last_down)
-		{
-			last_up = ctx->input.pressed.up;
-			last_down = ctx->input.pressed.down;
-			REQ_WS_INPUT_UPDATE(ctx->ws_ctx.send_buf, last_up, last_down);
-			ws_send(&ctx->ws_ctx);
-		}
-		ws_recv_data data = ws_recv(&ctx->ws_ctx);
-		if (!strcmp(data.type, "simple_pong_state") || !strcmp(data.type, "friend_pong_state"))
-		{
-			game_state state;
-			json_parse_from_def_force(data.json, game_state_def, &state);
-			if (ctx->i_was_invited)
-			{
-				my_score = state.gameState.leftScore;
-				opponent_score = state.gameState.rightScore;
-			}
-			else
-			{
-				opponent_score = state.gameState.leftScore;
-				my_score = state.gameState.rightScore;
-			}
-			if (!state.gameState.gameOver)
-			{
-				render_pong_scene(&state);
-			}
-		}
-		else if (!strcmp(data.type, "opponent_disconnected"))
-		{
-			cJSON_Delete(data.json);
-			break;
-		}
-		cJSON_Delete(data.json);
+		// the ui loop stops before its next wait, main() does the cleanup
+		if (ctx->ui_loop)
+			event_loop_stop(ctx->ui_loop);
+		return ;
 	}
+	int my_score = game.my_score;
+	int opponent_score = game.opponent_score;
 	input_burn_events(ctx);
-	label_update_text(ctx->friends_view.friend_challenge_text, NULL, 0);
+	// the friends window isn't built if the game came from an invite
+	if (ctx->friends_view.friend_challenge_text)
+		label_update_text(ctx->friends_view.friend_challenge_text, NULL);
 	cprevious_window(0);
 	cprevious_window(0);
 	if (ctx->i_was_invited)
 		cprevious_window(0);
 	ctx->i_was_invited = 0;
-	char integer_buf[20];
-	sprintf(integer_buf, "%d", my_score);
-	label_update_text(ctx->game_over_view.your_score, xstrdup(integer_buf), 1);
-	sprintf(integer_buf, "%d", opponent_score);
-	label_update_text(ctx->game_over_view.opponent_score, xstrdup(integer_buf), 1);
-	cswitch_window(term_window_type_PONG_GAME_OVER, 1);
+	ctx->matchmaking.plays_left = 0;
+	// the labels only exist once the window was switched to
+	cswitch_window(term_window_type_PONG_GAME_OVER, 0);
+	label_printf(ctx->game_over_view.your_score, "%d", my_score);
+	label_printf(ctx->game_over_view.opponent_score, "%d", opponent_score);
+	crefresh(1);
 }
 
 static void on_sock_event(ctx *ctx)
 {
-	ws_recv_data data = ws_recv(&ctx->ws_ctx);
+	ws_recv_data data;
+	if (!ws_try_recv(&ctx->ws_ctx, &data))
+		return ;
+	TRACE_INSTANT("ws_message", data.type);
 
 	int delete_json = 1;
 	if (!strcmp(data.type, "auth_success"))
 	{
+		// events may have been missed while disconnected
+		friends_store_invalidate(&ctx->friends_store);
+		// and the server forgot the queue with the previous connection
+		matchmaking_leave(&ctx->matchmaking);
+		set_matchmaking_ticking(ctx, 0);
 		cswitch_window(term_window_type_DASHBOARD, 1);
 	}
+	else if (!strcmp(data.type, "friend_status_update"))
+	{
+		friend_status_update update;
+		json_parse_from_def_force(data.json, friend_status_update_def, &update);
+		i64 pos;
+		friend *f = friends_store_find(&ctx->friends_store, update.userId, &pos);
+		if (f && f->is_online != update.isOnline)
+		{
+			f->is_online = update.isOnline;
+			friend_entry_changed(ctx, f, pos);
+		}
+	}
+	else if (!strcmp(data.type, "friend_stats_update"))
+	{
+		friend_stats_update update;
+		json_parse_from_def_force(data.json, friend_stats_update_def, &update);
+		i64 pos;
+		friend *f = friends_store_find(&ctx->friends_store, update.userId, &pos);
+		if (f)
+		{
+			f->total_wins = update.totalWins;
+			f->total_losses = update.totalLosses;
+			friend_entry_changed(ctx, f, pos);
+		}
+	}
 	else if (!strcmp(data.type, "auth_error"))
 	{
-		label_update_text(ctx->login_view.login_error_label, "Websocket Login Error", 0);
+		label_update_text(ctx->login_view.login_error_label, "Websocket Login Error");
 		json_clean_obj(&ctx->user_login, login_def);
 		crefresh(0);
 	}
@@ -612,8 +984,9 @@ static void on_sock_event(ctx *ctx)
 		if (cur_term_window_type != term_window_type_PONG_INVITE_OVERLAY)
 		{
 			json_parse_from_def_force(data.json, friend_pong_invite_def, &ctx->pong_invite);
-			label_update_text(ctx->invite_overlay_view.from_username, ctx->pong_invite.fromUsername, 0);
-			cswitch_window(term_window_type_PONG_INVITE_OVERLAY, 1);
+			cswitch_window(term_window_type_PONG_INVITE_OVERLAY, 0);
+			label_update_text(ctx->invite_overlay_view.from_username, ctx->pong_invite.fromUsername);
+			crefresh(1);
 			ctx->i_was_invited = 1;
 			ctx->opponent_ready = 0;
 			ctx->i_am_ready = 0;
@@ -624,9 +997,15 @@ static void on_sock_event(ctx *ctx)
 	{
 		if (cur_term_window_type != term_window_type_PONG_GET_READY)
 		{
+			leave_matchmaking(ctx);
 			json_parse_from_def_force(data.json, friend_pong_accepted_def, &ctx->pong_accepted);
-			label_update_text(ctx->get_ready_view.opponent_ready_message, NULL, 0);
-			cswitch_window(term_window_type_PONG_GET_READY, 1);
+			// the game of a match found in the queue
+			if (ctx->matchmaking.status == matchmaking_status_MATCHED)
+				matchmaking_on_start(&ctx->matchmaking, ctx->pong_accepted.role
+					&& !strcmp(ctx->pong_accepted.role, "left"));
+			cswitch_window(term_window_type_PONG_GET_READY, 0);
+			label_update_text(ctx->get_ready_view.opponent_ready_message, NULL);
+			crefresh(1);
 			delete_json = 0;
 		}
 	}
@@ -634,7 +1013,7 @@ static void on_sock_event(ctx *ctx)
 	{
 		if (cur_term_window_type == term_window_type_PONG_INVITE_OVERLAY)
 		{
-			label_update_text(ctx->invite_overlay_view.invite_error, xstrdup(get_ws_message(data.json)), 1);
+			label_copy_text(ctx->invite_overlay_view.invite_error, get_ws_message(data.json));
 			crefresh(0);
 		}
 	}
@@ -650,10 +1029,54 @@ static void on_sock_event(ctx *ctx)
 			}
 			else
 			{
-				label_update_text(ctx->get_ready_view.opponent_ready_message, xstrdup(get_ws_message(data.json)), 1);
+				label_copy_text(ctx->get_ready_view.opponent_ready_message, get_ws_message(data.json));
+			}
+		}
+	}
+	else if (!strcmp(data.type, "matchmaking:waiting"))
+	{
+		matchmaking_waiting waiting;
+		if (!json_parse_from_def(data.json, matchmaking_waiting_def, &waiting).kind
+			&& matchmaking_on_waiting(&ctx->matchmaking, waiting.position, waiting.totalInQueue, clock_ns())
+			&& cur_term_window_type == term_window_type_MATCHMAKING)
+		{
+			update_matchmaking_labels(ctx);
+			crefresh(0);
+		}
+	}
+	else if (!strcmp(data.type, "matchmaking:found"))
+	{
+		// the server starts the game right after, see simple_pong_start
+		if (ctx->matchmaking.status == matchmaking_status_JOINING
+			|| ctx->matchmaking.status == matchmaking_status_QUEUED)
+		{
+			matchmaking_on_found(&ctx->matchmaking);
+			set_matchmaking_ticking(ctx, 0);
+			if (cur_term_window_type == term_window_type_MATCHMAKING)
+			{
+				update_matchmaking_labels(ctx);
+				crefresh(0);
 			}
 		}
 	}
+	// a join refused, or a match whose game couldn't be started
+	else if (!strcmp(data.type, "matchmaking:error"))
+	{
+		if (ctx->matchmaking.status == matchmaking_status_JOINING
+			|| ctx->matchmaking.status == matchmaking_status_MATCHED)
+		{
+			matchmaking_leave(&ctx->matchmaking);
+			set_matchmaking_ticking(ctx, 0);
+			if (cur_term_window_type == term_window_type_MATCHMAKING)
+			{
+				label_copy_text(ctx->matchmaking_view.error, get_ws_message(data.json));
+				update_matchmaking_labels(ctx);
+				crefresh(0);
+			}
+		}
+	}
+	else
+		receive_chat_message(ctx, &data);
 	if (delete_json)
 		cJSON_Delete(data.json);
 }
@@ -669,7 +1092,7 @@ static int fetch_param(int *ac, char ***av, char *arg, char **param)
 	return (0);
 }
 
-static int parse_args(int ac, char **av, char **backend_url, char **ws_url)
+static int parse_args(int ac, char **av, char **backend_url, char **ws_url, int *verbose, char **trace_path)
 {
 	*backend_url = "https://localhost:8443/";
 	*ws_url = "wss://localhost:8443/ws";
@@ -697,6 +1120,18 @@ static int parse_args(int ac, char **av, char **backend_url, char **ws_url)
 					return (0);
 				*ws_url = param;
 				break;
+			case 'v':
+				*verbose = 1;
+				break;
+			case 't':
+				if (!fetch_param(&ac, &av, arg, &param))
+					return (0);
+				*trace_path = param;
+				break;
+			case 'u':
+				// falls back to epoll when io_uring isn't available
+				event_loop_default_backend = event_loop_backend_IO_URING;
+				break;
 			default:
 				fprintf(stderr, "Unknown argument `%s`\n", arg);
 				return (0);
@@ -708,23 +1143,38 @@ static int parse_args(int ac, char **av, char **backend_url, char **ws_url)
 int main(int ac, char **av)
 {
 	ctx *ctx = &g_ctx;
-	char *backend_url, *ws_url;
-	if (!parse_args(ac, av, &backend_url, &ws_url))
+	char *backend_url, *ws_url, *trace_path = NULL;
+	if (!parse_args(ac, av, &backend_url, &ws_url, &ctx->verbose, &trace_path))
 		return (EXIT_FAILURE);
+	if (trace_path && !trace_init(trace_path))
+		dprintf(STDERR_FILENO, "unable to allocate the trace ring, tracing disabled\n");
 	if (!ctx_init(ctx, backend_url, ws_url))
 	{
 		dprintf(STDERR_FILENO, "ctx_init fail\n");
 		return (EXIT_FAILURE);
 	}
+	// the REST probe and the websocket handshake keep going while the terminal
+	// and the windows are set up
+	ctx_phase_begin(ctx, startup_phase_TERM_INIT);
 	cinit();
+	ctx_phase_end(ctx, startup_phase_TERM_INIT);
 
+	ctx_phase_begin(ctx, startup_phase_WINDOWS_INIT);
 	init_windows(ctx);
+	ctx_phase_end(ctx, startup_phase_WINDOWS_INIT);
+	ctx_wait_connected(ctx);
+
 	creset_window_stack();
 	cswitch_window(term_window_type_LOGIN, 1);
 
 	input_loop(ctx, on_key_event, on_sock_event);
+	// freed with the loop
+	ctx->chat_view.redraw_timer = NULL;
+	ctx->matchmaking_view.tick_timer = NULL;
 
 	ctx_deinit(&g_ctx);
 	cdeinit();
+	if (ctx->verbose)
+		ctx_print_startup_report(ctx, stderr);
 	return (EXIT_SUCCESS);
 }
@@ -0,0 +1,55 @@
+#include "matchmaking.h"
+
+void matchmaking_join(matchmaking *mm, u64 now)
+{
+	*mm = (matchmaking){
+		.status = matchmaking_status_JOINING,
+		.joined_ns = now,
+		.last_advance_ns = now,
+	};
+}
+
+void matchmaking_leave(matchmaking *mm)
+{
+	mm->status = matchmaking_status_IDLE;
+	mm->position = 0;
+	mm->total = 0;
+}
+
+int matchmaking_on_waiting(matchmaking *mm, int position, int total, u64 now)
+{
+	if (mm->status == matchmaking_status_IDLE)
+		return (0);
+	if (mm->status == matchmaking_status_QUEUED && mm->position == position && mm->total == total)
+		return (0);
+	if (mm->status == matchmaking_status_QUEUED && position < mm->position)
+	{
+		double sample = (double)(now - mm->last_advance_ns) / (mm->position - position);
+		mm->advance_ns = mm->advance_ns ? mm->advance_ns * 0.7 + sample * 0.3 : sample;
+		mm->last_advance_ns = now;
+	}
+	mm->status = matchmaking_status_QUEUED;
+	mm->position = position;
+	mm->total = total;
+	return (1);
+}
+
+void matchmaking_on_found(matchmaking *mm)
+{
+	matchmaking_leave(mm);
+	mm->status = matchmaking_status_MATCHED;
+}
+
+void matchmaking_on_start(matchmaking *mm, int plays_left)
+{
+	matchmaking_leave(mm);
+	mm->plays_left = plays_left;
+}
+
+u64 matchmaking_estimate_ns(const matchmaking *mm, u64 now)
+{
+	if (mm->status != matchmaking_status_QUEUED || !mm->advance_ns)
+		return (0);
+	double remaining = mm->advance_ns * mm->position - (double)(now - mm->last_advance_ns);
+	return (remaining > 0 ? remaining : 0);
+}
@@ -0,0 +1,174 @@
+#include "net.h"
+#include "event_loop.h"
+#include <stdint.h>
+
+static struct
+{
+	CURLM			*multi;
+	event_loop		loop;
+	event_source	*timer;
+	CURLMcode		error; // of the last curl_multi_socket_action()
+}	net_events = {0};
+
+static void net_report_done(CURLM *multi)
+{
+	CURLMsg *msg;
+	int msgs_left;
+	while ((msg = curl_multi_info_read(multi, &msgs_left)))
+	{
+		if (msg->msg != CURLMSG_DONE)
+			continue;
+		net_transfer *transfer = NULL;
+		curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&transfer);
+		// `msg` is invalidated by curl_multi_remove_handle()
+		CURLcode result = msg->data.result;
+		curl_multi_remove_handle(multi, msg->easy_handle);
+		if (!transfer)
+			continue;
+		transfer->in_flight = 0;
+		transfer->done = 1;
+		transfer->result = result;
+		if (transfer->on_done)
+			transfer->on_done(transfer, result);
+	}
+}
+
+static void net_socket_action(curl_socket_t sock, int flags)
+{
+	int running;
+	CURLMcode merr = curl_multi_socket_action(net_events.multi, sock, flags, &running);
+	if (merr && !net_events.error)
+		net_events.error = merr;
+	net_report_done(net_events.multi);
+}
+
+static void on_socket_ready(void *param, u32 events)
+{
+	int flags = 0;
+	if (events & EPOLLIN)
+		flags |= CURL_CSELECT_IN;
+	if (events & EPOLLOUT)
+		flags |= CURL_CSELECT_OUT;
+	if (events & (EPOLLERR | EPOLLHUP))
+		flags |= CURL_CSELECT_ERR;
+	net_socket_action((curl_socket_t)(intptr_t)param, flags);
+}
+
+static void on_timeout(void *param, u32 expirations)
+{
+	(void)param;
+	(void)expirations;
+	net_socket_action(CURL_SOCKET_TIMEOUT, 0);
+}
+
+static int on_curl_socket(CURL *easy, curl_socket_t sock, int what, void *userp, void *socketp)
+{
+	(void)easy;
+	(void)userp;
+	event_source *source = socketp;
+	if (what == CURL_POLL_REMOVE)
+	{
+		event_loop_remove(&net_events.loop, source);
+		return (0);
+	}
+	u32 events = ((what & CURL_POLL_IN) ? EPOLLIN : 0) | ((what & CURL_POLL_OUT) ? EPOLLOUT : 0);
+	if (source)
+		return (event_loop_modify_fd(&net_events.loop, source, events) ? 0 : -1);
+	source = event_loop_add_fd(&net_events.loop, sock, events, on_socket_ready, (void *)(intptr_t)sock);
+	if (!source)
+		return (-1);
+	curl_multi_assign(net_events.multi, sock, source);
+	return (0);
+}
+
+static int on_curl_timer(CURLM *multi, long timeout_ms, void *userp)
+{
+	(void)multi;
+	(void)userp;
+	if (timeout_ms < 0)
+		event_loop_set_timer(net_events.timer, 0, 0);
+	else // a delay of 0 would disarm the timer
+		event_loop_set_timer(net_events.timer, timeout_ms ? timeout_ms * 1000000ull : 1, 0);
+	return (0);
+}
+
+int net_multi_init(CURLM *multi)
+{
+	// nested in the other loops, see event_loop_fd()
+	if (!event_loop_init_backend(&net_events.loop, event_loop_backend_EPOLL))
+		return (0);
+	net_events.timer = event_loop_add_timer(&net_events.loop, 0, 0, on_timeout, NULL);
+	if (!net_events.timer)
+	{
+		event_loop_deinit(&net_events.loop);
+		return (0);
+	}
+	net_events.multi = multi;
+	curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, on_curl_socket);
+	curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, on_curl_timer);
+	return (1);
+}
+
+void net_multi_deinit()
+{
+	event_loop_deinit(&net_events.loop);
+	net_events.multi = NULL;
+	net_events.timer = NULL;
+}
+
+int net_multi_fd()
+{
+	return (event_loop_fd(&net_events.loop));
+}
+
+static CURLMcode net_multi_run(int timeout_ms)
+{
+	if (event_loop_run_once(&net_events.loop, timeout_ms) < 0)
+		return (CURLM_INTERNAL_ERROR);
+	CURLMcode merr = net_events.error;
+	net_events.error = CURLM_OK;
+	return (merr);
+}
+
+int net_transfer_start(CURLM *multi, net_transfer *transfer)
+{
+	transfer->done = 0;
+	transfer->result = CURLE_OK;
+	curl_easy_setopt(transfer->curl, CURLOPT_PRIVATE, transfer);
+	if (curl_multi_add_handle(multi, transfer->curl))
+		return (0);
+	transfer->in_flight = 1;
+	return (1);
+}
+
+void net_transfer_abort(CURLM *multi, net_transfer *transfer)
+{
+	if (transfer->in_flight)
+	{
+		curl_multi_remove_handle(multi, transfer->curl);
+		transfer->in_flight = 0;
+	}
+}
+
+CURLMcode net_multi_dispatch(CURLM *multi)
+{
+	(void)multi;
+	return (net_multi_run(0));
+}
+
+CURLcode net_transfer_wait(CURLM *multi, net_transfer *transfer)
+{
+	while (!transfer->done)
+	{
+		if (!transfer->in_flight)
+			return (CURLE_FAILED_INIT);
+		// curl's own timer wakes the loop, the timeout is only a safety net
+		CURLMcode merr = net_multi_run(1000);
+		if (merr)
+		{
+			net_transfer_abort(multi, transfer);
+			return (CURLE_RECV_ERROR);
+		}
+	}
+	return (transfer->result);
+}
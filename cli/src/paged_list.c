@@ -0,0 +1,267 @@
+#include "paged_list.h"
+#include "soft_fail.h"
+#include <string.h>
+#include <stdlib.h>
+
+static size_t paged_list_writer(char *data, size_t size, size_t nmemb, void *clientp)
+{
+	size_t realsize = size * nmemb;
+	paged_list *list = clientp;
+
+	size_t needed = list->fetch_buf_cursor + realsize + 1;
+	if (needed > PAGED_LIST_MAX_PAGE_BYTES)
+		return (CURL_WRITEFUNC_ERROR);
+	// a page of the real tournament history is about 3 KB per element
+	if (needed > list->fetch_buf_cap)
+	{
+		size_t cap = list->fetch_buf_cap ? list->fetch_buf_cap : JSON_BUFFER_SIZE;
+		while (cap < needed)
+			cap *= 2;
+		list->fetch_buf = xrealloc(list->fetch_buf, cap);
+		list->fetch_buf_cap = cap;
+	}
+	memcpy(&list->fetch_buf[list->fetch_buf_cursor], data, realsize);
+	list->fetch_buf_cursor += realsize;
+	list->fetch_buf[list->fetch_buf_cursor] = 0;
+	return (realsize);
+}
+
+static i64 *page_count_ptr(paged_list *list, void *obj)
+{
+	return ((i64 *)((u8 *)obj + list->array_offset));
+}
+
+static void **page_arr_ptr(paged_list *list, void *obj)
+{
+	return ((void **)((u8 *)obj + list->array_offset + sizeof(i64)));
+}
+
+static void slot_free(paged_list *list, paged_list_slot *slot)
+{
+	if (slot->obj)
+	{
+		json_clean_obj(slot->obj, list->def);
+		free(slot->obj);
+		slot->obj = NULL;
+	}
+	slot->page = -1;
+}
+
+static paged_list_slot *find_slot(paged_list *list, i64 page)
+{
+	for (int i = 0; i < PAGED_LIST_WINDOW; i++)
+		if (list->slots[i].page == page)
+			return (&list->slots[i]);
+	return (NULL);
+}
+
+static paged_list_slot *evict_slot(paged_list *list)
+{
+	paged_list_slot *victim = NULL;
+	for (int i = 0; i < PAGED_LIST_WINDOW; i++)
+	{
+		paged_list_slot *slot = &list->slots[i];
+		if (slot->page == -1)
+			return (slot);
+		if (slot->page == list->pinned_page)
+			continue;
+		if (!victim || slot->last_use < victim->last_use)
+			victim = slot;
+	}
+	slot_free(list, victim);
+	return (victim);
+}
+
+static int start_fetch(paged_list *list, i64 page);
+
+static void on_fetch_done(net_transfer *transfer, CURLcode result)
+{
+	paged_list *list = transfer->param;
+	int is_demand = list->fetch_is_demand;
+	curl_easy_cleanup(transfer->curl);
+	transfer->curl = NULL;
+	list->fetch_is_demand = 0;
+	void *obj = NULL;
+	if (!result && list->fetch_buf)
+	{
+		// the page points into the body, which it now owns
+		obj = xcalloc(1, list->obj_size);
+		json_content_error err = json_parse_buffer_from_def(list->fetch_buf, list->fetch_buf_cursor, list->def, obj);
+		list->fetch_buf = NULL;
+		list->fetch_buf_cap = 0;
+		// a page that failed to parse was cleaned by the parser, arrays included
+		if (err.kind)
+		{
+			free(obj);
+			obj = NULL;
+		}
+	}
+	if (!obj)
+	{
+		// a failed prefetch is asked for again once the page is needed
+		if (is_demand)
+			clean_and_fail("%s: page %lld fetch fail: %s\n", list->endpoint, (long long)list->fetch_page,
+				result ? curl_easy_strerror(result) : "invalid page");
+		return ;
+	}
+
+	i64 count = *page_count_ptr(list, obj);
+	i64 end = list->fetch_page * list->page_size + count;
+	if (count < list->page_size)
+	{
+		list->end_reached = 1;
+		list->known_count = end;
+	}
+	else if (end > list->known_count)
+		list->known_count = end;
+
+	paged_list_slot *slot = evict_slot(list);
+	slot->page = list->fetch_page;
+	slot->obj = obj;
+	slot->last_use = ++list->use_tick;
+
+	i64 wanted = list->wanted_page;
+	list->wanted_page = -1;
+	if (wanted != -1 && !find_slot(list, wanted) && start_fetch(list, wanted))
+		list->fetch_is_demand = 1;
+	if ((is_demand || wanted != -1) && list->on_loaded)
+		list->on_loaded(list->on_loaded_param);
+}
+
+static int start_fetch(paged_list *list, i64 page)
+{
+	CURL *easy = curl_easy_duphandle(list->api->curl); // same headers, share and options
+	if (!easy)
+		return (0);
+	snprintf(list->url_buf, sizeof(list->url_buf), "%.*s%s?page=%lld&limit=%lld",
+		(int)list->api->api_url_base_len, list->api->api_url_buf, list->endpoint,
+		(long long)page + 1, (long long)list->page_size);
+	curl_easy_setopt(easy, CURLOPT_URL, list->url_buf);
+	curl_easy_setopt(easy, CURLOPT_HTTPGET, 1L);
+	curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, paged_list_writer);
+	curl_easy_setopt(easy, CURLOPT_WRITEDATA, (void *)list);
+	list->fetch_buf_cursor = 0;
+	list->fetch_page = page;
+	list->fetch.curl = easy;
+	if (!net_transfer_start(list->api->multi, &list->fetch))
+	{
+		curl_easy_cleanup(easy);
+		list->fetch.curl = NULL;
+		return (0);
+	}
+	return (1);
+}
+
+static void cancel_fetch(paged_list *list)
+{
+	if (list->fetch.in_flight)
+	{
+		net_transfer_abort(list->api->multi, &list->fetch);
+		curl_easy_cleanup(list->fetch.curl);
+		list->fetch.curl = NULL;
+	}
+	list->fetch_is_demand = 0;
+	list->wanted_page = -1;
+}
+
+// a prefetch of another page is dropped for the missed one, a demand of another
+// page is let finish and the missed page is fetched right after it
+static void demand(paged_list *list, i64 page)
+{
+	if (list->fetch.in_flight && list->fetch_page == page)
+	{
+		list->fetch_is_demand = 1;
+		return ;
+	}
+	if (list->fetch.in_flight && list->fetch_is_demand)
+	{
+		list->wanted_page = page;
+		return ;
+	}
+	cancel_fetch(list);
+	if (!start_fetch(list, page))
+		clean_and_fail("%s: unable to start page fetch\n", list->endpoint);
+	list->fetch_is_demand = 1;
+}
+
+static void prefetch(paged_list *list, i64 page)
+{
+	if (page < 0 || list->fetch.in_flight || find_slot(list, page))
+		return ;
+	if (list->end_reached && page * list->page_size >= list->known_count)
+		return ;
+	start_fetch(list, page);
+}
+
+void paged_list_init(paged_list *list, api_ctx *api, const char *endpoint, json_def *def,
+	size_t obj_size, size_t array_offset, size_t elem_size, i64 page_size)
+{
+	memset(list, 0, sizeof(*list));
+	list->api = api;
+	list->endpoint = endpoint;
+	list->def = def;
+	list->obj_size = obj_size;
+	list->array_offset = array_offset;
+	list->elem_size = elem_size;
+	list->page_size = page_size;
+	list->fetch.on_done = on_fetch_done;
+	list->fetch.param = list;
+	list->wanted_page = -1;
+	for (int i = 0; i < PAGED_LIST_WINDOW; i++)
+		list->slots[i].page = -1;
+	list->pinned_page = -1;
+}
+
+void paged_list_reset(paged_list *list)
+{
+	cancel_fetch(list);
+	for (int i = 0; i < PAGED_LIST_WINDOW; i++)
+		slot_free(list, &list->slots[i]);
+	list->pinned_page = -1;
+	list->known_count = 0;
+	list->end_reached = 0;
+}
+
+void paged_list_deinit(paged_list *list)
+{
+	if (list->api)
+		paged_list_reset(list);
+	free(list->fetch_buf);
+	list->fetch_buf = NULL;
+	list->fetch_buf_cap = 0;
+}
+
+int paged_list_may_have(void *source, i64 index)
+{
+	paged_list *list = source;
+	return (index >= 0 && (index < list->known_count || !list->end_reached));
+}
+
+void *paged_list_get(void *source, i64 index)
+{
+	paged_list *list = source;
+	if (!paged_list_may_have(list, index))
+		return (NULL);
+	i64 page = index / list->page_size;
+	paged_list_slot *slot = find_slot(list, page);
+	if (!slot)
+	{
+		demand(list, page);
+		return (NULL);
+	}
+	slot->last_use = ++list->use_tick;
+	i64 offset = index % list->page_size;
+	if (offset >= *page_count_ptr(list, slot->obj))
+		return (NULL);
+	list->pinned_page = page;
+	if (offset >= list->page_size - PAGED_LIST_PREFETCH_DISTANCE)
+		prefetch(list, page + 1);
+	else if (offset < PAGED_LIST_PREFETCH_DISTANCE)
+		prefetch(list, page - 1);
+	return ((u8 *)*page_arr_ptr(list, slot->obj) + offset * list->elem_size);
+}
+
+int paged_list_is_loading(const paged_list *list)
+{
+	return (list->fetch_is_demand || list->wanted_page != -1);
+}
@@ -0,0 +1,105 @@
+#include "pong_render.h"
+#include "term.h"
+#include "config.h"
+#include "trace.h"
+#include <math.h>
+#include <stdio.h>
+
+const char *const pong_glyphs[pong_glyph__MAX] = {
+	[pong_glyph_PADDLE] = "\u2503",
+	[pong_glyph_PADDLE_TOP] = "\u257B",
+	[pong_glyph_PADDLE_BOTTOM] = "\u2579",
+	[pong_glyph_BALL] = "\u2588",
+};
+
+static void rasterize_paddle(int x, float y, float height, frame_detail detail, pong_plot_func *plot, void *param)
+{
+	float integral, fractional;
+	
+	float paddle_start = y - height / 2;
+	float paddle_end = y + height / 2;
+	fractional = modff(paddle_start, &integral);
+	if (detail == frame_detail_FULL && fractional < 0.45)
+		plot(param, x, (int)paddle_start - 1, pong_glyph_PADDLE_TOP);
+	int pos = paddle_start;
+	int paddle_end_int = paddle_end;
+	while (pos < paddle_end_int)
+		plot(param, x, pos++, pong_glyph_PADDLE);
+	fractional = modff(paddle_end, &integral);
+	if (detail == frame_detail_FULL && fractional > 0.55)
+		plot(param, x, paddle_end_int, pong_glyph_PADDLE_BOTTOM);
+}
+
+void pong_layout_update(pong_layout *layout, u16 width, u16 height)
+{
+	if (layout->width == width && layout->height == height)
+		return ;
+	layout->width = width;
+	layout->height = height;
+	layout->height_ratio = height / (float)ARENA_HEIGHT;
+	layout->width_ratio = width / (float)ARENA_WIDTH;
+	layout->paddle_height = PADDLE_HEIGHT * layout->height_ratio;
+
+	const float ball_width = BALL_SIZE * layout->width_ratio;
+	const float ball_height = BALL_SIZE * layout->height_ratio;
+	layout->ball_cells = 0;
+	for (int y = -(int)ball_height; y <= (int)ball_height; y++)
+	{
+		for (int x = -(int)ball_width; x <= (int)ball_width; x++)
+		{
+			float dist = (x * x) / (ball_width * ball_width) + (y * y) / (ball_height * ball_height);
+			if (dist <= 1 && layout->ball_cells < BALL_SPRITE_MAX_CELLS)
+			{
+				layout->ball[layout->ball_cells][0] = x;
+				layout->ball[layout->ball_cells][1] = y;
+				layout->ball_cells++;
+			}
+		}
+	}
+}
+
+void pong_rasterize(const pong_layout *layout, const game_state *state, frame_detail detail,
+	pong_plot_func *plot, void *param)
+{
+	const float height_ratio = layout->height_ratio;
+	const float width_ratio = layout->width_ratio;
+
+	rasterize_paddle(1, state->gameState.leftPaddleY * height_ratio, layout->paddle_height, detail, plot, param);
+	rasterize_paddle(layout->width - 1, state->gameState.rightPaddleY * height_ratio, layout->paddle_height, detail, plot, param);
+	int center_x = state->gameState.ballX * width_ratio;
+	int center_y = state->gameState.ballY * height_ratio;
+	if (detail != frame_detail_FULL)
+	{
+		plot(param, center_x, center_y, pong_glyph_BALL);
+		return ;
+	}
+	for (size_t i = 0; i < layout->ball_cells; i++)
+		plot(param, center_x + layout->ball[i][0], center_y + layout->ball[i][1], pong_glyph_BALL);
+}
+
+// straight to the terminal, the scene was cleared
+static void plot_on_screen(void *param, int x, int y, pong_glyph glyph)
+{
+	(void)param;
+	if (x < 1 || y < 1 || x > c_x || y > c_y)
+		return ;
+	cursor_goto(x, y);
+	PUTS(pong_glyphs[glyph]);
+}
+
+static pong_layout	layout = {0};
+
+void render_pong_scene(const game_state *state, frame_detail detail)
+{
+	TRACE_SCOPE("render_pong_scene");
+	cclear_screen();
+	if (c_x >= 10 && c_y >= 5)
+	{
+		pong_layout_update(&layout, c_x, c_y);
+		pong_rasterize(&layout, state, detail, plot_on_screen, NULL);
+		cursor_goto(c_x / 2 - 1, c_y - 1);
+		char score[32];
+		snprintf(score, sizeof(score), "%d/%d", state->gameState.leftScore, state->gameState.rightScore);
+		PUTS(score);
+	}
+}
@@ -0,0 +1,107 @@
+#include "pong_sim.h"
+#include "config.h"
+#include <math.h>
+#include <string.h>
+
+// splitmix64, uniform in [0, 1) like Math.random()
+static double next_random(pong_sim *sim)
+{
+	u64 z = (sim->rng += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	z ^= z >> 31;
+	return ((z >> 11) * 0x1.0p-53);
+}
+
+static void serve(pong_sim *sim)
+{
+	sim->ball_x = ARENA_WIDTH / 2.0;
+	sim->ball_y = ARENA_HEIGHT / 2.0;
+	sim->ball_vx = (next_random(sim) > 0.5 ? 1 : -1) * BALL_SPEED;
+	sim->ball_vy = (next_random(sim) - 0.5) * BALL_SPEED * 0.5;
+}
+
+void pong_sim_init(pong_sim *sim, u64 seed)
+{
+	memset(sim, 0, sizeof(*sim));
+	sim->rng = seed;
+	sim->left_paddle_y = ARENA_HEIGHT / 2.0;
+	sim->right_paddle_y = ARENA_HEIGHT / 2.0;
+	serve(sim);
+}
+
+static double move_paddle(double y, double dt, u8 input)
+{
+	if (input & pong_input_UP)
+		y -= PADDLE_SPEED * dt;
+	if (input & pong_input_DOWN)
+		y += PADDLE_SPEED * dt;
+	return (fmax(PADDLE_HEIGHT / 2.0, fmin(ARENA_HEIGHT - PADDLE_HEIGHT / 2.0, y)));
+}
+
+// in the same order as the server, which matters when several apply in a tick
+void pong_sim_update(pong_sim *sim, double dt, u8 left, u8 right)
+{
+	if (sim->winner != pong_side_NONE)
+		return ;
+	dt = fmin(dt, PONG_MAX_DT);
+	sim->ticks++;
+
+	sim->left_paddle_y = move_paddle(sim->left_paddle_y, dt, left);
+	sim->right_paddle_y = move_paddle(sim->right_paddle_y, dt, right);
+	sim->ball_x += sim->ball_vx * dt;
+	sim->ball_y += sim->ball_vy * dt;
+
+	if (sim->ball_y <= BALL_SIZE || sim->ball_y >= ARENA_HEIGHT - BALL_SIZE)
+		sim->ball_vy = -sim->ball_vy;
+
+	const double reach = PADDLE_HEIGHT / 2.0 + BALL_SIZE;
+	if (sim->ball_x <= PADDLE_WIDTH + BALL_SIZE && sim->ball_x >= 0 && sim->ball_vx < 0
+		&& fabs(sim->ball_y - sim->left_paddle_y) < reach)
+	{
+		sim->ball_vx = fabs(sim->ball_vx);
+		sim->ball_vy = (sim->ball_y - sim->left_paddle_y) * 5;
+		sim->left_hits++;
+	}
+	if (sim->ball_x >= ARENA_WIDTH - PADDLE_WIDTH - BALL_SIZE && sim->ball_x <= ARENA_WIDTH && sim->ball_vx > 0
+		&& fabs(sim->ball_y - sim->right_paddle_y) < reach)
+	{
+		sim->ball_vx = -fabs(sim->ball_vx);
+		sim->ball_vy = (sim->ball_y - sim->right_paddle_y) * 5;
+		sim->right_hits++;
+	}
+
+	if (sim->ball_x < 0)
+	{
+		sim->right_score++;
+		serve(sim);
+	}
+	else if (sim->ball_x > ARENA_WIDTH)
+	{
+		sim->left_score++;
+		serve(sim);
+	}
+
+	if (sim->left_score >= WINNING_SCORE)
+		sim->winner = pong_side_LEFT;
+	else if (sim->right_score >= WINNING_SCORE)
+		sim->winner = pong_side_RIGHT;
+}
+
+void pong_sim_step(pong_sim *sim, u8 left, u8 right)
+{
+	pong_sim_update(sim, 1.0 / PONG_TICK_HZ, left, right);
+}
+
+void pong_sim_get_state(const pong_sim *sim, game_state *out)
+{
+	out->gameState = (game_state_state){
+		.ballX = sim->ball_x,
+		.ballY = sim->ball_y,
+		.leftPaddleY = sim->left_paddle_y,
+		.rightPaddleY = sim->right_paddle_y,
+		.leftScore = sim->left_score,
+		.rightScore = sim->right_score,
+		.gameOver = sim->winner != pong_side_NONE,
+	};
+}
@@ -0,0 +1,211 @@
+#include "share.h"
+#include "types.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// curl_easy_ssls_import()/export() appeared in 8.12.0 and need curl to be
+// configured with --enable-ssls-export, otherwise CURLE_NOT_BUILT_IN is returned
+#if LIBCURL_VERSION_NUM >= 0x080c00
+# define HAS_SSLS_EXPORT 1
+#else
+# define HAS_SSLS_EXPORT 0
+#endif
+
+#define CACHE_FILE_NAME "trans_cli_tls_sessions"
+#define CACHE_MAGIC "TCTLS001"
+#define MAX_SESSION_FIELD_LEN 16384
+
+static int build_cache_path(share_ctx *ctx)
+{
+	const char *dir = getenv("XDG_CACHE_HOME");
+	int written;
+	if (dir && *dir)
+		written = snprintf(ctx->cache_path, sizeof(ctx->cache_path), "%s/" CACHE_FILE_NAME, dir);
+	else
+	{
+		dir = getenv("HOME");
+		if (!dir || !*dir)
+			return (0);
+		written = snprintf(ctx->cache_path, sizeof(ctx->cache_path), "%s/.cache/" CACHE_FILE_NAME, dir);
+	}
+	return (written > 0 && (size_t)written < sizeof(ctx->cache_path));
+}
+
+// the handles are used from the main and the websocket threads
+static void share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *param)
+{
+	(void)handle;
+	(void)access;
+	pthread_mutex_lock(&((share_ctx *)param)->locks[data]);
+}
+
+static void share_unlock(CURL *handle, curl_lock_data data, void *param)
+{
+	(void)handle;
+	pthread_mutex_unlock(&((share_ctx *)param)->locks[data]);
+}
+
+int share_ctx_init(share_ctx *ctx)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->share = curl_share_init();
+	if (!ctx->share)
+	{
+		fprintf(stderr, "curl_share_init() fail\n");
+		return (0);
+	}
+	for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+		pthread_mutex_init(&ctx->locks[i], NULL);
+	curl_share_setopt(ctx->share, CURLSHOPT_LOCKFUNC, share_lock);
+	curl_share_setopt(ctx->share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+	curl_share_setopt(ctx->share, CURLSHOPT_USERDATA, ctx);
+	curl_share_setopt(ctx->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(ctx->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	// not the connections: curl doesn't support sharing them between threads,
+	// even with the locks. the REST handles reuse theirs through the multi handle
+	ctx->can_persist = HAS_SSLS_EXPORT && build_cache_path(ctx);
+	return (1);
+}
+
+#if HAS_SSLS_EXPORT
+
+static int read_field(FILE *file, unsigned char *buf, u32 *len)
+{
+	if (fread(len, sizeof(*len), 1, file) != 1 || *len > MAX_SESSION_FIELD_LEN)
+		return (0);
+	return (fread(buf, 1, *len, file) == *len);
+}
+
+void share_ctx_load_sessions(share_ctx *ctx, CURL *easy)
+{
+	if (!ctx->can_persist)
+		return ;
+	FILE *file = fopen(ctx->cache_path, "rb");
+	if (!file)
+		return ;
+	char magic[sizeof(CACHE_MAGIC) - 1];
+	if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, CACHE_MAGIC, sizeof(magic)))
+	{
+		fclose(file);
+		return ;
+	}
+	static unsigned char shmac[MAX_SESSION_FIELD_LEN];
+	static unsigned char sdata[MAX_SESSION_FIELD_LEN];
+	u32 shmac_len, sdata_len;
+	i64 valid_until;
+	i64 now = time(NULL);
+	while (fread(&valid_until, sizeof(valid_until), 1, file) == 1
+		&& read_field(file, shmac, &shmac_len)
+		&& read_field(file, sdata, &sdata_len))
+	{
+		if (valid_until && valid_until <= now)
+			continue;
+		if (curl_easy_ssls_import(easy, NULL, shmac, shmac_len, sdata, sdata_len) == CURLE_NOT_BUILT_IN)
+		{
+			ctx->can_persist = 0;
+			break;
+		}
+	}
+	fclose(file);
+}
+
+static CURLcode export_session(CURL *handle, void *userptr,
+	const char *session_key,
+	const unsigned char *shmac, size_t shmac_len,
+	const unsigned char *sdata, size_t sdata_len,
+	curl_off_t valid_until, int ietf_tls_id, const char *alpn, size_t earlydata_max)
+{
+	(void)handle, (void)session_key, (void)ietf_tls_id, (void)alpn, (void)earlydata_max;
+	FILE *file = userptr;
+	if (!shmac || shmac_len > MAX_SESSION_FIELD_LEN || sdata_len > MAX_SESSION_FIELD_LEN)
+		return (CURLE_OK); // not importable later, skip it
+	i64 until = valid_until;
+	u32 len;
+	fwrite(&until, sizeof(until), 1, file);
+	len = shmac_len;
+	fwrite(&len, sizeof(len), 1, file);
+	fwrite(shmac, 1, shmac_len, file);
+	len = sdata_len;
+	fwrite(&len, sizeof(len), 1, file);
+	fwrite(sdata, 1, sdata_len, file);
+	return (CURLE_OK);
+}
+
+// the directories of the cache path, like `mkdir -p`
+static int make_cache_dirs(const char *cache_path)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s", cache_path);
+	for (char *slash = strchr(path + 1, '/'); slash; slash = strchr(slash + 1, '/'))
+	{
+		*slash = '\0';
+		if (mkdir(path, 0700) && errno != EEXIST)
+			return (0);
+		*slash = '/';
+	}
+	return (1);
+}
+
+// the sessions can be resumed by whoever reads them, only the user can
+static FILE *open_private(const char *path)
+{
+	int fd = open(path, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return (NULL);
+	// a file left by an older version may have other permissions
+	FILE *file = fchmod(fd, 0600) ? NULL : fdopen(fd, "wb");
+	if (!file)
+		close(fd);
+	return (file);
+}
+
+void share_ctx_save_sessions(share_ctx *ctx, CURL *easy)
+{
+	if (!ctx->can_persist || !easy || !make_cache_dirs(ctx->cache_path))
+		return ;
+	// written next to the cache and renamed so a crash never leaves a truncated cache
+	char tmp_path[PATH_MAX + 4];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", ctx->cache_path);
+	FILE *file = open_private(tmp_path);
+	if (!file)
+		return ;
+	fwrite(CACHE_MAGIC, sizeof(CACHE_MAGIC) - 1, 1, file);
+	CURLcode err = curl_easy_ssls_export(easy, export_session, file);
+	if (fclose(file) || err)
+	{
+		remove(tmp_path);
+		return ;
+	}
+	rename(tmp_path, ctx->cache_path);
+}
+
+#else
+
+void share_ctx_load_sessions(share_ctx *ctx, CURL *easy)
+{
+	(void)ctx, (void)easy;
+}
+
+void share_ctx_save_sessions(share_ctx *ctx, CURL *easy)
+{
+	(void)ctx, (void)easy;
+}
+
+#endif
+
+void share_ctx_deinit(share_ctx *ctx)
+{
+	if (ctx->share)
+	{
+		curl_share_cleanup(ctx->share);
+		ctx->share = NULL;
+		for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+			pthread_mutex_destroy(&ctx->locks[i]);
+	}
+}
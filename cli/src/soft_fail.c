@@ -19,6 +19,14 @@ void *xcalloc(size_t nmemb, size_t size)
 	return (ptr);
 }
 
+void *xrealloc(void *ptr, size_t n)
+{
+	void *new_ptr = realloc(ptr, n);
+	if (!new_ptr)
+		DO_CLEANUP(fprintf(stderr, "FATAL: realloc(): unable to allocate chunk of size %zu\n", n));
+	return (new_ptr);
+}
+
 char *xstrdup(const char *str)
 {
 	char *copy = strdup(str);
@@ -0,0 +1,215 @@
+#include "spectator_render.h"
+#include "soft_fail.h"
+#include "term.h"
+#include "trace.h"
+#include <stdio.h>
+#include <string.h>
+
+// cells from GLYPH_BASE are not ascii, the pong glyphs come first
+#define GLYPH_BASE 0x80
+#define CELL_EMPTY ' '
+#define CELL_HLINE (GLYPH_BASE + pong_glyph__MAX)
+#define CELL_VLINE (GLYPH_BASE + pong_glyph__MAX + 1)
+
+static const char *const line_glyphs[] = {"\u2500", "\u2502"};
+
+// the arena is not drawn in tiles smaller than this, like in render_pong_scene()
+#define MIN_ARENA_W 10
+#define MIN_ARENA_H 5
+
+void spectator_init(spectator_view *view)
+{
+	memset(view, 0, sizeof(*view));
+	view->needs_layout = 1;
+}
+
+void spectator_deinit(spectator_view *view)
+{
+	free(view->cells);
+	free(view->shown);
+	memset(view, 0, sizeof(*view));
+}
+
+int spectator_add_game(spectator_view *view)
+{
+	if (view->games_count >= SPECTATOR_MAX_GAMES)
+		return (-1);
+	view->games[view->games_count] = (spectator_game){0};
+	view->needs_layout = 1;
+	return (view->games_count++);
+}
+
+void spectator_remove_game(spectator_view *view, size_t index)
+{
+	if (index >= view->games_count)
+		return ;
+	view->games[index] = view->games[--view->games_count];
+	view->needs_layout = 1;
+}
+
+void spectator_set_state(spectator_view *view, size_t index, const game_state *state)
+{
+	if (index >= view->games_count)
+		return ;
+	spectator_game *game = &view->games[index];
+	// most states of a paused or finished game are the same as the previous one
+	if (game->has_state && !memcmp(&game->state, state, sizeof(*state)))
+		return ;
+	game->state = *state;
+	game->has_state = 1;
+	game->is_dirty = 1;
+}
+
+int spectator_update(spectator_view *view, size_t index, cJSON *json)
+{
+	game_state state;
+	if (json_parse_from_def(json, game_state_def, &state).kind)
+		return (0);
+	spectator_set_state(view, index, &state);
+	return (1);
+}
+
+static void put_cell(spectator_cell cell)
+{
+	if (cell < GLYPH_BASE)
+		PUTC(cell);
+	else if (cell < CELL_HLINE)
+		PUTS(pong_glyphs[cell - GLYPH_BASE]);
+	else
+		PUTS(line_glyphs[cell - CELL_HLINE]);
+}
+
+// as many columns as rows, the last row may not be full
+static void layout_tiles(spectator_view *view)
+{
+	u16 columns = 1;
+	while (columns * columns < view->games_count)
+		columns++;
+	u16 rows = view->games_count ? (view->games_count + columns - 1) / columns : 1;
+	view->columns = columns;
+	view->tile_w = c_x / columns;
+	view->tile_h = c_y / rows;
+	if (view->tile_w >= MIN_ARENA_W + 1 && view->tile_h >= MIN_ARENA_H + 1)
+		pong_layout_update(&view->arena, view->tile_w - 1, view->tile_h - 1);
+	// a tile that moved or disappeared leaves cells behind
+	memset(view->cells, CELL_EMPTY, (size_t)c_x * c_y);
+	for (size_t i = 0; i < view->games_count; i++)
+		view->games[i].is_dirty = 1;
+	view->needs_layout = 0;
+}
+
+typedef struct
+{
+	spectator_view	*view;
+	int				x; // of the arena's top left cell
+	int				y;
+}	tile_plot;
+
+static void plot_in_tile(void *param, int x, int y, pong_glyph glyph)
+{
+	tile_plot *tile = param;
+	if (x < 1 || y < 1 || x > tile->view->arena.width || y > tile->view->arena.height)
+		return ;
+	tile->view->cells[(size_t)(tile->y + y - 2) * c_x + tile->x + x - 2] = GLYPH_BASE + glyph;
+}
+
+// a header with the score above the arena, and a separator on its right
+static void draw_tile(spectator_view *view, size_t index, u16 x0, u16 y0)
+{
+	const spectator_game *game = &view->games[index];
+	const u16 w = view->tile_w;
+	const u16 h = view->tile_h;
+	for (u16 y = 0; y < h; y++)
+	{
+		spectator_cell *row = &view->cells[(size_t)(y0 + y - 1) * c_x + x0 - 1];
+		memset(row, y ? CELL_EMPTY : CELL_HLINE, w - 1);
+		row[w - 1] = CELL_VLINE;
+	}
+	char header[32];
+	int len = game->has_state
+		? snprintf(header, sizeof(header), " %d/%d ", game->state.gameState.leftScore, game->state.gameState.rightScore)
+		: snprintf(header, sizeof(header), " ... ");
+	if (len > 0 && len < w - 1)
+		memcpy(&view->cells[(size_t)(y0 - 1) * c_x + x0 - 1 + (w - 1 - len) / 2], header, len);
+	if (!game->has_state || w < MIN_ARENA_W + 1 || h < MIN_ARENA_H + 1)
+		return ;
+	tile_plot tile = {.view = view, .x = x0, .y = y0 + 1};
+	pong_rasterize(&view->arena, &game->state, view->detail, plot_in_tile, &tile);
+}
+
+static void send_rect(spectator_view *view, u16 x0, u16 y0, u16 w, u16 h)
+{
+	for (u16 y = y0; y < y0 + h; y++)
+	{
+		size_t row = (size_t)(y - 1) * c_x;
+		for (u16 x = x0; x < x0 + w; x++)
+		{
+			spectator_cell cell = view->cells[row + x - 1];
+			if (cell == view->shown[row + x - 1])
+				continue;
+			cursor_goto(x, y);
+			put_cell(cell);
+			view->shown[row + x - 1] = cell;
+		}
+	}
+}
+
+void spectator_draw(spectator_view *view, frame_detail detail)
+{
+	TRACE_SCOPE("spectator_draw");
+	if (!c_x || !c_y)
+		return ;
+	if (view->c_x != c_x || view->c_y != c_y)
+	{
+		free(view->cells);
+		free(view->shown);
+		view->cells = xmalloc((size_t)c_x * c_y);
+		view->shown = xmalloc((size_t)c_x * c_y);
+		view->c_x = c_x;
+		view->c_y = c_y;
+		view->is_shown_known = 0;
+		view->needs_layout = 1;
+	}
+	int send_all = view->needs_layout;
+	if (view->needs_layout)
+		layout_tiles(view);
+	if (!view->is_shown_known)
+	{
+		cclear_screen();
+		memset(view->shown, CELL_EMPTY, (size_t)c_x * c_y);
+		view->is_shown_known = 1;
+	}
+	if (view->detail != detail)
+	{
+		view->detail = detail;
+		for (size_t i = 0; i < view->games_count; i++)
+			view->games[i].is_dirty = 1;
+	}
+	for (size_t i = 0; i < view->games_count; i++)
+	{
+		spectator_game *game = &view->games[i];
+		if (!game->is_dirty || !view->tile_w || !view->tile_h)
+			continue;
+		u16 x0 = 1 + (i % view->columns) * view->tile_w;
+		u16 y0 = 1 + (i / view->columns) * view->tile_h;
+		draw_tile(view, i, x0, y0);
+		if (!send_all)
+			send_rect(view, x0, y0, view->tile_w, view->tile_h);
+		game->is_dirty = 0;
+	}
+	if (send_all)
+		send_rect(view, 1, 1, c_x, c_y);
+}
+
+// the governor drops a frame that waits behind another, but each frame here
+// only holds the cells changed since the previous one, so it can't be dropped
+int spectator_frame(spectator_view *view, frame_governor *gov)
+{
+	if (frame_governor_pump(gov) || !frame_governor_should_render(gov))
+		return (0);
+	TRACE_SCOPE("spectator_frame");
+	frame_governor_frame_begin(gov);
+	spectator_draw(view, gov->detail);
+	frame_governor_frame_end(gov);
+	return (1);
+}
@@ -0,0 +1,63 @@
+#include "spsc_ring.h"
+#include <stdlib.h>
+#include <string.h>
+
+int spsc_ring_init(spsc_ring *ring, size_t capacity, size_t elem_size)
+{
+	memset(ring, 0, sizeof(*ring));
+	if (!capacity || (capacity & (capacity - 1)))
+		return (0);
+	ring->slots = malloc(capacity * elem_size);
+	if (!ring->slots)
+		return (0);
+	ring->mask = capacity - 1;
+	ring->elem_size = elem_size;
+	return (1);
+}
+
+void spsc_ring_deinit(spsc_ring *ring)
+{
+	free(ring->slots);
+	ring->slots = NULL;
+}
+
+int spsc_ring_push(spsc_ring *ring, const void *elem)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	if (tail - ring->cached_head > ring->mask)
+	{
+		// only reload the consumer's index when the cached one says full
+		ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+		if (tail - ring->cached_head > ring->mask)
+			return (0);
+	}
+	memcpy(ring->slots + (tail & ring->mask) * ring->elem_size, elem, ring->elem_size);
+	atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+	return (1);
+}
+
+int spsc_ring_pop(spsc_ring *ring, void *elem)
+{
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	if (head == ring->cached_tail)
+	{
+		ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+		if (head == ring->cached_tail)
+			return (0);
+	}
+	memcpy(elem, ring->slots + (head & ring->mask) * ring->elem_size, ring->elem_size);
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+	return (1);
+}
+
+int spsc_ring_is_empty(spsc_ring *ring)
+{
+	return (atomic_load_explicit(&ring->head, memory_order_acquire)
+		== atomic_load_explicit(&ring->tail, memory_order_acquire));
+}
+
+int spsc_ring_is_full(spsc_ring *ring)
+{
+	return (atomic_load_explicit(&ring->tail, memory_order_acquire)
+		- atomic_load_explicit(&ring->head, memory_order_acquire) > ring->mask);
+}
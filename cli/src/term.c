@@ -1,4 +1,6 @@
 #include "term.h"
+#include "trace.h"
+#include "soft_fail.h"
 #include <X11/keysym.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,17 +8,22 @@
 #include <sys/ioctl.h>
 #include <termios.h>
 #include <signal.h>
+#include <sys/signalfd.h>
 #include <unistd.h>
 #include <assert.h>
 
 u16 				c_y = 0;
 u16 				c_x = 0;
 float				c_pixel_ratio = 1;
+FILE				*c_out = NULL;
 term_window			term_windows[term_window_type__MAX] = {0};
+static const window_layout	*window_layouts = NULL;
 term_window			*cur_term_window = NULL;
 term_window_type	cur_term_window_type;
 
 static int has_initiated = 0;
+static int resize_fd = -1;
+static int pixel_size_query_pending = 0;
 static struct termios orig_termios;
 static struct 
 {
@@ -30,27 +37,49 @@ static void fetch_term_sz()
 	ioctl(STDIN_FILENO, TIOCGWINSZ, &wz);
 	c_x = wz.ws_col;
 	c_y = wz.ws_row;
+}
 
-	// this escape sequence allows to fetch the size in pixels of the terminal. the
-	// return format is '\e[4;{y};{x}t'
-	PUTS("\e[14t");
-	fflush(stdout);
+// SIGWINCH stays blocked and is read from a signalfd, so that resizes are
+// handled by the main loop between two frames rather than in a handler
+static void resize_init()
+{
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGWINCH);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+	resize_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+}
 
-	u32 pixel_x, pixel_y;
-	if (scanf("\e[4;%u;%ut", &pixel_y, &pixel_x) != 2 || !pixel_x || !pixel_y)
-		c_pixel_ratio = 7.0 / 21.0; // most common ratio for terminals
-	else
-	{
-		int sz_tile_x = pixel_x / c_x;
-		int sz_tile_y = pixel_y / c_y;
-		c_pixel_ratio = (float)sz_tile_x / sz_tile_y;
-	}
+static void resize_deinit()
+{
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGWINCH);
+	if (resize_fd >= 0)
+		close(resize_fd);
+	resize_fd = -1;
+	sigprocmask(SIG_UNBLOCK, &mask, NULL);
 }
 
-static void winch(int sig)
+int cresize_fd()
 {
-	(void)sig;
+	return (resize_fd);
+}
+
+int chandle_resize()
+{
+	struct signalfd_siginfo info;
+	int resized = 0;
+	while (resize_fd >= 0 && read(resize_fd, &info, sizeof(info)) == sizeof(info))
+		resized = 1;
+	if (!resized)
+		return (0);
 	fetch_term_sz();
+	// the terminal may have moved the cursor while reflowing
+	c_out_state.cursor_known = 0;
+	// sent with the next refresh, never in the middle of a game frame
+	pixel_size_query_pending = 1;
+	return (1);
 }
 
 static void cinit_window(term_window_type window_type);
@@ -66,12 +95,15 @@ void cinit()
 	raw_info = orig_termios;
 	cfmakeraw(&raw_info);
 	tcsetattr(STDIN_FILENO, TCSANOW,&raw_info);
+	c_out = stdout;
 
-	PUTS(ESC_DISABLE_CURSOR);
-	PUTS(ESC_CLEAR_SCREEN);
-	fflush(stdout);
+	PUTS_RAW(ESC_DISABLE_CURSOR);
 	fetch_term_sz();
-	signal(SIGWINCH, winch);
+	term_probe();
+	cforget_state();
+	cclear_screen();
+	fflush(c_out);
+	resize_init();
 
 	cur_term_window_type = (term_window_type)0;
 	cinit_window(cur_term_window_type);
@@ -85,10 +117,11 @@ void cdeinit()
 {
 	if (!has_initiated)
 		return ;
-	PUTS(ESC_ENABLE_CURSOR);
-	PUTS(ESC_CLEAR_SCREEN);
-	fflush(stdout);
-	signal(SIGWINCH, SIG_DFL);
+	cset_attr(ATTR_NONE);
+	PUTS_RAW(ESC_ENABLE_CURSOR);
+	cclear_screen();
+	fflush(c_out);
+	resize_deinit();
 	for (size_t i = 0; i < term_window_type__MAX; i++)
 	{
 		term_window *win = &term_windows[i];
@@ -96,16 +129,10 @@ void cdeinit()
 			continue ;
 		for (size_t j = 0; j < win->components_count; j++)
 		{
-			console_component *c = &win->components[j];
-			if (c->type == TEXT_AREA)
-				free(c->u.c_text_area.buf);
-			else if (c->type == LABEL)
-			{
-				component_label *label = &c->u.c_label;
-				if (label->str && label->str_is_allocated)
-					free((void *)label->str);
-			}
+			if (win->types[j] == TEXT_AREA)
+				free(win->components[j].u.c_text_area.buf);
 		}
+		term_window_free(win);
 	}
 	memset(term_windows, 0, sizeof(term_windows));
 	cur_term_window = NULL;
@@ -148,17 +175,37 @@ void chandle_key_event(KeySym key, int on_press)
 
 void crefresh(int force_redraw)
 {
+	TRACE_SCOPE(force_redraw ? "crefresh_full" : "crefresh");
+	if (pixel_size_query_pending)
+	{
+		// the reply is read by chandle_term_replies()
+		PUTS_RAW("\e[14t");
+		pixel_size_query_pending = 0;
+	}
+	csync_begin();
 	if (force_redraw)
-		PUTS(ESC_CLEAR_SCREEN);
+		cclear_screen();
 
-	for (size_t i = 0; i < cur_term_window->components_count; i++)
+	term_window *win = cur_term_window;
+	size_t words = BITSET_WORDS(win->components_count);
+	for (size_t word = 0; word < words; word++)
 	{
-		console_component *c = &cur_term_window->components[i];
-		if (!c->is_hidden && (c->is_dirty || force_redraw))
+		u64 to_draw = win->dirty[word];
+		if (force_redraw)
 		{
-			if (i == cur_term_window->selected_component)
-				PUTS(ESC_MAGENTA_BACKGROUND ESC_BOLD);
-			switch (c->type)
+			size_t left = win->components_count - word * 64;
+			to_draw = left >= 64 ? ~0ull : (1ull << left) - 1;
+		}
+		// hidden components stay dirty until they are shown again
+		to_draw &= ~win->hidden[word];
+		win->dirty[word] &= ~to_draw;
+		for (; to_draw; to_draw &= to_draw - 1)
+		{
+			size_t i = word * 64 + __builtin_ctzll(to_draw);
+			console_component *c = &win->components[i];
+			// only sent when it differs from what the previous component left
+			cset_attr(i == win->selected_component ? ATTR_SELECTED : ATTR_NONE);
+			switch (win->types[i])
 			{
 				case LABEL:
 					label_draw(c);
@@ -172,29 +219,111 @@ void crefresh(int force_redraw)
 				case BUTTON:
 					button_draw(c);
 					break;
+				case CHAT_PANE:
+					chat_pane_draw(c, force_redraw);
+					break;
 				default:
 					fprintf(stderr, "Invalid component type %d\n", c->type);
 					abort();
 			}
-			if (i == cur_term_window->selected_component)
-				PUTS(ESC_RESET_ATTR);
-			c->is_dirty = 0;
 		}
 	}
+	cset_attr(ATTR_NONE);
+	csync_end();
 
-	fflush(stdout);
+	fflush(c_out);
 }
 
+static size_t layout_component_count(const component_layout *item)
+{
+	switch (item->type)
+	{
+		case layout_PRETTY_TEXT_AREA:
+		case layout_PRETTY_BUTTON:
+			return (2);
+		case layout_LIST_VIEW:
+			return (list_view_component_count(item->h));
+		default:
+			return (1);
+	}
+}
+
+static void add_layout_component(const component_layout *item)
+{
+	console_component component;
+	console_component *added = NULL;
+	switch (item->type)
+	{
+		case layout_LABEL:
+			label_init(&component, item->x, item->y, item->text);
+			if (item->wrap_around)
+				label_wrap_around(&component, item->wrap_around);
+			added = ccomponent_add(component);
+			break;
+		case layout_BUTTON:
+			button_init(&component, item->x, item->y, item->text, item->func, item->param);
+			added = ccomponent_add(component);
+			break;
+		case layout_BOX:
+			box_init(&component, item->x, item->y, item->w, item->h, DEFAULT_BOX_STYLE);
+			added = ccomponent_add(component);
+			break;
+		case layout_PRETTY_TEXT_AREA:
+			added = add_pretty_textarea(item->x, item->y, item->w, item->text, item->text_hidden);
+			break;
+		case layout_PRETTY_BUTTON:
+			added = add_pretty_button(item->x, item->y, item->text, item->func, item->param);
+			break;
+		case layout_LIST_VIEW:
+			list_view_add_components(item->list_view, item->x, item->y, item->w, item->h);
+			break;
+		case layout_CHAT_PANE:
+			chat_pane_init(&component, item->y, item->h, item->chat_log);
+			added = ccomponent_add(component);
+			break;
+	}
+	if (item->ref)
+		*item->ref = added;
+}
+
+// the components are allocated at once, exactly as many as the layout has
 static void cinit_window(term_window_type window_type)
 {
 	assert(window_type >= 0 && window_type < term_window_type__MAX);
 	term_window *win = &term_windows[window_type];
-	if (!win->has_initiated)
+	if (win->has_initiated)
+		return ;
+	memset(win, 0, sizeof(*win));
+	win->selected_component = -1u;
+	win->has_initiated = 1;
+	if (!window_layouts)
+		return ;
+	const window_layout *layout = &window_layouts[window_type];
+	for (size_t i = 0; i < layout->count; i++)
+		win->components_cap += layout_component_count(&layout->items[i]);
+	if (!win->components_cap)
+		return ;
+	term_window_alloc(win, win->components_cap);
+	// ccomponent_add() works on the current window
+	term_window *previous = cur_term_window;
+	term_window_type previous_type = cur_term_window_type;
+	cur_term_window = win;
+	cur_term_window_type = window_type;
+	for (size_t i = 0; i < layout->count; i++)
+		add_layout_component(&layout->items[i]);
+	cur_term_window = previous;
+	cur_term_window_type = previous_type;
+}
+
+void cset_window_layouts(const window_layout *layouts)
+{
+	window_layouts = layouts;
+	// the first window was set up by cinit(), before there was a layout for it
+	if (cur_term_window && !cur_term_window->components_cap)
 	{
-		memset(win, 0, sizeof(*win));
-		win->selected_component = -1u;
+		cur_term_window->has_initiated = 0;
+		cinit_window(cur_term_window_type);
 	}
-	win->has_initiated = 1;
 }
 
 static void _cswitch_window(term_window_type window_type, int refresh)
@@ -204,8 +333,7 @@ static void _cswitch_window(term_window_type window_type, int refresh)
 		cur->u.c_button.held = 0;
 
 	term_window *win = &term_windows[window_type];
-	if (!win->has_initiated)
-		cinit_window(window_type);
+	cinit_window(window_type);
 	cur_term_window = win;
 	cur_term_window_type = window_type;
 	if (refresh)
@@ -241,16 +369,48 @@ void creset_window_stack()
 console_component *ccomponent_add(console_component component)
 {
 	assert(component.type > 0 && component.type < COMPONENT_TYPE_MAX);
-	assert(cur_term_window->components_count < MAX_COMPONENT_NUMBER);
+	assert(cur_term_window->components_count < cur_term_window->components_cap);
 
-	console_component *new_component = &cur_term_window->components[cur_term_window->components_count];
+	term_window *win = cur_term_window;
+	size_t index = win->components_count++;
+	console_component *new_component = &win->components[index];
 	*new_component = component;
-	if (cur_term_window->selected_component == -1u && is_selectable(&component))
-		cur_term_window->selected_component = cur_term_window->components_count;
-	cur_term_window->components_count++;
+	new_component->window = win;
+	new_component->index = index;
+	win->types[index] = component.type;
+	win->boxes[index] = component_bouding_box(new_component);
+	bitset_set(win->dirty, index);
+	if (is_selectable(&component))
+	{
+		bitset_set(win->selectable, index);
+		if (win->selected_component == -1u)
+			win->selected_component = index;
+	}
 	return (new_component);
 }
 
+void term_window_alloc(term_window *win, size_t cap)
+{
+	win->components = xcalloc(cap, sizeof(*win->components));
+	win->types = xcalloc(cap, sizeof(*win->types));
+	win->boxes = xcalloc(cap, sizeof(*win->boxes));
+	win->dirty = xcalloc(BITSET_WORDS(cap), sizeof(u64));
+	win->hidden = xcalloc(BITSET_WORDS(cap), sizeof(u64));
+	win->selectable = xcalloc(BITSET_WORDS(cap), sizeof(u64));
+	win->components_cap = cap;
+}
+
+void term_window_free(term_window *win)
+{
+	free(win->components);
+	free(win->types);
+	free(win->boxes);
+	free(win->dirty);
+	free(win->hidden);
+	free(win->selectable);
+	text_arena_release(&win->texts);
+}
+
 void cnext_component(direction dir)
 {
 	if (!cur_term_window->components_count)
@@ -264,11 +424,6 @@ void cnext_component(direction dir)
 	}
 }
 
-void cursor_goto(u16 x, u16 y)
-{
-	printf("\e[%hd;%hdH", y, x);
-}
-
 console_component *add_pretty_textarea(u16 x, u16 y, u16 len, const char *hint, int text_hidden)
 {
 	console_component text_area, box;
@@ -283,7 +438,7 @@ console_component *add_pretty_textarea(u16 x, u16 y, u16 len, const char *hint,
 	return (result);
 }
 
-console_component	*add_pretty_button(u16 x, u16 y, char *text, button_action_func *func, void *param)
+console_component	*add_pretty_button(u16 x, u16 y, const char *text, button_action_func *func, void *param)
 {
 	assert(text);
 
@@ -311,8 +466,16 @@ aabb	component_bouding_box(console_component *c)
 			return (aabb_create(c->x, c->y, c->u.c_text_area.len, 1));
 		case BOX:
 			return (aabb_create(c->x, c->y, c->u.c_box.w, c->u.c_box.h));
+		case CHAT_PANE:
+			return (aabb_create(c->x, c->y, c_x, c->u.c_chat_pane.h));
 		default:
 			fprintf(stderr, "Invalid component type %d\n", c->type);
 			abort();
 	}
 }
+
+void	component_update_box(console_component *c)
+{
+	if (c->window)
+		c->window->boxes[c->index] = component_bouding_box(c);
+}
@@ -0,0 +1,171 @@
+#include "term.h"
+#include "clock.h"
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+term_caps	c_caps = {0};
+
+// parses a control sequence introducer reply at the start of `buf`, as sent back
+// by the terminal on stdin. returns the number of bytes consumed, 0 if the reply
+// is not complete yet. bytes that don't start a CSI are consumed one by one
+// with reply->final set to 0
+size_t term_parse_reply(const char *buf, size_t len, term_reply *reply)
+{
+	memset(reply, 0, sizeof(*reply));
+	if (!len)
+		return (0);
+	if (buf[0] != '\e')
+		return (1);
+	if (len < 2)
+		return (0);
+	if (buf[1] != '[')
+		return (1);
+	size_t i = 2;
+	if (i < len && (buf[i] == '?' || buf[i] == '>' || buf[i] == '='))
+		reply->prefix = buf[i++];
+	int has_param = 0;
+	for (; i < len; i++)
+	{
+		char chr = buf[i];
+		if (chr >= '0' && chr <= '9')
+		{
+			if (reply->count < TERM_REPLY_MAX_PARAMS)
+				reply->params[reply->count] = reply->params[reply->count] * 10 + (chr - '0');
+			has_param = 1;
+		}
+		else if (chr == ';')
+		{
+			if (reply->count < TERM_REPLY_MAX_PARAMS)
+				reply->count++;
+			has_param = 0;
+		}
+		else if (chr >= 0x20 && chr <= 0x2F)
+			reply->intermediate = chr;
+		else if (chr >= 0x40 && chr <= 0x7E)
+		{
+			if (has_param && reply->count < TERM_REPLY_MAX_PARAMS)
+				reply->count++;
+			reply->final = chr;
+			return (i + 1);
+		}
+		else
+			return (i); // garbage, drop what was read so far
+	}
+	return (0);
+}
+
+void term_apply_pixel_size(u32 pixel_y, u32 pixel_x)
+{
+	if (!pixel_x || !pixel_y || !c_x || !c_y)
+		c_pixel_ratio = 7.0 / 21.0; // most common ratio for terminals
+	else
+	{
+		int sz_tile_x = pixel_x / c_x;
+		int sz_tile_y = pixel_y / c_y;
+		c_pixel_ratio = sz_tile_y ? (float)sz_tile_x / sz_tile_y : 7.0 / 21.0;
+	}
+}
+
+// returns 1 once the DA1 reply, which is always the last one, was received
+static int handle_probe_reply(const term_reply *reply, int *got_pixel_size)
+{
+	switch (reply->final)
+	{
+		case 't':
+			if (reply->count == 3 && reply->params[0] == 4)
+			{
+				term_apply_pixel_size(reply->params[1], reply->params[2]);
+				*got_pixel_size = 1;
+			}
+			break;
+		case 'y':
+			// DECRPM: 1 (set) and 2 (reset) mean the mode is known
+			if (reply->prefix == '?' && reply->intermediate == '$' && reply->count == 2
+				&& reply->params[0] == 2026)
+				c_caps.sync_output = reply->params[1] == 1 || reply->params[1] == 2;
+			break;
+		case 'R':
+			// 'x' then REP of it twice: a terminal knowing REP is now on column 4
+			if (reply->count == 2)
+				c_caps.rep = reply->params[1] == 4;
+			break;
+		case 'c':
+			// ECH came with the VT220 (level 62)
+			if (reply->prefix == '?' && reply->count >= 1)
+				c_caps.ech = reply->params[0] >= 62;
+			return (1);
+	}
+	return (0);
+}
+
+static struct
+{
+	char	buf[256];
+	size_t	len;
+}	pending_replies = {0};
+
+void chandle_term_replies()
+{
+	ssize_t n = read(STDIN_FILENO, pending_replies.buf + pending_replies.len, sizeof(pending_replies.buf) - pending_replies.len);
+	if (n <= 0)
+		return ;
+	pending_replies.len += n;
+	size_t off = 0;
+	size_t consumed;
+	term_reply reply;
+	while ((consumed = term_parse_reply(pending_replies.buf + off, pending_replies.len - off, &reply)))
+	{
+		off += consumed;
+		if (reply.final == 't' && reply.count == 3 && reply.params[0] == 4)
+			term_apply_pixel_size(reply.params[1], reply.params[2]);
+	}
+	memmove(pending_replies.buf, pending_replies.buf + off, pending_replies.len - off);
+	pending_replies.len -= off;
+	if (pending_replies.len == sizeof(pending_replies.buf))
+		pending_replies.len = 0;
+}
+
+// the replies are read with a deadline, a terminal that doesn't answer some
+// queries (or none) just leaves the matching capabilities off
+void term_probe()
+{
+	// the REP test is drawn on the current line, which is erased right after
+	PUTS_RAW("\e[14t" "\e[?2026$p" "\r" "x\e[2b" "\e[6n" "\r\e[K" "\e[c");
+	cforget_state();
+	fflush(c_out);
+
+	char buf[256];
+	size_t len = 0;
+	int got_pixel_size = 0;
+	int done = 0;
+	u64 deadline = clock_ns() + TERM_PROBE_TIMEOUT_MS * 1000000ull;
+	while (!done)
+	{
+		u64 now = clock_ns();
+		if (now >= deadline)
+			break;
+		struct pollfd pollfd = {.fd = STDIN_FILENO, .events = POLLIN};
+		if (poll(&pollfd, 1, (deadline - now) / 1000000 + 1) <= 0)
+			break;
+		ssize_t n = read(STDIN_FILENO, buf + len, sizeof(buf) - len);
+		if (n <= 0)
+			break;
+		len += n;
+		size_t off = 0;
+		term_reply reply;
+		size_t consumed;
+		while (!done && (consumed = term_parse_reply(buf + off, len - off, &reply)))
+		{
+			off += consumed;
+			done = handle_probe_reply(&reply, &got_pixel_size);
+		}
+		memmove(buf, buf + off, len - off);
+		len -= off;
+		if (len == sizeof(buf))
+			len = 0;
+	}
+	if (!got_pixel_size)
+		term_apply_pixel_size(0, 0);
+	c_caps.probed = 1;
+}
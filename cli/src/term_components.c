@@ -2,55 +2,74 @@
 #include "soft_fail.h"
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <assert.h>
 
 void mark_dirty(console_component *c, int full_redraw)
 {
-	c->is_dirty = 1;
+	if (c->window)
+		bitset_set(c->window->dirty, c->index);
 	if (full_redraw && c->type == TEXT_AREA)
 		c->u.c_text_area.has_to_do_full_redraw = 1;
 }
 
+int		component_is_hidden(console_component *c)
+{
+	return (c->window && bitset_test(c->window->hidden, c->index));
+}
+
 void	component_hide(console_component *c)
 {
-	if (!c->is_hidden)
+	assert(c->window);
+	if (!component_is_hidden(c))
 	{
-		c->is_hidden = 1;
-		c->is_dirty = 1;
+		bitset_set(c->window->hidden, c->index);
+		mark_dirty(c, 0);
 	}
 }
 
 void	component_show(console_component *c)
 {
-	if (c->is_hidden)
+	assert(c->window);
+	if (component_is_hidden(c))
 	{
-		c->is_hidden = 0;
-		c->is_dirty = 1;
+		bitset_clear(c->window->hidden, c->index);
+		mark_dirty(c, 0);
 	}
 }
 
 void	component_toggle_visibility(console_component *c)
 {
-	c->is_hidden = !c->is_hidden;
-	c->is_dirty = 1;
+	if (component_is_hidden(c))
+		component_show(c);
+	else
+		component_hide(c);
 }
 
 #define BASE_INIT(t, c, x, y) do { \
 	(c)->type = t; \
-	(c)->is_dirty = 1; \
-	(c)->is_hidden = 0; \
+	(c)->window = NULL; \
+	(c)->index = -1u; \
 	(c)->x = x; \
 	(c)->y = y; \
 } while (0)
 
-void label_init(console_component *c, u16 x, u16 y, const char *content, int str_is_allocated)
+void label_init(console_component *c, u16 x, u16 y, const char *content)
 {
 	BASE_INIT(LABEL, c, x, y);
 	component_label *self = &c->u.c_label;
 	self->str = NULL;
+	self->str_is_inline = 0;
 	self->has_to_clear = 0;
 	self->wrap_around = -1;
-	label_update_text(c, content, str_is_allocated);
+	label_update_text(c, content);
+}
+
+// the component is copied when it is added to its window, so the inline text
+// can't be pointed to
+static const char *label_text(component_label *self)
+{
+	return (self->str_is_inline ? self->inline_str : self->str);
 }
 
 void label_draw(console_component *c)
@@ -58,17 +77,14 @@ void label_draw(console_component *c)
 	int y = c->y;
 	cursor_goto(c->x, y);
 
-	const char *content = c->u.c_label.str;
+	const char *content = label_text(&c->u.c_label);
 	int n_on_cur_line = 0;
 	int wrap_around = c->u.c_label.wrap_around;
 	size_t *has_to_clear = &c->u.c_label.has_to_clear;
 	if (*has_to_clear)
 	{
-		while (*has_to_clear)
-		{
-			PUTC(' ');
-			(*has_to_clear)--;
-		}
+		cerase(*has_to_clear);
+		*has_to_clear = 0;
 		cursor_goto(c->x, y);
 	}
 	if (content)
@@ -100,25 +116,52 @@ void	label_wrap_around(console_component *c, int n)
 	c->u.c_label.wrap_around = n;
 }
 
-void	label_update_text(console_component *c, const char *new_content, int str_is_allocated)
+static void label_replace_text(console_component *c, const char *str, size_t len, int str_is_inline)
 {
 	component_label *self = &c->u.c_label;
-	if (self->str)
+	if (self->str || self->str_is_inline)
 		self->has_to_clear = self->str_len;
-	if (self->str && self->str_is_allocated)
-		free((void *)self->str);
-	if (!new_content)
+	if (str_is_inline)
 	{
-		self->str = "";
-		self->str_len = 0;
+		memmove(self->inline_str, str, len);
+		self->inline_str[len] = '\0';
+		self->str = NULL;
 	}
 	else
+		self->str = str;
+	self->str_len = len;
+	self->str_is_inline = str_is_inline;
+	mark_dirty(c, 0);
+	component_update_box(c);
+}
+
+void	label_update_text(console_component *c, const char *new_content)
+{
+	if (!new_content)
+		new_content = "";
+	label_replace_text(c, new_content, strlen(new_content), 0);
+}
+
+void	label_copy_text(console_component *c, const char *text)
+{
+	size_t len = strlen(text);
+	if (len < LABEL_INLINE_SIZE)
 	{
-		self->str = new_content;
-		self->str_len = strlen(new_content);
+		label_replace_text(c, text, len, 1);
+		return ;
 	}
-	self->str_is_allocated = str_is_allocated;
-	c->is_dirty = 1;
+	assert(c->window);
+	label_replace_text(c, text_arena_intern(&c->window->texts, text, len), len, 0);
+}
+
+void	label_printf(console_component *c, const char *format, ...)
+{
+	char buf[256];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+	label_copy_text(c, buf);
 }
 
 void	text_area_init(console_component *c, u16 x, u16 y, size_t max_text_size, const char *hint, int text_hidden)
@@ -134,12 +177,6 @@ void	text_area_init(console_component *c, u16 x, u16 y, size_t max_text_size, co
 	self->text_hidden = text_hidden;
 }
 
-static void putcn(char c, size_t n)
-{
-	for (size_t i = 0; i < n; i++)
-		PUTC(c);
-}
-
 void text_area_draw(console_component *c, int force_redraw)
 {
 	component_text_area *self = &c->u.c_text_area;
@@ -149,10 +186,11 @@ void text_area_draw(console_component *c, int force_redraw)
 	{
 		if (self->hint)
 		{
+			u8 base_attr = c_out_state.attr;
 			cursor_goto(c->x, c->y);
-			PUTS(ESC_BLINK ESC_HALFBRIGHT);
+			cset_attr(base_attr | ATTR_HINT);
 			PUTS(self->hint);
-			PUTS(ESC_RESET_ATTR);
+			cset_attr(base_attr);
 		}
 	}
 	else
@@ -161,9 +199,10 @@ void text_area_draw(console_component *c, int force_redraw)
 		{
 			cursor_goto(c->x, c->y);
 			if (self->text_hidden)
-				putcn('*', self->cursor);
+				cputcn('*', self->cursor);
 			else
-				printf("%.*s", (int)self->cursor, self->buf);
+				for (size_t i = 0; i < self->cursor; i++)
+					PUTC(self->buf[i]);
 			self->has_to_do_full_redraw = 0;
 		}
 		else
@@ -171,17 +210,16 @@ void text_area_draw(console_component *c, int force_redraw)
 			if (self->last_draw_num_chars > self->cursor)
 			{
 				// there are less characters than during the previous draw, so we erase the surplus
-				PUTS(ESC_RESET_ATTR);
+				cset_attr(ATTR_NONE);
 				cursor_goto(c->x + self->cursor, c->y);
-				for (size_t i = self->cursor; i < self->last_draw_num_chars; i++)
-					PUTC(' ');
+				cerase(self->last_draw_num_chars - self->cursor);
 			}
 			else if (self->last_draw_num_chars < self->cursor)
 			{
 				// write only the new characters
 				cursor_goto(c->x + self->last_draw_num_chars, c->y);
 				if (self->text_hidden)
-					putcn('*', self->cursor - self->last_draw_num_chars);
+					cputcn('*', self->cursor - self->last_draw_num_chars);
 				else
 					for (size_t i = self->last_draw_num_chars; i < self->cursor; i++)
 						PUTC(self->buf[i]);
@@ -190,11 +228,9 @@ void text_area_draw(console_component *c, int force_redraw)
 
 		if (self->cursor < self->hint_len)
 		{
-			PUTS(ESC_RESET_ATTR);
+			cset_attr(ATTR_NONE);
 			cursor_goto(c->x + self->cursor, c->y);
-			size_t diff = self->hint_len - self->cursor;
-			for (size_t i = 0; i < diff; i++)
-				PUTC(' ');
+			cerase(self->hint_len - self->cursor);
 		}
 	}
 	self->last_draw_num_chars = self->cursor;
@@ -253,26 +289,23 @@ void	box_draw(console_component *c)
 	PUTC(self->top_left);
 	if (self->w > 1)
 	{
-		for (u16 i = 0; i < self->w - 2; i++)
-			PUTC(self->top);
+		cputcn(self->top, self->w - 2);
 		PUTC(self->top_right);
 	}
 
 	if (self->h > 2)
 	{
-		cursor_goto(c->x, c->y + 1);
 		for (u16 i = 0; i < self->h - 2; i++)
 		{
+			cursor_goto(c->x, c->y + 1 + i);
 			PUTC(self->left);
-			PUTS(ESC_CURSOR_LEFT ESC_CURSOR_DOWN);
 		}
 		if (self->w > 1)
 		{
-			cursor_goto(c->x + self->w - 1, c->y + 1);
 			for (u16 i = 0; i < self->h - 2; i++)
 			{
+				cursor_goto(c->x + self->w - 1, c->y + 1 + i);
 				PUTC(self->right);
-				PUTS(ESC_CURSOR_LEFT ESC_CURSOR_DOWN);
 			}
 		}
 	}
@@ -284,15 +317,14 @@ void	box_draw(console_component *c)
 
 		if (self->w > 1)
 		{
-			for (u16 i = 0; i < self->w - 2; i++)
-				PUTC(self->bottom);
+			cputcn(self->bottom, self->w - 2);
 			if (self->w > 1)
 				PUTC(self->bottom_right);
 		}
 	}
 }
 
-void	button_init(console_component *c, u16 x, u16 y, char *text, button_action_func *func, void *param)
+void	button_init(console_component *c, u16 x, u16 y, const char *text, button_action_func *func, void *param)
 {
 	BASE_INIT(BUTTON, c, x, y);
 	component_button *self = &c->u.c_button;
@@ -311,57 +343,265 @@ void	button_draw(console_component *c)
 	label_draw(c);
 }
 
-void list_view_init(list_view *list_view,
-	u16 x, u16 y, u16 w, u16 h,
-	draw_view_func *draw_view_func, i64 *list_size, void **list, size_t elem_size)
+void	chat_pane_init(console_component *c, u16 y, u16 h, const chat_log *log)
+{
+	assert(h <= CHAT_LOG_CAPACITY);
+	u16 x = 1;
+	BASE_INIT(CHAT_PANE, c, x, y);
+	c->u.c_chat_pane = (component_chat_pane){.log = log, .h = h};
+}
+
+// at most `max_chars` characters of the `len` bytes of `str`, which is UTF-8.
+// returns how many were written
+static size_t chat_pane_put(const char *str, size_t len, size_t max_chars)
+{
+	size_t chars = 0;
+	size_t end = 0;
+	for (; end < len; end++)
+	{
+		if (((u8)str[end] & 0xC0) == 0x80)
+			continue;
+		if (chars == max_chars)
+			break;
+		chars++;
+	}
+	fwrite(str, 1, end, c_out);
+	c_out_state.x += chars;
+	return (chars);
+}
+
+// the row has to be blank already unless `clear` is set
+static void chat_pane_draw_row(console_component *c, u16 row, const chat_entry *entry, int clear)
+{
+	// the last column is left alone, the terminal would be waiting to wrap
+	size_t width = c_x > 1 ? c_x - 1 : 1;
+	size_t chars = 0;
+	cursor_goto(1, c->y + row);
+	if (entry)
+	{
+		if (entry->kind != chat_kind_CHANNEL)
+			chars += chat_pane_put("[dm] ", 5, width);
+		cset_attr(ATTR_BOLD);
+		chars += chat_pane_put(entry->from, entry->from_len, width - chars);
+		cset_attr(ATTR_NONE);
+		chars += chat_pane_put(": ", 2, width - chars);
+		chars += chat_pane_put(entry->text, entry->text_len, width - chars);
+	}
+	if (clear && chars < c_x)
+		cerase(c_x - chars);
+}
+
+void	chat_pane_draw(console_component *c, int force_redraw)
+{
+	component_chat_pane *self = &c->u.c_chat_pane;
+	u64 added = self->log->total - self->drawn_total;
+	size_t count = chat_log_count(self->log);
+	size_t max_scroll = count > self->h ? count - self->h : 0;
+	// a view into the history stays on the same messages
+	if (self->scroll)
+		self->scroll += added;
+	if (self->scroll > max_scroll)
+		self->scroll = max_scroll;
+	u16 rows = count - self->scroll < self->h ? count - self->scroll : self->h;
+
+	cset_attr(ATTR_NONE);
+	if (!force_redraw && self->is_drawn && !self->scroll && !self->drawn_scroll && added < self->h)
+	{
+		// the rows already drawn move up to make room for the new ones
+		if (self->drawn_rows + added > self->h)
+			cscroll_up(c->y, c->y + self->h - 1, self->drawn_rows + added - self->h);
+		for (u16 row = rows - added; row < rows; row++)
+			chat_pane_draw_row(c, row, chat_log_get(self->log, rows - 1 - row), 0);
+	}
+	else
+	{
+		for (u16 row = 0; row < self->h; row++)
+		{
+			const chat_entry *entry = row < rows ? chat_log_get(self->log, self->scroll + rows - 1 - row) : NULL;
+			chat_pane_draw_row(c, row, entry, 1);
+		}
+	}
+	self->drawn_total = self->log->total;
+	self->drawn_scroll = self->scroll;
+	self->drawn_rows = rows;
+	self->is_drawn = 1;
+}
+
+int		chat_pane_scroll(console_component *c, int delta)
+{
+	component_chat_pane *self = &c->u.c_chat_pane;
+	size_t count = chat_log_count(self->log);
+	i64 max_scroll = count > self->h ? count - self->h : 0;
+	i64 scroll = (i64)self->scroll + delta;
+	scroll = scroll < 0 ? 0 : scroll > max_scroll ? max_scroll : scroll;
+	if (scroll == self->scroll)
+		return (0);
+	self->scroll = scroll;
+	mark_dirty(c, 0);
+	return (1);
+}
+
+static void *list_view_array_get(void *source, i64 index)
+{
+	list_view *list_view = source;
+	if (index < 0 || index >= *list_view->list_size)
+		return (NULL);
+	return (*list_view->list + list_view->elem_size * index);
+}
+
+static int list_view_array_has(void *source, i64 index)
+{
+	list_view *list_view = source;
+	return (index >= 0 && index < *list_view->list_size);
+}
+
+void list_view_init_source(list_view *list_view,
+	draw_view_func *draw_view_func, list_row_text_func *row_text_func,
+	list_get_func *get, list_has_func *has, void *source)
+{
+	list_view->my_window = term_window_type__MAX;
+	list_view->draw_view_func = draw_view_func;
+	list_view->row_text_func = row_text_func;
+	list_view->list_cursor = 0;
+	list_view->viewport_top = 0;
+	list_view->get = get;
+	list_view->has = has;
+	list_view->source = source;
+}
+
+size_t list_view_component_count(u16 h)
+{
+	return (3 + (h - 2 > LIST_VIEW_MAX_ROWS ? LIST_VIEW_MAX_ROWS : h - 2));
+}
+
+void list_view_add_components(list_view *list_view, u16 x, u16 y, u16 w, u16 h)
 {
 	console_component c;
-	
-	label_init(&c, x - 2, y + h / 2, "<", 0);
-	list_view->left_arrow_label = ccomponent_add(c);
-	label_init(&c, x + w + 1, y + h / 2, ">", 0);
-	list_view->right_arrow_label = ccomponent_add(c);
+
+	assert(h > 2 && w > 4);
 	box_init(&c, x, y, w, h, '-', '-', '|', '|', '+', '+', '+', '+');
 	list_view->box = ccomponent_add(c);
+	label_init(&c, x + w / 2, y - 1, "^");
+	list_view->up_arrow_label = ccomponent_add(c);
+	label_init(&c, x + w / 2, y + h, "v");
+	list_view->down_arrow_label = ccomponent_add(c);
 
+	list_view->rows_count = h - 2;
+	if (list_view->rows_count > LIST_VIEW_MAX_ROWS)
+		list_view->rows_count = LIST_VIEW_MAX_ROWS;
+	list_view->row_width = w - 4;
+	if (list_view->row_width > LIST_VIEW_ROW_MAX - 1)
+		list_view->row_width = LIST_VIEW_ROW_MAX - 1;
+	for (u16 i = 0; i < list_view->rows_count; i++)
+	{
+		list_view->rows[i].text[0] = 0;
+		label_init(&c, x + 2, y + 1 + i, list_view->rows[i].text);
+		list_view->rows[i].label = ccomponent_add(c);
+	}
 	list_view->my_window = cur_term_window_type;
-	list_view->draw_view_func = draw_view_func;
+}
+
+void list_view_init(list_view *list_view,
+	draw_view_func *draw_view_func, list_row_text_func *row_text_func,
+	i64 *list_size, void **list, size_t elem_size)
+{
+	list_view_init_source(list_view, draw_view_func, row_text_func,
+		list_view_array_get, list_view_array_has, list_view);
 	list_view->list_size = list_size;
-	list_view->list_cursor = 0;
 	list_view->list = list;
 	list_view->elem_size = elem_size;
 }
 
+static void list_view_set_row(list_view *list_view, u16 row_idx, void *obj, int has_cursor)
+{
+	list_view_row *row = &list_view->rows[row_idx];
+	char buf[LIST_VIEW_ROW_MAX];
+
+	buf[0] = 0;
+	if (obj)
+	{
+		buf[0] = has_cursor ? '>' : ' ';
+		buf[1] = ' ';
+		buf[2] = 0;
+		if (list_view->row_text_func)
+			list_view->row_text_func(obj, buf + 2, sizeof(buf) - 2);
+		buf[list_view->row_width] = 0;
+	}
+	if (!strcmp(buf, row->text))
+		return ;
+	strcpy(row->text, buf);
+	label_update_text(row->label, row->text);
+}
+
+static void list_view_update_arrows(list_view *list_view)
+{
+	if (list_view->viewport_top > 0)
+		component_show(list_view->up_arrow_label);
+	else
+		component_hide(list_view->up_arrow_label);
+	if (list_view->has(list_view->source, list_view->viewport_top + list_view->rows_count))
+		component_show(list_view->down_arrow_label);
+	else
+		component_hide(list_view->down_arrow_label);
+}
+
 int list_view_update(list_view *list_view, void *param, int increment)
 {
 	if (cur_term_window_type != list_view->my_window)
 		return (0);
-	if (!*list_view->list_size)
+	i64 new_cursor = list_view->list_cursor + increment;
+	if (new_cursor < 0)
+		new_cursor = list_view->list_cursor ? 0 : -1;
+	void *elem = new_cursor >= 0 ? list_view->get(list_view->source, new_cursor) : NULL;
+	while (!elem && new_cursor > list_view->list_cursor + 1)
+		elem = list_view->get(list_view->source, --new_cursor);
+	if (!elem && !increment)
 	{
-		component_hide(list_view->left_arrow_label);
-		component_hide(list_view->right_arrow_label);
+		// empty list
+		list_view->list_cursor = 0;
+		list_view->viewport_top = 0;
+		for (u16 i = 0; i < list_view->rows_count; i++)
+			list_view_set_row(list_view, i, NULL, 0);
+		component_hide(list_view->up_arrow_label);
+		component_hide(list_view->down_arrow_label);
 		if (list_view->draw_view_func)
 			list_view->draw_view_func(NULL, param);
 		crefresh(1);
 		return (0);
 	}
-	i64 new_cursor = list_view->list_cursor + increment;
-	if (new_cursor >= 0 && new_cursor < *list_view->list_size)
+	if (!elem)
 	{
-		list_view->list_cursor = new_cursor;
-		if (!new_cursor)
-			component_hide(list_view->left_arrow_label);
-		else
-			component_show(list_view->left_arrow_label);
-		if (new_cursor + 1 == *list_view->list_size)
-			component_hide(list_view->right_arrow_label);
-		else
-			component_show(list_view->right_arrow_label);
+		// the source might have found out the list ended sooner than expected
+		list_view_update_arrows(list_view);
+		crefresh(0);
+		return (0);
+	}
 
-		if (list_view->draw_view_func)
-			list_view->draw_view_func(*list_view->list + list_view->elem_size * new_cursor, param);
-		crefresh(1);
-		return (1);
+	list_view->list_cursor = new_cursor;
+	if (new_cursor < list_view->viewport_top)
+		list_view->viewport_top = new_cursor;
+	else if (new_cursor >= list_view->viewport_top + list_view->rows_count)
+		list_view->viewport_top = new_cursor - list_view->rows_count + 1;
+	// only the visible rows are materialized, rows whose text didn't change aren't redrawn
+	for (u16 i = 0; i < list_view->rows_count; i++)
+	{
+		i64 index = list_view->viewport_top + i;
+		list_view_set_row(list_view, i, list_view->get(list_view->source, index), index == new_cursor);
 	}
-	return (0);
+	list_view_update_arrows(list_view);
+
+	// fetched last, a paged source keeps the page of the last returned element in memory
+	elem = list_view->get(list_view->source, new_cursor);
+	if (list_view->draw_view_func)
+		list_view->draw_view_func(elem, param);
+	crefresh(!increment);
+	return (1);
+}
+
+void list_view_refresh_index(list_view *list_view, i64 index)
+{
+	i64 row_idx = index - list_view->viewport_top;
+	if (row_idx < 0 || row_idx >= list_view->rows_count)
+		return ;
+	list_view_set_row(list_view, row_idx, list_view->get(list_view->source, index), index == list_view->list_cursor);
 }
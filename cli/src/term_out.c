@@ -0,0 +1,246 @@
+#include "term.h"
+#include <string.h>
+
+term_out_state	c_out_state = {0};
+
+static const struct
+{
+	u8	attr;
+	u8	on;
+	u8	off;
+}	attr_codes[] = {
+	{ATTR_BOLD, 1, 22},
+	{ATTR_HALFBRIGHT, 2, 22},
+	{ATTR_BLINK, 5, 25},
+	{ATTR_MAGENTA_BACKGROUND, 45, 49},
+};
+
+#define ATTR_CODES_COUNT (sizeof(attr_codes) / sizeof(attr_codes[0]))
+
+void cputs(const char *s)
+{
+	fputs(s, c_out);
+	// one cell per character, utf-8 continuation bytes don't count
+	for (; *s; s++)
+		c_out_state.x += ((u8)*s & 0xC0) != 0x80;
+}
+
+static int digits(size_t n)
+{
+	int count = 1;
+	while (n >= 10)
+	{
+		n /= 10;
+		count++;
+	}
+	return (count);
+}
+
+void cputcn(char c, size_t n)
+{
+	if (!n)
+		return ;
+	PUTC(c);
+	size_t rest = n - 1;
+	if (c_caps.rep && rest > 3 + (size_t)digits(rest))
+	{
+		fprintf(c_out, "\e[%zub", rest);
+		c_out_state.x += rest;
+	}
+	else
+	{
+		while (rest--)
+			PUTC(c);
+	}
+}
+
+void cerase(size_t n)
+{
+	if (!n)
+		return ;
+	// neither EL nor ECH move the cursor
+	if (c_out_state.cursor_known && c_x && c_out_state.x + n > c_x)
+		PUTS_RAW("\e[K");
+	else if (c_caps.ech && n > 1)
+		fprintf(c_out, "\e[%zuX", n);
+	else
+		cputcn(' ', n);
+}
+
+void csync_begin()
+{
+	if (c_caps.sync_output)
+		PUTS_RAW("\e[?2026h");
+}
+
+void csync_end()
+{
+	if (c_caps.sync_output)
+		PUTS_RAW("\e[?2026l");
+}
+
+void cclear_screen()
+{
+	PUTS_RAW(ESC_CLEAR_SCREEN);
+	c_out_state.x = 1;
+	c_out_state.y = 1;
+	c_out_state.cursor_known = 1;
+}
+
+void cforget_state()
+{
+	c_out_state.cursor_known = 0;
+	c_out_state.attr_known = 0;
+}
+
+static int append_code(char *buf, int len, int code)
+{
+	return (len + sprintf(buf + len, "%s%d", len > 2 ? ";" : "", code));
+}
+
+// sends a single SGR sequence, either the delta from the current attributes
+// or a reset followed by the wanted ones, whichever is shorter
+void cset_attr(u8 attr)
+{
+	if (c_out_state.attr_known && c_out_state.attr == attr)
+		return ;
+
+	char reset_seq[32] = "\e[";
+	int reset_len = append_code(reset_seq, 2, 0);
+	for (size_t i = 0; i < ATTR_CODES_COUNT; i++)
+		if (attr & attr_codes[i].attr)
+			reset_len = append_code(reset_seq, reset_len, attr_codes[i].on);
+
+	char delta_seq[32] = "\e[";
+	int delta_len = 2;
+	if (c_out_state.attr_known)
+	{
+		u8 cur = c_out_state.attr;
+		u8 turned_off = 0;
+		for (size_t i = 0; i < ATTR_CODES_COUNT; i++)
+		{
+			if (!(cur & ~attr & attr_codes[i].attr) || (turned_off & attr_codes[i].attr))
+				continue;
+			delta_len = append_code(delta_seq, delta_len, attr_codes[i].off);
+			// bold and halfbright share their off code
+			for (size_t j = 0; j < ATTR_CODES_COUNT; j++)
+				if (attr_codes[j].off == attr_codes[i].off)
+					turned_off |= attr_codes[j].attr;
+		}
+		for (size_t i = 0; i < ATTR_CODES_COUNT; i++)
+		{
+			u8 bit = attr_codes[i].attr;
+			if ((attr & bit) && (!(cur & bit) || (turned_off & bit)))
+				delta_len = append_code(delta_seq, delta_len, attr_codes[i].on);
+		}
+	}
+
+	char *seq = c_out_state.attr_known && delta_len <= reset_len ? delta_seq : reset_seq;
+	fputs(seq, c_out);
+	fputc('m', c_out);
+	c_out_state.attr = attr;
+	c_out_state.attr_known = 1;
+}
+
+// cost of a relative motion of `n` cells with a one byte form (LF, BS) usable
+// for a few cells, against its CSI form
+static int relative_cost(int n, int has_single_byte)
+{
+	if (!n)
+		return (0);
+	int csi = n == 1 ? 3 : 3 + digits(n);
+	if (has_single_byte && n < csi)
+		return (n);
+	return (csi);
+}
+
+static void emit_relative(int n, char single_byte, char csi_final)
+{
+	if (!n)
+		return ;
+	int csi = n == 1 ? 3 : 3 + digits(n);
+	if (single_byte && n < csi)
+	{
+		while (n--)
+			fputc(single_byte, c_out);
+	}
+	else if (n == 1)
+		fprintf(c_out, "\e[%c", csi_final);
+	else
+		fprintf(c_out, "\e[%d%c", n, csi_final);
+}
+
+// moves the cursor with the shortest of: nothing, CR/LF/BS, relative CUF/CUB/
+// CUD/CUU (optionally after a CR), or an absolute CUP
+void cursor_goto(u16 x, u16 y)
+{
+	x = x ? x : 1;
+	y = y ? y : 1;
+	term_out_state *state = &c_out_state;
+	// past the last column the terminal is waiting to wrap, its column is unclear
+	if (state->cursor_known && c_x && state->x > c_x)
+		state->cursor_known = 0;
+
+	int cup_cost = (x == 1 && y == 1) ? 3 : 4 + digits(x) + digits(y);
+	int best_cost = cup_cost;
+	int use_cr = 0;
+	int dy = 0;
+	int lf_ok = 0;
+	if (state->cursor_known)
+	{
+		dy = (int)y - state->y;
+		// LF would scroll if the target line is off the screen
+		lf_ok = !c_y || y <= c_y;
+		int vertical = dy >= 0 ? relative_cost(dy, lf_ok) : relative_cost(-dy, 0);
+		int dx = (int)x - state->x;
+		int horizontal = dx >= 0 ? relative_cost(dx, 0) : relative_cost(-dx, 1);
+		int from_cr = 1 + relative_cost(x - 1, 0);
+		if (vertical + horizontal < best_cost)
+			best_cost = vertical + horizontal;
+		if (vertical + from_cr < best_cost)
+		{
+			best_cost = vertical + from_cr;
+			use_cr = 1;
+		}
+	}
+
+	if (best_cost == cup_cost)
+	{
+		if (x == 1 && y == 1)
+			PUTS_RAW("\e[H");
+		else
+			fprintf(c_out, "\e[%hu;%huH", y, x);
+	}
+	else
+	{
+		int from_x = state->x;
+		if (use_cr)
+		{
+			fputc('\r', c_out);
+			from_x = 1;
+		}
+		if (dy >= 0)
+			emit_relative(dy, lf_ok ? '\n' : 0, 'B');
+		else
+			emit_relative(-dy, 0, 'A');
+		if (x >= from_x)
+			emit_relative(x - from_x, 0, 'C');
+		else
+			emit_relative(from_x - x, '\b', 'D');
+	}
+	state->x = x;
+	state->y = y;
+	state->cursor_known = 1;
+}
+
+// through a scrolling region, which is reset right away. setting or resetting
+// it moves the cursor home
+void cscroll_up(u16 top, u16 bottom, u16 n)
+{
+	if (!n)
+		return ;
+	fprintf(c_out, "\e[%hu;%hur\e[%huS\e[r", top, bottom, n);
+	c_out_state.x = 1;
+	c_out_state.y = 1;
+	c_out_state.cursor_known = 1;
+}
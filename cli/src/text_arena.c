@@ -0,0 +1,82 @@
+#include "text_arena.h"
+#include "config.h"
+#include "soft_fail.h"
+#include <string.h>
+
+static u32 hash_text(const char *str, size_t len)
+{
+	u32 hash = 2166136261u;
+	for (size_t i = 0; i < len; i++)
+		hash = (hash ^ (u8)str[i]) * 16777619u;
+	return (hash);
+}
+
+// kept at most half full
+static void grow_entries(text_arena *arena)
+{
+	u32 cap = arena->entries ? (arena->entries_mask + 1) * 2 : 16;
+	text_arena_entry *entries = xcalloc(cap, sizeof(*entries));
+	for (u32 i = 0; arena->entries && i <= arena->entries_mask; i++)
+	{
+		text_arena_entry *entry = &arena->entries[i];
+		if (!entry->str)
+			continue;
+		u32 slot = entry->hash & (cap - 1);
+		while (entries[slot].str)
+			slot = (slot + 1) & (cap - 1);
+		entries[slot] = *entry;
+	}
+	free(arena->entries);
+	arena->entries = entries;
+	arena->entries_mask = cap - 1;
+}
+
+// texts longer than a chunk get a chunk of their own
+static char *arena_alloc(text_arena *arena, size_t size)
+{
+	text_chunk *chunk = arena->chunks;
+	if (!chunk || chunk->size - chunk->used < size)
+	{
+		size_t chunk_size = size > TEXT_ARENA_CHUNK_SIZE ? size : TEXT_ARENA_CHUNK_SIZE;
+		chunk = xmalloc(sizeof(*chunk) + chunk_size);
+		chunk->used = 0;
+		chunk->size = chunk_size;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+	char *res = chunk->data + chunk->used;
+	chunk->used += size;
+	return (res);
+}
+
+const char *text_arena_intern(text_arena *arena, const char *str, size_t len)
+{
+	if (!arena->entries || (arena->entries_count + 1) * 2 > arena->entries_mask + 1)
+		grow_entries(arena);
+	u32 hash = hash_text(str, len);
+	u32 slot = hash & arena->entries_mask;
+	for (; arena->entries[slot].str; slot = (slot + 1) & arena->entries_mask)
+	{
+		text_arena_entry *entry = &arena->entries[slot];
+		if (entry->hash == hash && entry->len == len && !memcmp(entry->str, str, len))
+			return (entry->str);
+	}
+	char *copy = arena_alloc(arena, len + 1);
+	memcpy(copy, str, len);
+	copy[len] = '\0';
+	arena->entries[slot] = (text_arena_entry){.str = copy, .len = len, .hash = hash};
+	arena->entries_count++;
+	return (copy);
+}
+
+void text_arena_release(text_arena *arena)
+{
+	while (arena->chunks)
+	{
+		text_chunk *next = arena->chunks->next;
+		free(arena->chunks);
+		arena->chunks = next;
+	}
+	free(arena->entries);
+	*arena = (text_arena){0};
+}
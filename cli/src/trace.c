@@ -0,0 +1,108 @@
+#define _GNU_SOURCE
+#include "trace.h"
+#include "clock.h"
+#include "config.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+_Atomic int	trace_enabled = 0;
+
+static trace_event		*ring = NULL;
+static _Atomic u64		ring_head = 0;
+static u64				start_ns = 0;
+static const char		*trace_path = NULL;
+static _Thread_local u32	cur_tid = 0;
+
+static void trace_dump();
+
+int trace_init(const char *path)
+{
+	ring = calloc(TRACE_RING_SIZE, sizeof(*ring));
+	if (!ring)
+		return (0);
+	trace_path = path;
+	start_ns = clock_ns();
+	atexit(trace_dump);
+	atomic_store_explicit(&trace_enabled, 1, memory_order_release);
+	return (1);
+}
+
+// writers only contend on the head, each one then owns its slot until it
+// publishes it through `seq`
+void trace_record(const char *name, char phase, const char *detail)
+{
+	if (!cur_tid)
+		cur_tid = syscall(SYS_gettid);
+	u64 idx = atomic_fetch_add_explicit(&ring_head, 1, memory_order_relaxed);
+	trace_event *event = &ring[idx & (TRACE_RING_SIZE - 1)];
+	atomic_store_explicit(&event->seq, 0, memory_order_relaxed);
+	event->ts_ns = clock_ns();
+	event->name = name;
+	event->tid = cur_tid;
+	event->phase = phase;
+	if (detail)
+		strncpy(event->detail, detail, TRACE_DETAIL_MAX - 1);
+	event->detail[detail ? TRACE_DETAIL_MAX - 1 : 0] = '\0';
+	atomic_store_explicit(&event->seq, idx + 1, memory_order_release);
+}
+
+static void print_escaped(FILE *stream, const char *str)
+{
+	for (; *str; str++)
+	{
+		if (*str == '"' || *str == '\\')
+			fprintf(stream, "\\%c", *str);
+		else if ((unsigned char)*str < 0x20)
+			fprintf(stream, "\\u%04x", *str);
+		else
+			putc(*str, stream);
+	}
+}
+
+// the ring is never freed: the websocket thread may still be in trace_record()
+// when exit() runs the dump, its unfinished events are skipped
+static void trace_dump()
+{
+	if (!atomic_exchange_explicit(&trace_enabled, 0, memory_order_acq_rel))
+		return ;
+	FILE *stream = fopen(trace_path, "w");
+	if (!stream)
+	{
+		perror(trace_path);
+		return ;
+	}
+	u64 head = atomic_load_explicit(&ring_head, memory_order_acquire);
+	u64 first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+	int pid = getpid();
+	int is_first = 1;
+
+	fprintf(stream, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for (u64 idx = first; idx < head; idx++)
+	{
+		const trace_event *event = &ring[idx & (TRACE_RING_SIZE - 1)];
+		// skips slots that were being written when the dump started
+		if (atomic_load_explicit(&event->seq, memory_order_acquire) != idx + 1)
+			continue;
+		fprintf(stream, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u",
+			is_first ? "" : ",\n", event->name, event->phase,
+			(double)(event->ts_ns - start_ns) / 1000.0, pid, event->tid);
+		if (event->phase == 'i')
+			fprintf(stream, ",\"s\":\"t\"");
+		if (event->detail[0])
+		{
+			fprintf(stream, ",\"args\":{\"detail\":\"");
+			print_escaped(stream, event->detail);
+			fprintf(stream, "\"}");
+		}
+		putc('}', stream);
+		is_first = 0;
+	}
+	fprintf(stream, "\n]}\n");
+	fclose(stream);
+	if (head > TRACE_RING_SIZE)
+		fprintf(stderr, "trace: ring full, only the last %d of %lu events were kept\n", TRACE_RING_SIZE, (unsigned long)head);
+}
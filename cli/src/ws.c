@@ -1,13 +1,20 @@
 #include "ws.h"
 #include "soft_fail.h"
+#include "trace.h"
+#include "clock.h"
 #include <sys/poll.h>
+#include <sys/eventfd.h>
+#include <sched.h>
+#include <signal.h>
 #include <errno.h>
 #include <string.h>
+#include <unistd.h>
 
 typedef enum
 {
 	ws_xfer_error_CURL = 1,
 	ws_xfer_error_POLL,
+	ws_xfer_error_TIMEOUT,
 	ws_xfer_error_TOO_BIG,
 	ws_xfer_error_JSON_PARSE,
 	ws_xfer_error_JSON_CONTENT,
@@ -29,19 +36,22 @@ typedef struct
 	};
 }	ws_xfer_result;
 
+// what the websocket thread hands to the main one: a message or the error that
+// stopped it
+typedef struct
+{
+	ws_xfer_result	res;
+	int				is_recv;
+}	ws_event;
+
 static void ws_ctx_print_xfer_result(ws_ctx *ctx, ws_xfer_result res, int is_recv, FILE *stream);
 
+// websocket thread
+
+// receives and parses one message. CURLE_AGAIN means nothing was pending
 static ws_xfer_result ws_recv_common(ws_ctx *ctx)
 {
 	ws_xfer_result res = {0};
-	struct pollfd pollfd = {.events = POLLIN, .fd = ctx->sock, .revents = 0};
-	int poll_err = poll(&pollfd, 1, MAX_WS_TIMEOUT);
-	if (poll_err < 0)
-	{
-		res.err = ws_xfer_error_POLL;
-		res.poll_errno = errno;
-		return (res);
-	}
 	size_t received = 0;
 	const struct curl_ws_frame *meta = NULL;
 	CURLcode err = curl_ws_recv(ctx->curl, ctx->recv_buf, sizeof ctx->recv_buf - 1, &received, &meta);
@@ -61,8 +71,9 @@ static ws_xfer_result ws_recv_common(ws_ctx *ctx)
 	if (!json)
 	{
 		res.err = ws_xfer_error_JSON_PARSE;
+		// cJSON keeps the error in a global, the main thread may have overwritten it
 		const char *error_ptr = cJSON_GetErrorPtr();
-		if (!error_ptr) // allocation error
+		if (!error_ptr || error_ptr < ctx->recv_buf || error_ptr > ctx->recv_buf + received)
 			res.json_error_pos = -1u;
 		else
 			res.json_error_pos = error_ptr - ctx->recv_buf;
@@ -72,52 +83,284 @@ static ws_xfer_result ws_recv_common(ws_ctx *ctx)
 	return (res);
 }
 
-ws_recv_data ws_recv(ws_ctx *ctx)
+static ws_xfer_result ws_send_common(ws_ctx *ctx, const char *msg)
 {
-	ws_xfer_result res = ws_recv_common(ctx);
-	if (res.err)
-		DO_CLEANUP(ws_ctx_print_xfer_result(ctx, res, 1, stderr));
-	cJSON *type_node = cJSON_GetObjectItemCaseSensitive(res.json_obj, "type");
+	TRACE_SCOPE("ws_send");
+	ws_xfer_result res = {0};
+	size_t offset = 0;
+	size_t to_send = strlen(msg);
+	while (offset < to_send && !atomic_load_explicit(&ctx->stop, memory_order_relaxed))
+	{
+		size_t sent;
+		CURLcode err = curl_ws_send(ctx->curl, msg + offset, to_send - offset, &sent, 0, CURLWS_TEXT);
+		if (err == CURLE_OK)
+		{
+			offset += sent;
+			continue;
+		}
+		if (err != CURLE_AGAIN)
+		{
+			res.err = ws_xfer_error_CURL;
+			res.curl_code = err;
+			break;
+		}
+		struct pollfd pollfd = {.events = POLLOUT, .fd = ctx->sock, .revents = 0};
+		int poll_err = poll(&pollfd, 1, MAX_WS_TIMEOUT);
+		if (poll_err < 0 && errno != EINTR)
+		{
+			res.err = ws_xfer_error_POLL;
+			res.poll_errno = errno;
+			break;
+		}
+		if (!poll_err)
+		{
+			res.err = ws_xfer_error_TIMEOUT;
+			break;
+		}
+	}
+	return (res);
+}
+
+// the main thread only stops on an error it received, so the ring can't stay full
+static void ws_push_event(ws_ctx *ctx, ws_event *event)
+{
+	while (!spsc_ring_push(&ctx->inbound, event))
+		sched_yield();
+	eventfd_write(ctx->inbound_fd, 1);
+}
+
+// returns 0 on error, which was forwarded to the main thread
+static int ws_thread_send_queued(ws_ctx *ctx)
+{
+	char *msg;
+	while (spsc_ring_pop(&ctx->outbound, &msg))
+	{
+		ws_xfer_result res = ws_send_common(ctx, msg);
+		free(msg);
+		if (res.err)
+		{
+			ws_event event = {.res = res, .is_recv = 0};
+			ws_push_event(ctx, &event);
+			return (0);
+		}
+	}
+	return (1);
+}
+
+// reads everything pending, curl may hold decrypted data the socket no longer
+// reports. stops early when the main thread is behind
+static int ws_thread_recv_pending(ws_ctx *ctx)
+{
+	while (!spsc_ring_is_full(&ctx->inbound))
+	{
+		ws_event event = {.res = ws_recv_common(ctx), .is_recv = 1};
+		if (event.res.err == ws_xfer_error_CURL && event.res.curl_code == CURLE_AGAIN)
+			return (1);
+		ws_push_event(ctx, &event);
+		if (event.res.err)
+			return (0);
+	}
+	return (1);
+}
+
+// curl_easy_perform() only does the TLS and upgrade handshake on a connect-only
+// handle, the connection is then used with curl_ws_send()/curl_ws_recv()
+static int ws_thread_handshake(ws_ctx *ctx)
+{
+	TRACE_SCOPE("ws_handshake");
+	CURLcode res = curl_easy_perform(ctx->curl);
+	curl_socket_t sock = CURL_SOCKET_BAD;
+	if (!res)
+		res = curl_easy_getinfo(ctx->curl, CURLINFO_ACTIVESOCKET, &sock);
+	ctx->sock = sock;
+	ctx->handshake_result = res;
+	ctx->handshake_end_ns = clock_ns();
+	atomic_store_explicit(&ctx->handshake_done, 1, memory_order_release);
+	eventfd_write(ctx->handshake_fd, 1);
+	return (!res);
+}
+
+static void *ws_thread_main(void *param)
+{
+	ws_ctx *ctx = param;
+	if (!ws_thread_handshake(ctx))
+		return (NULL);
+	while (!atomic_load_explicit(&ctx->stop, memory_order_acquire))
+	{
+		// the socket is left alone while the main thread has no room for more
+		struct pollfd fds[2] = {
+			{.fd = ctx->wake_fd, .events = POLLIN, .revents = 0},
+			{.fd = ctx->sock, .events = spsc_ring_is_full(&ctx->inbound) ? 0 : POLLIN, .revents = 0},
+		};
+		if (poll(fds, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ws_event event = {.res = {.err = ws_xfer_error_POLL, .poll_errno = errno}, .is_recv = 1};
+			ws_push_event(ctx, &event);
+			break;
+		}
+		eventfd_t count;
+		if (fds[0].revents & POLLIN)
+			eventfd_read(ctx->wake_fd, &count);
+		if (!ws_thread_send_queued(ctx))
+			break;
+		if ((fds[1].revents & (POLLIN | POLLERR | POLLHUP)) && !ws_thread_recv_pending(ctx))
+			break;
+	}
+	return (NULL);
+}
+
+int ws_ctx_start_thread(ws_ctx *ctx)
+{
+	if (!spsc_ring_init(&ctx->inbound, WS_RING_SIZE, sizeof(ws_event))
+		|| !spsc_ring_init(&ctx->outbound, WS_RING_SIZE, sizeof(char *)))
+		return (0);
+	ctx->handshake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	ctx->inbound_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	ctx->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (ctx->handshake_fd < 0 || ctx->inbound_fd < 0 || ctx->wake_fd < 0)
+		return (0);
+	atomic_store(&ctx->stop, 0);
+	atomic_store(&ctx->handshake_done, 0);
+	// the thread inherits a mask blocking every signal: the ones the event loops
+	// read from a signalfd have to stay blocked in all threads, or they are
+	// delivered to this one with their default action
+	sigset_t all;
+	sigset_t old_mask;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old_mask);
+	int err = pthread_create(&ctx->thread, NULL, ws_thread_main, ctx);
+	pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+	if (err)
+		return (0);
+	ctx->thread_running = 1;
+	return (1);
+}
+
+void ws_ctx_stop_thread(ws_ctx *ctx)
+{
+	if (ctx->thread_running)
+	{
+		atomic_store_explicit(&ctx->stop, 1, memory_order_release);
+		eventfd_write(ctx->wake_fd, 1);
+		pthread_join(ctx->thread, NULL);
+		ctx->thread_running = 0;
+	}
+	if (ctx->inbound.slots)
+	{
+		ws_event event;
+		while (spsc_ring_pop(&ctx->inbound, &event))
+			cJSON_Delete(event.res.err ? NULL : event.res.json_obj);
+	}
+	if (ctx->outbound.slots)
+	{
+		char *msg;
+		while (spsc_ring_pop(&ctx->outbound, &msg))
+			free(msg);
+	}
+	spsc_ring_deinit(&ctx->inbound);
+	spsc_ring_deinit(&ctx->outbound);
+	if (ctx->handshake_fd >= 0)
+		close(ctx->handshake_fd);
+	if (ctx->inbound_fd >= 0)
+		close(ctx->inbound_fd);
+	if (ctx->wake_fd >= 0)
+		close(ctx->wake_fd);
+	ctx->handshake_fd = -1;
+	ctx->inbound_fd = -1;
+	ctx->wake_fd = -1;
+}
+
+// main thread
+
+CURLcode ws_ctx_wait_connected(ws_ctx *ctx)
+{
+	while (!atomic_load_explicit(&ctx->handshake_done, memory_order_acquire))
+	{
+		struct pollfd pollfd = {.events = POLLIN, .fd = ctx->handshake_fd, .revents = 0};
+		if (poll(&pollfd, 1, -1) < 0 && errno != EINTR)
+			return (CURLE_RECV_ERROR);
+	}
+	return (ctx->handshake_result);
+}
+
+static int ws_pop_event(ws_ctx *ctx, ws_event *event)
+{
+	int was_full = spsc_ring_is_full(&ctx->inbound);
+	int popped = spsc_ring_pop(&ctx->inbound, event);
+	if (popped && was_full)
+		eventfd_write(ctx->wake_fd, 1);
+	// inbound_fd stays readable while messages are queued, it is only reset once
+	// the ring is empty, and set again if the thread pushed in between
+	if (spsc_ring_is_empty(&ctx->inbound))
+	{
+		eventfd_t count;
+		eventfd_read(ctx->inbound_fd, &count);
+		if (!spsc_ring_is_empty(&ctx->inbound))
+			eventfd_write(ctx->inbound_fd, 1);
+	}
+	return (popped);
+}
+
+static ws_recv_data ws_event_to_data(ws_ctx *ctx, ws_event *event)
+{
+	if (event->res.err)
+	{
+		// the thread is done, its receive buffer can be read for the error message
+		DO_CLEANUP(ws_ctx_print_xfer_result(ctx, event->res, event->is_recv, stderr));
+	}
+	cJSON *type_node = cJSON_GetObjectItemCaseSensitive(event->res.json_obj, "type");
 	if (!type_node || !cJSON_IsString(type_node))
 		clean_and_fail("\"type\" field not found in websocket JSON");
 	ws_recv_data ret;
 	ret.type = type_node->valuestring;
-	ret.json = res.json_obj;
+	ret.json = event->res.json_obj;
 	return (ret);
 }
 
-void ws_send(ws_ctx *ctx)
+ws_recv_data ws_recv(ws_ctx *ctx)
 {
-	ws_xfer_result res = {0};
-	struct pollfd pollfd = {.events = POLLOUT, .fd = ctx->sock, .revents = 0};
-	int poll_err = poll(&pollfd, 1, MAX_WS_TIMEOUT);
-	if (poll_err < 0)
-	{
-		res.err = ws_xfer_error_POLL;
-		res.poll_errno = errno;
-		DO_CLEANUP(ws_ctx_print_xfer_result(ctx, res, 0, stderr));
-	}
-	size_t offset = 0;
-	size_t to_send = strnlen(ctx->send_buf, JSON_BUFFER_SIZE);
-	CURLcode err = CURLE_OK;
-  	while (!err)
+	ws_event event;
+	while (!ws_pop_event(ctx, &event))
 	{
-		size_t sent;
-		err = curl_ws_send(ctx->curl, ctx->send_buf + offset, to_send - offset, &sent, 0, CURLWS_TEXT);
- 
-		if (err == CURLE_OK)
+		struct pollfd pollfd = {.events = POLLIN, .fd = ctx->inbound_fd, .revents = 0};
+		int poll_err = poll(&pollfd, 1, MAX_WS_TIMEOUT);
+		if (poll_err < 0 && errno != EINTR)
 		{
-			offset += sent;
-	  		if (offset == to_send)
-				break; /* finished sending */
+			event.res = (ws_xfer_result){.err = ws_xfer_error_POLL, .poll_errno = errno};
+			event.is_recv = 1;
+			break;
+		}
+		if (!poll_err)
+		{
+			event.res = (ws_xfer_result){.err = ws_xfer_error_TIMEOUT};
+			event.is_recv = 1;
+			break;
 		}
 	}
-	if (err)
+	return (ws_event_to_data(ctx, &event));
+}
+
+int ws_try_recv(ws_ctx *ctx, ws_recv_data *data)
+{
+	ws_event event;
+	if (!ws_pop_event(ctx, &event))
+		return (0);
+	*data = ws_event_to_data(ctx, &event);
+	return (1);
+}
+
+void ws_send(ws_ctx *ctx)
+{
+	char *msg = xstrdup(ctx->send_buf);
+	// a full ring is only a few messages behind, the thread keeps sending
+	while (!spsc_ring_push(&ctx->outbound, &msg))
 	{
-		res.err = ws_xfer_error_CURL;
-		res.curl_code = err;
-		DO_CLEANUP(ws_ctx_print_xfer_result(ctx, res, 0, stderr));
+		eventfd_write(ctx->wake_fd, 1);
+		sched_yield();
 	}
+	eventfd_write(ctx->wake_fd, 1);
 }
 
 static void ws_ctx_print_xfer_result(ws_ctx *ctx, ws_xfer_result res, int is_recv, FILE *stream)
@@ -132,6 +375,9 @@ static void ws_ctx_print_xfer_result(ws_ctx *ctx, ws_xfer_result res, int is_rec
 		case ws_xfer_error_POLL:
 			fprintf(stream, "poll() fail: %s\n", strerror(res.poll_errno));
 			break;
+		case ws_xfer_error_TIMEOUT:
+			fprintf(stream, "timed out after %dms\n", MAX_WS_TIMEOUT);
+			break;
 		case ws_xfer_error_TOO_BIG:
 			fprintf(stream, "message too big !\n");
 			break;
@@ -1,7 +1,25 @@
 #include "ws.h"
+#include <stdatomic.h>
 
-int ws_ctx_init(ws_ctx *ctx, const char *url)
+// a handshake still in progress is abandoned when the thread is stopped
+static int ws_handshake_progress(void *param, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
 {
+	(void)dltotal;
+	(void)dlnow;
+	(void)ultotal;
+	(void)ulnow;
+	ws_ctx *ctx = param;
+	return (atomic_load_explicit(&ctx->stop, memory_order_relaxed));
+}
+
+// the connect-only handle is never added to the multi handle of the REST
+// requests: removing it from there would close its connection
+int ws_ctx_init(ws_ctx *ctx, const char *url, CURLSH *share)
+{
+	ctx->sock = CURL_SOCKET_BAD;
+	ctx->handshake_fd = -1;
+	ctx->inbound_fd = -1;
+	ctx->wake_fd = -1;
 	CURL *easy = curl_easy_init();
 	if (!easy)
 	{
@@ -12,17 +30,17 @@ int ws_ctx_init(ws_ctx *ctx, const char *url)
 	curl_easy_setopt(easy, CURLOPT_URL, url);
     curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, 0L);
     curl_easy_setopt(easy, CURLOPT_SSL_VERIFYHOST, 0L);
-	CURLcode err = curl_easy_perform(easy);
-	if (err)
+	curl_easy_setopt(easy, CURLOPT_SHARE, share);
+	curl_easy_setopt(easy, CURLOPT_NOPROGRESS, 0L);
+	curl_easy_setopt(easy, CURLOPT_XFERINFOFUNCTION, ws_handshake_progress);
+	curl_easy_setopt(easy, CURLOPT_XFERINFODATA, ctx);
+	ctx->curl = easy;
+	if (!ws_ctx_start_thread(ctx))
 	{
-		fprintf(stderr, "curl_easy_perform() fail: %s\n", curl_easy_strerror(err));
-		curl_easy_cleanup(easy);
+		fprintf(stderr, "websocket thread start fail\n");
+		ws_ctx_deinit(ctx);
 		return (0);
 	}
-	ctx->curl = easy;
-	curl_socket_t sockfd;
-	curl_easy_getinfo(easy, CURLINFO_ACTIVESOCKET, &sockfd);
-	ctx->sock = sockfd;
 	return (1);
 }
 
@@ -30,6 +48,7 @@ void ws_ctx_deinit(ws_ctx *ctx)
 {
 	if (ctx->curl)
 	{
+		ws_ctx_stop_thread(ctx);
 		curl_easy_cleanup(ctx->curl);
 		ctx->curl = NULL;
 	}